@@ -52,8 +52,9 @@ void Camera::processKeyboard(CameraMovement direction, float deltaTime)
 		break;
 	}
 
-	// camera can't go below 0!
-	if (position.y < 10.0) position.y = 10.0;
+	// camera can't go below the ground!
+	float ground = groundHeight ? groundHeight(position.x, position.z) : 0.f;
+	if (position.y < ground + GROUND_CLEARANCE) position.y = ground + GROUND_CLEARANCE;
 }
 
 void Camera::processMouseMovement(float xoffset, float yoffset, GLboolean constrainPitch)
@@ -8,6 +8,7 @@
 #include <glm/gtc/matrix_transform.hpp>
 
 #include <vector>
+#include <functional>
 
 enum class CameraMovement
 {
@@ -25,6 +26,7 @@ const float PITCH = 0.0f;
 const float SPEED = 5.0f;
 const float SENSITIVITY = 0.1f;
 const float ZOOM = 60.0f;
+const float GROUND_CLEARANCE = 10.0f;
 
 class Camera
 {
@@ -42,6 +44,8 @@ public:
 	inline glm::vec3 getUp() const { return glm::normalize(up); }
 	void setMovementSpeed(float value) { movementSpeed = value; };
 	void setMouseSensitivity(float value) { mouseSensitivity = value; };
+	// sets the function which returns the height of the ground at (x, z) (camera can't go below it)
+	void setGroundHeight(std::function<float(float, float)> _groundHeight) { groundHeight = _groundHeight; }
 
 	void processMouseMovement(float xoffset, float yoffset, GLboolean constrainPitch = true);
 	void processMouseScroll(float yoffset);
@@ -65,6 +69,8 @@ private:
 	float movementSpeed;
 	float mouseSensitivity;
 	float zoom;
+
+	std::function<float(float, float)> groundHeight;
 };
 
 #endif
\ No newline at end of file
@@ -0,0 +1,147 @@
+#include "CompressedTexture.h"
+
+#include <iostream>
+#include <cstdio>
+#include <cstring>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+
+CompressedTexture::~CompressedTexture()
+{
+	close();
+}
+
+bool CompressedTexture::open(const std::string& path)
+{
+	close();
+
+	// Map the whole file (pages are read by the OS once they are touched by the upload)
+#ifdef _WIN32
+	HANDLE file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+	if (file == INVALID_HANDLE_VALUE)
+		return false;
+	LARGE_INTEGER fileSize;
+	GetFileSizeEx(file, &fileSize);
+	HANDLE mapping = fileSize.QuadPart > 0 ? CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL) : NULL;
+	void* view = mapping != NULL ? MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0) : NULL;
+	if (view == NULL) {
+		if (mapping != NULL)
+			CloseHandle(mapping);
+		CloseHandle(file);
+		std::cout << "ERROR::COMPRESSED_TEXTURE::open() Unable to map " << path << "!" << std::endl;
+		return false;
+	}
+	fileHandle = file;
+	mappingHandle = mapping;
+	data = static_cast<const unsigned char*>(view);
+	size = static_cast<size_t>(fileSize.QuadPart);
+#else
+	int file = ::open(path.c_str(), O_RDONLY);
+	if (file < 0)
+		return false;
+	struct stat fileStat;
+	void* view = MAP_FAILED;
+	if (fstat(file, &fileStat) == 0 && fileStat.st_size > 0)
+		view = mmap(NULL, static_cast<size_t>(fileStat.st_size), PROT_READ, MAP_PRIVATE, file, 0);
+	if (view == MAP_FAILED) {
+		::close(file);
+		std::cout << "ERROR::COMPRESSED_TEXTURE::open() Unable to map " << path << "!" << std::endl;
+		return false;
+	}
+	fileDescriptor = file;
+	data = static_cast<const unsigned char*>(view);
+	size = static_cast<size_t>(fileStat.st_size);
+#endif
+
+	// Validate the header and the level index (so the upload never reads outside of the file)
+	bool isValid = size >= sizeof(CompressedTextureHeader) && std::memcmp(header()->magic, magic(), sizeof(header()->magic)) == 0;
+	isValid = isValid && header()->levels > 0 && header()->levels <= 32 && header()->width > 0 && header()->height > 0;
+	isValid = isValid && size >= sizeof(CompressedTextureHeader) + header()->levels * sizeof(CompressedTextureLevel);
+	for (int level = 0; isValid && level < getLevels(); ++level) {
+		const CompressedTextureLevel& entry = levelIndex()[level];
+		isValid = entry.offset <= size && entry.size <= size - entry.offset;
+	}
+	if (!isValid) {
+		std::cout << "ERROR::COMPRESSED_TEXTURE::open() " << path << " is not a valid compressed texture!" << std::endl;
+		close();
+		return false;
+	}
+	return true;
+}
+
+void CompressedTexture::close()
+{
+	if (data == nullptr)
+		return;
+#ifdef _WIN32
+	UnmapViewOfFile(data);
+	CloseHandle(static_cast<HANDLE>(mappingHandle));
+	CloseHandle(static_cast<HANDLE>(fileHandle));
+	mappingHandle = nullptr;
+	fileHandle = nullptr;
+#else
+	munmap(const_cast<unsigned char*>(data), size);
+	::close(fileDescriptor);
+	fileDescriptor = -1;
+#endif
+	data = nullptr;
+	size = 0;
+}
+
+std::string CompressedTexture::containerPath(const std::string& imagePath)
+{
+	size_t extension = imagePath.find_last_of('.');
+	size_t directory = imagePath.find_last_of("/\\");
+	if (extension == std::string::npos || (directory != std::string::npos && extension < directory))
+		return imagePath + COMPRESSED_TEXTURE_EXTENSION;
+	return imagePath.substr(0, extension) + COMPRESSED_TEXTURE_EXTENSION;
+}
+
+bool CompressedTexture::isContainer(const std::string& path)
+{
+	const std::string extension(COMPRESSED_TEXTURE_EXTENSION);
+	return path.size() >= extension.size() && path.compare(path.size() - extension.size(), extension.size(), extension) == 0;
+}
+
+bool CompressedTexture::exists(const std::string& path)
+{
+	FILE* file = fopen(path.c_str(), "rb");
+	if (file == nullptr)
+		return false;
+	fclose(file);
+	return true;
+}
+
+const char* CompressedTexture::magic()
+{
+	return "PCCTEX1";
+}
+
+GLenum CompressedTexture::formatToGL(CompressedFormat format)
+{
+	switch (format)
+	{
+	case CompressedFormat::BC1:
+		return GL_COMPRESSED_RGB_S3TC_DXT1_EXT;
+	case CompressedFormat::BC4:
+		return GL_COMPRESSED_RED_RGTC1;
+	case CompressedFormat::BC5:
+		return GL_COMPRESSED_RG_RGTC2;
+	default:
+		return GL_COMPRESSED_RGBA_BPTC_UNORM;
+	}
+}
+
+size_t CompressedTexture::blockBytes(CompressedFormat format)
+{
+	return format == CompressedFormat::BC1 || format == CompressedFormat::BC4 ? 8 : 16;
+}
@@ -0,0 +1,88 @@
+#ifndef COMPRESSED_TEXTURE_H
+#define COMPRESSED_TEXTURE_H
+
+#include <glad/glad.h>
+
+#include <string>
+#include <cstdint>
+
+// BC1 is not part of the core profile (S3TC extension), but it is supported by all the desktop GPUs
+#ifndef GL_COMPRESSED_RGB_S3TC_DXT1_EXT
+#define GL_COMPRESSED_RGB_S3TC_DXT1_EXT 0x83F0
+#endif
+
+// extension of the precompressed texture containers (written next to the source images)
+#define COMPRESSED_TEXTURE_EXTENSION ".ctex"
+
+// block compressed formats of the containers
+enum class CompressedFormat {
+	BC1 = 0, // RGB, 4 bits per texel
+	BC4 = 1, // R, 4 bits per texel
+	BC5 = 2, // RG, 8 bits per texel (normal maps, Z is reconstructed in the shaders)
+	BC7 = 3  // RGBA, 8 bits per texel
+};
+
+// Container layout (little endian, similar to KTX2): header, level index (offset and size of every level in
+// bytes from the start of the file) and the level data (largest level first, every level is aligned to 16 bytes).
+// Levels are stored the way GL expects them, so they are uploaded straight from the mapped file
+struct CompressedTextureHeader {
+	char magic[8];
+	uint32_t glFormat;
+	uint32_t width;
+	uint32_t height;
+	uint32_t levels;
+};
+
+struct CompressedTextureLevel {
+	uint64_t offset;
+	uint64_t size;
+};
+
+// Read-only memory mapped container
+class CompressedTexture {
+public:
+	CompressedTexture() {};
+	~CompressedTexture();
+	// mapping is owned by the one object only
+	CompressedTexture(const CompressedTexture&) = delete;
+	CompressedTexture& operator=(const CompressedTexture&) = delete;
+
+	// maps the container and validates its header (false if it does not exist or it is not valid)
+	bool open(const std::string& path);
+	void close();
+
+	inline bool isOpen() const { return data != nullptr; }
+	inline GLenum getGLFormat() const { return header()->glFormat; }
+	inline int getWidth() const { return static_cast<int>(header()->width); }
+	inline int getHeight() const { return static_cast<int>(header()->height); }
+	inline int getLevels() const { return static_cast<int>(header()->levels); }
+	inline const unsigned char* getLevelData(int level) const { return data + levelIndex()[level].offset; }
+	inline GLsizei getLevelSize(int level) const { return static_cast<GLsizei>(levelIndex()[level].size); }
+	inline int getLevelWidth(int level) const { return getWidth() > (1 << level) ? getWidth() >> level : 1; }
+	inline int getLevelHeight(int level) const { return getHeight() > (1 << level) ? getHeight() >> level : 1; }
+
+	// container of the image (same path with the container extension)
+	static std::string containerPath(const std::string& imagePath);
+	static bool isContainer(const std::string& path);
+	static bool exists(const std::string& path);
+	static const char* magic();
+	static GLenum formatToGL(CompressedFormat format);
+	static size_t blockBytes(CompressedFormat format);
+
+private:
+	inline const CompressedTextureHeader* header() const { return reinterpret_cast<const CompressedTextureHeader*>(data); }
+	inline const CompressedTextureLevel* levelIndex() const { return reinterpret_cast<const CompressedTextureLevel*>(data + sizeof(CompressedTextureHeader)); }
+
+	const unsigned char* data = nullptr;
+	size_t size = 0;
+
+	// platform handles of the mapping
+#ifdef _WIN32
+	void* fileHandle = nullptr;
+	void* mappingHandle = nullptr;
+#else
+	int fileDescriptor = -1;
+#endif
+};
+
+#endif // !COMPRESSED_TEXTURE_H
@@ -0,0 +1,540 @@
+#include "Atmosphere.h"
+
+#include "../Shader.h"
+#include "../Utilities.h"
+#include "../ThreadPool.h"
+
+#include <cmath>
+#include <functional>
+
+// SSE2 is available on every x64 CPU (other platforms use the scalar loop only)
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define ATMOSPHERE_SSE2
+#include <emmintrin.h>
+#endif
+
+// Atmosphere (same as in the atmosphere shaders)
+static const float PI = 3.14159265358979323846f;
+static const float EARTH_RADIUS = 6360e3f;
+static const float ATMOSPHERE_RADIUS = 6420e3f;
+static const glm::vec3 BETA_R = glm::vec3(3.8e-6f, 13.5e-6f, 33.1e-6f);
+static const glm::vec3 BETA_M = glm::vec3(21e-6f);
+static const float HR = 7994.f;
+static const float HM = 1200.f;
+static const float G = 0.76f;
+
+// Number of samples
+static const int TRANSMITTANCE_SAMPLES = 40;
+static const int MULTI_SCATTERING_DIRECTIONS = 8;
+static const int MULTI_SCATTERING_SAMPLES = 20;
+static const int SKY_VIEW_SAMPLES = 30;
+
+// Scattering and extinction at the height (there is no absorption, so they are the same)
+static glm::vec3 rayleighScattering(float height) { return BETA_R * std::exp(-height / HR); }
+static glm::vec3 mieScattering(float height) { return BETA_M * std::exp(-height / HM); }
+
+// Phase functions
+static float rayleighPhase(float mu) { return 3.f / (16.f * PI) * (1.f + mu * mu); }
+static float miePhase(float mu)
+{
+	float g2 = G * G;
+	return 3.f / (8.f * PI) * ((1.f - g2) * (1.f + mu * mu) / ((2.f + g2) * std::pow(1.f + g2 - 2.f * G * mu, 1.5f)));
+}
+
+// Ray from the radius r with the cosine of the zenith angle mu
+static bool intersectsGround(float r, float mu) { return mu < 0.f && r * r * (mu * mu - 1.f) + EARTH_RADIUS * EARTH_RADIUS >= 0.f; }
+static float distanceToGround(float r, float mu) { return -r * mu - std::sqrt(glm::max(r * r * (mu * mu - 1.f) + EARTH_RADIUS * EARTH_RADIUS, 0.f)); }
+static float distanceToTop(float r, float mu) { return -r * mu + std::sqrt(glm::max(r * r * (mu * mu - 1.f) + ATMOSPHERE_RADIUS * ATMOSPHERE_RADIUS, 0.f)); }
+
+// Samples the table (bilinear, clamped to the edge) at uv
+static glm::vec3 sampleTable(const std::vector<glm::vec4>& table, int width, int height, glm::vec2 uv)
+{
+	glm::vec2 texel = glm::clamp(uv * glm::vec2(width, height) - 0.5f, glm::vec2(0.f), glm::vec2(width - 1, height - 1));
+	int x0 = static_cast<int>(texel.x);
+	int y0 = static_cast<int>(texel.y);
+	int x1 = glm::min(x0 + 1, width - 1);
+	int y1 = glm::min(y0 + 1, height - 1);
+	glm::vec2 w = texel - glm::vec2(x0, y0);
+	glm::vec3 bottom = glm::mix(glm::vec3(table[x0 + y0 * width]), glm::vec3(table[x1 + y0 * width]), w.x);
+	glm::vec3 top = glm::mix(glm::vec3(table[x0 + y1 * width]), glm::vec3(table[x1 + y1 * width]), w.x);
+	return glm::mix(bottom, top, w.y);
+}
+
+// Table coordinates of the height and the cosine of the zenith angle (transmittance and multiple scattering)
+static glm::vec2 heightZenithToUV(float height, float mu)
+{
+	return glm::vec2(mu * 0.5f + 0.5f, height / (ATMOSPHERE_RADIUS - EARTH_RADIUS));
+}
+
+static glm::vec3 sampleTransmittance(const std::vector<glm::vec4>& transmittance, float height, float mu)
+{
+	return sampleTable(transmittance, ATMOSPHERE_TRANSMITTANCE_WIDTH, ATMOSPHERE_TRANSMITTANCE_HEIGHT, heightZenithToUV(height, mu));
+}
+
+static glm::vec3 sampleMultiScattering(const std::vector<glm::vec4>& multiScattering, float height, float mu)
+{
+	return sampleTable(multiScattering, ATMOSPHERE_MULTI_SCATTERING_RESOLUTION, ATMOSPHERE_MULTI_SCATTERING_RESOLUTION, heightZenithToUV(height, mu));
+}
+
+#ifdef ATMOSPHERE_SSE2
+// e^x of 4 values (x = n ln 2 + r, e^r is a polynomial and 2^n goes straight into the exponent bits)
+// NOTE: Relative error is below 2e-7, so the results differ from std::exp only in the last bits
+static inline __m128 exp4(__m128 x)
+{
+	x = _mm_max_ps(_mm_min_ps(x, _mm_set1_ps(88.f)), _mm_set1_ps(-87.f));
+
+	// n = floor(x / ln 2 + 0.5) (floor is the truncation moved down for the negative values)
+	__m128 fx = _mm_add_ps(_mm_mul_ps(x, _mm_set1_ps(1.44269504f)), _mm_set1_ps(0.5f));
+	__m128i n = _mm_cvttps_epi32(fx);
+	n = _mm_add_epi32(n, _mm_castps_si128(_mm_cmpgt_ps(_mm_cvtepi32_ps(n), fx)));
+	__m128 nf = _mm_cvtepi32_ps(n);
+
+	// r = x - n ln 2 (ln 2 is split into two parts to keep the precision)
+	__m128 r = _mm_sub_ps(x, _mm_mul_ps(nf, _mm_set1_ps(0.693359375f)));
+	r = _mm_add_ps(r, _mm_mul_ps(nf, _mm_set1_ps(2.12194440e-4f)));
+
+	// e^r
+	__m128 p = _mm_set1_ps(1.9875691500e-4f);
+	p = _mm_add_ps(_mm_mul_ps(p, r), _mm_set1_ps(1.3981999507e-3f));
+	p = _mm_add_ps(_mm_mul_ps(p, r), _mm_set1_ps(8.3334519073e-3f));
+	p = _mm_add_ps(_mm_mul_ps(p, r), _mm_set1_ps(4.1665795894e-2f));
+	p = _mm_add_ps(_mm_mul_ps(p, r), _mm_set1_ps(1.6666665459e-1f));
+	p = _mm_add_ps(_mm_mul_ps(p, r), _mm_set1_ps(5.0000001201e-1f));
+	p = _mm_add_ps(_mm_add_ps(_mm_mul_ps(_mm_mul_ps(p, r), r), r), _mm_set1_ps(1.f));
+
+	// 2^n
+	__m128 scale = _mm_castsi128_ps(_mm_slli_epi32(_mm_add_epi32(n, _mm_set1_epi32(127)), 23));
+	return _mm_mul_ps(p, scale);
+}
+
+// Samples the table (bilinear, clamped to the edge) at 4 uv coordinates, the result is stored by the color channels
+static inline void sampleTable4(const std::vector<glm::vec4>& table, int width, int height, __m128 u, __m128 v, __m128 value[3])
+{
+	// Texels are never negative after the clamp, so the truncation is the floor
+	__m128 maxX = _mm_set1_ps(static_cast<float>(width - 1));
+	__m128 maxY = _mm_set1_ps(static_cast<float>(height - 1));
+	__m128 texelX = _mm_min_ps(_mm_max_ps(_mm_sub_ps(_mm_mul_ps(u, _mm_set1_ps(static_cast<float>(width))), _mm_set1_ps(0.5f)), _mm_setzero_ps()), maxX);
+	__m128 texelY = _mm_min_ps(_mm_max_ps(_mm_sub_ps(_mm_mul_ps(v, _mm_set1_ps(static_cast<float>(height))), _mm_set1_ps(0.5f)), _mm_setzero_ps()), maxY);
+	__m128 x0 = _mm_cvtepi32_ps(_mm_cvttps_epi32(texelX));
+	__m128 y0 = _mm_cvtepi32_ps(_mm_cvttps_epi32(texelY));
+	__m128 x1 = _mm_min_ps(_mm_add_ps(x0, _mm_set1_ps(1.f)), maxX);
+	__m128 y1 = _mm_min_ps(_mm_add_ps(y0, _mm_set1_ps(1.f)), maxY);
+	__m128 wx = _mm_sub_ps(texelX, x0);
+	__m128 wy = _mm_sub_ps(texelY, y0);
+
+	// Indices of the corners (exact in float for the table sizes)
+	__m128 w4 = _mm_set1_ps(static_cast<float>(width));
+	int corners[4][4];
+	_mm_storeu_si128(reinterpret_cast<__m128i*>(corners[0]), _mm_cvttps_epi32(_mm_add_ps(x0, _mm_mul_ps(y0, w4))));
+	_mm_storeu_si128(reinterpret_cast<__m128i*>(corners[1]), _mm_cvttps_epi32(_mm_add_ps(x1, _mm_mul_ps(y0, w4))));
+	_mm_storeu_si128(reinterpret_cast<__m128i*>(corners[2]), _mm_cvttps_epi32(_mm_add_ps(x0, _mm_mul_ps(y1, w4))));
+	_mm_storeu_si128(reinterpret_cast<__m128i*>(corners[3]), _mm_cvttps_epi32(_mm_add_ps(x1, _mm_mul_ps(y1, w4))));
+
+	// Load the texels lane by lane (SSE2 has no gather) and transpose them to the color channels
+	__m128 texels[4][4];
+	for (int corner = 0; corner < 4; ++corner) {
+		for (int lane = 0; lane < 4; ++lane)
+			texels[corner][lane] = _mm_loadu_ps(&table[corners[corner][lane]].x);
+		_MM_TRANSPOSE4_PS(texels[corner][0], texels[corner][1], texels[corner][2], texels[corner][3]);
+	}
+
+	// Bilinear interpolation of every channel
+	for (int c = 0; c < 3; ++c) {
+		__m128 bottom = _mm_add_ps(texels[0][c], _mm_mul_ps(wx, _mm_sub_ps(texels[1][c], texels[0][c])));
+		__m128 top = _mm_add_ps(texels[2][c], _mm_mul_ps(wx, _mm_sub_ps(texels[3][c], texels[2][c])));
+		value[c] = _mm_add_ps(bottom, _mm_mul_ps(wy, _mm_sub_ps(top, bottom)));
+	}
+}
+#endif
+
+// Bakes every row of the table (in parallel if the pool is given)
+static void bakeRows(ThreadPool* pool, int rows, const std::function<void(int)>& bakeRow)
+{
+	if (pool == nullptr) {
+		for (int y = 0; y < rows; ++y)
+			bakeRow(y);
+		return;
+	}
+	for (int y = 0; y < rows; ++y)
+		pool->enqueue([&bakeRow, y] { bakeRow(y); });
+	pool->wait();
+}
+
+Atmosphere::Atmosphere()
+{
+	// Create lookup table shaders
+	transmittanceShader = new Shader();
+	transmittanceShader->attachShader("Shaders/Skybox/transmittanceLUT.comp", ShaderInfo(ShaderType::kCompute));
+	transmittanceShader->linkProgram();
+	multiScatteringShader = new Shader();
+	multiScatteringShader->attachShader("Shaders/Skybox/multiScatteringLUT.comp", ShaderInfo(ShaderType::kCompute));
+	multiScatteringShader->linkProgram();
+	skyViewShader = new Shader();
+	skyViewShader->attachShader("Shaders/Skybox/skyViewLUT.comp", ShaderInfo(ShaderType::kCompute));
+	skyViewShader->linkProgram();
+
+	// Create lookup tables
+	transmittanceTable = createTable(ATMOSPHERE_TRANSMITTANCE_WIDTH, ATMOSPHERE_TRANSMITTANCE_HEIGHT);
+	multiScatteringTable = createTable(ATMOSPHERE_MULTI_SCATTERING_RESOLUTION, ATMOSPHERE_MULTI_SCATTERING_RESOLUTION);
+	skyViewTable = createTable(ATMOSPHERE_SKY_VIEW_WIDTH, ATMOSPHERE_SKY_VIEW_HEIGHT);
+}
+
+Atmosphere::~Atmosphere()
+{
+	// Delete shaders
+	delete transmittanceShader;
+	delete multiScatteringShader;
+	delete skyViewShader;
+	// Delete lookup tables
+	glDeleteTextures(1, &transmittanceTable);
+	glDeleteTextures(1, &multiScatteringTable);
+	glDeleteTextures(1, &skyViewTable);
+	// Stop the baker workers
+	delete bakerPool;
+}
+
+void Atmosphere::update(float sunElevation)
+{
+	// Static tables are built only once
+	if (!areStaticTablesBuilt) {
+		buildStaticTables();
+		areStaticTablesBuilt = true;
+	}
+
+	// Sky-view table is rebuilt only once the sun has moved up or down
+	if (!isSkyViewBuilt || sunElevation != builtSunElevation) {
+		builtSunElevation = sunElevation;
+		buildSkyView();
+		isSkyViewBuilt = true;
+		++builds;
+	}
+}
+
+void Atmosphere::bindTransmittance(GLenum unit) const
+{
+	glActiveTexture(GL_TEXTURE0 + unit);
+	glBindTexture(GL_TEXTURE_2D, transmittanceTable);
+}
+
+void Atmosphere::bindMultiScattering(GLenum unit) const
+{
+	glActiveTexture(GL_TEXTURE0 + unit);
+	glBindTexture(GL_TEXTURE_2D, multiScatteringTable);
+}
+
+void Atmosphere::bindSkyView(GLenum unit) const
+{
+	glActiveTexture(GL_TEXTURE0 + unit);
+	glBindTexture(GL_TEXTURE_2D, skyViewTable);
+}
+
+void Atmosphere::setCPUBaker(bool _isCPUBaker)
+{
+	if (_isCPUBaker == isCPUBaker)
+		return;
+
+	// Rebuild everything with the other baker
+	isCPUBaker = _isCPUBaker;
+	if (isCPUBaker && bakerPool == nullptr)
+		bakerPool = new ThreadPool();
+	areStaticTablesBuilt = false;
+	isSkyViewBuilt = false;
+}
+
+void Atmosphere::bakeTransmittance(std::vector<glm::vec4>& transmittance, ThreadPool* pool)
+{
+	// Same as transmittanceLUT.comp
+	transmittance.resize(ATMOSPHERE_TRANSMITTANCE_WIDTH * ATMOSPHERE_TRANSMITTANCE_HEIGHT);
+	bakeRows(pool, ATMOSPHERE_TRANSMITTANCE_HEIGHT, [&transmittance](int y) {
+		for (int x = 0; x < ATMOSPHERE_TRANSMITTANCE_WIDTH; ++x) {
+			// Table coordinates to the height and the cosine of the zenith angle
+			float mu = (static_cast<float>(x) + 0.5f) / ATMOSPHERE_TRANSMITTANCE_WIDTH * 2.f - 1.f;
+			float height = (static_cast<float>(y) + 0.5f) / ATMOSPHERE_TRANSMITTANCE_HEIGHT * (ATMOSPHERE_RADIUS - EARTH_RADIUS);
+			transmittance[x + y * ATMOSPHERE_TRANSMITTANCE_WIDTH] = glm::vec4(integrateTransmittance(height, mu), 1.f);
+		}
+	});
+}
+
+void Atmosphere::bakeMultiScattering(const std::vector<glm::vec4>& transmittance, std::vector<glm::vec4>& multiScattering, ThreadPool* pool)
+{
+	// Same as multiScatteringLUT.comp
+	const int R = ATMOSPHERE_MULTI_SCATTERING_RESOLUTION;
+	const float isotropicPhase = 1.f / (4.f * PI);
+	multiScattering.resize(R * R);
+	bakeRows(pool, R, [&transmittance, &multiScattering, R, isotropicPhase](int y) {
+		for (int x = 0; x < R; ++x) {
+			// Table coordinates to the height and the cosine of the sun zenith angle
+			float muSun = (static_cast<float>(x) + 0.5f) / R * 2.f - 1.f;
+			float height = (static_cast<float>(y) + 0.5f) / R * (ATMOSPHERE_RADIUS - EARTH_RADIUS);
+			glm::vec3 position = glm::vec3(0.f, EARTH_RADIUS + height, 0.f);
+			glm::vec3 sunDirection = glm::vec3(std::sqrt(glm::max(1.f - muSun * muSun, 0.f)), muSun, 0.f);
+
+			// Second order scattering and the transfer function from all the directions on the sphere
+			glm::vec3 secondOrder = glm::vec3(0.f);
+			glm::vec3 transfer = glm::vec3(0.f);
+			for (int i = 0; i < MULTI_SCATTERING_DIRECTIONS; ++i) {
+				for (int j = 0; j < MULTI_SCATTERING_DIRECTIONS; ++j) {
+					float cosTheta = 1.f - 2.f * (static_cast<float>(i) + 0.5f) / MULTI_SCATTERING_DIRECTIONS;
+					float sinTheta = std::sqrt(glm::max(1.f - cosTheta * cosTheta, 0.f));
+					float phi = 2.f * PI * (static_cast<float>(j) + 0.5f) / MULTI_SCATTERING_DIRECTIONS;
+					glm::vec3 direction = glm::vec3(sinTheta * std::cos(phi), cosTheta, sinTheta * std::sin(phi));
+
+					// March through the atmosphere (ground does not reflect anything)
+					float r = position.y;
+					float distance = intersectsGround(r, cosTheta) ? distanceToGround(r, cosTheta) : distanceToTop(r, cosTheta);
+					float segmentLength = distance / static_cast<float>(MULTI_SCATTERING_SAMPLES);
+					glm::vec3 throughput = glm::vec3(1.f);
+					for (int k = 0; k < MULTI_SCATTERING_SAMPLES; ++k) {
+						glm::vec3 samplePosition = position + direction * ((static_cast<float>(k) + 0.5f) * segmentLength);
+						float sampleRadius = glm::length(samplePosition);
+						float sampleHeight = sampleRadius - EARTH_RADIUS;
+						glm::vec3 scattering = rayleighScattering(sampleHeight) + mieScattering(sampleHeight);
+						glm::vec3 sunTransmittance = sampleTransmittance(transmittance, sampleHeight, glm::dot(samplePosition / sampleRadius, sunDirection));
+
+						// Integrate the segment analytically
+						glm::vec3 segmentTransmittance = glm::exp(-scattering * segmentLength);
+						glm::vec3 integral = (glm::vec3(1.f) - segmentTransmittance) / scattering;
+						secondOrder += throughput * scattering * sunTransmittance * isotropicPhase * integral;
+						transfer += throughput * scattering * integral;
+						throughput *= segmentTransmittance;
+					}
+				}
+			}
+
+			// Infinite number of the scattering orders (geometric series)
+			float directions = static_cast<float>(MULTI_SCATTERING_DIRECTIONS * MULTI_SCATTERING_DIRECTIONS);
+			secondOrder /= directions;
+			transfer /= directions;
+			multiScattering[x + y * R] = glm::vec4(secondOrder / (glm::vec3(1.f) - transfer), 1.f);
+		}
+	});
+}
+
+void Atmosphere::bakeSkyView(const std::vector<glm::vec4>& transmittance, const std::vector<glm::vec4>& multiScattering, float sunElevation, std::vector<glm::vec4>& skyView, ThreadPool* pool)
+{
+	// Same as skyViewLUT.comp
+	skyView.resize(ATMOSPHERE_SKY_VIEW_WIDTH * ATMOSPHERE_SKY_VIEW_HEIGHT);
+	glm::vec3 sunDirection = glm::vec3(std::cos(sunElevation), std::sin(sunElevation), 0.f);
+	bakeRows(pool, ATMOSPHERE_SKY_VIEW_HEIGHT, [&transmittance, &multiScattering, &skyView, sunDirection](int y) {
+		// Table coordinates to the view directions (azimuth relative to the sun, more texels near the horizon)
+		glm::vec3 directions[ATMOSPHERE_SKY_VIEW_WIDTH];
+		for (int x = 0; x < ATMOSPHERE_SKY_VIEW_WIDTH; ++x) {
+			float v = (static_cast<float>(y) + 0.5f) / ATMOSPHERE_SKY_VIEW_HEIGHT;
+			float elevation = v * v * 0.5f * PI;
+			float azimuth = (static_cast<float>(x) + 0.5f) / ATMOSPHERE_SKY_VIEW_WIDTH * PI;
+			directions[x] = glm::vec3(std::cos(elevation) * std::cos(azimuth), std::sin(elevation), std::cos(elevation) * std::sin(azimuth));
+		}
+
+		// March from the observer on the ground to the top of the atmosphere (whole row at once)
+		glm::vec3 luminances[ATMOSPHERE_SKY_VIEW_WIDTH];
+		integrateSkyLuminance(transmittance, multiScattering, 0.f, directions, sunDirection, SKY_VIEW_SAMPLES, luminances, ATMOSPHERE_SKY_VIEW_WIDTH);
+		for (int x = 0; x < ATMOSPHERE_SKY_VIEW_WIDTH; ++x)
+			skyView[x + y * ATMOSPHERE_SKY_VIEW_WIDTH] = glm::vec4(luminances[x], 1.f);
+	});
+}
+
+glm::vec3 Atmosphere::integrateTransmittance(float height, float mu)
+{
+	// Rays which hit the ground never reach the sun
+	float r = EARTH_RADIUS + height;
+	if (intersectsGround(r, mu))
+		return glm::vec3(0.f);
+
+	// Integrate the extinction up to the top of the atmosphere
+	float segmentLength = distanceToTop(r, mu) / static_cast<float>(TRANSMITTANCE_SAMPLES);
+	glm::vec3 opticalDepth = glm::vec3(0.f);
+	for (int i = 0; i < TRANSMITTANCE_SAMPLES; ++i) {
+		float t = (static_cast<float>(i) + 0.5f) * segmentLength;
+		float sampleHeight = std::sqrt(r * r + t * t + 2.f * r * mu * t) - EARTH_RADIUS;
+		opticalDepth += (rayleighScattering(sampleHeight) + mieScattering(sampleHeight)) * segmentLength;
+	}
+	return glm::exp(-opticalDepth);
+}
+
+glm::vec3 Atmosphere::integrateSkyLuminance(const std::vector<glm::vec4>& transmittance, const std::vector<glm::vec4>& multiScattering, float height, glm::vec3 direction, glm::vec3 sunDirection, int samples)
+{
+	// Phase functions
+	float mu = glm::dot(direction, sunDirection);
+	float rayleighPHASE = rayleighPhase(mu);
+	float miePHASE = miePhase(mu);
+
+	// March from the observer to the top of the atmosphere
+	glm::vec3 position = glm::vec3(0.f, EARTH_RADIUS + height, 0.f);
+	float segmentLength = distanceToTop(position.y, direction.y) / static_cast<float>(samples);
+	glm::vec3 throughput = glm::vec3(1.f);
+	glm::vec3 luminance = glm::vec3(0.f);
+	for (int i = 0; i < samples; ++i) {
+		glm::vec3 samplePosition = position + direction * ((static_cast<float>(i) + 0.5f) * segmentLength);
+		float sampleRadius = glm::length(samplePosition);
+		float sampleHeight = sampleRadius - EARTH_RADIUS;
+		float muSun = glm::dot(samplePosition / sampleRadius, sunDirection);
+		glm::vec3 rayleigh = rayleighScattering(sampleHeight);
+		glm::vec3 mie = mieScattering(sampleHeight);
+		glm::vec3 extinction = rayleigh + mie;
+
+		// Single scattering of the sun and the multiple scattering
+		glm::vec3 sunTransmittance = sampleTransmittance(transmittance, sampleHeight, muSun);
+		glm::vec3 multiple = sampleMultiScattering(multiScattering, sampleHeight, muSun);
+		glm::vec3 scattered = rayleigh * (rayleighPHASE * sunTransmittance + multiple) + mie * (miePHASE * sunTransmittance + multiple);
+
+		// Integrate the segment analytically
+		glm::vec3 segmentTransmittance = glm::exp(-extinction * segmentLength);
+		luminance += throughput * scattered * (glm::vec3(1.f) - segmentTransmittance) / extinction;
+		throughput *= segmentTransmittance;
+	}
+	return luminance;
+}
+
+void Atmosphere::integrateSkyLuminance(const std::vector<glm::vec4>& transmittance, const std::vector<glm::vec4>& multiScattering, float height, const glm::vec3* directions, glm::vec3 sunDirection, int samples, glm::vec3* luminances, size_t count)
+{
+	// Same integral as above for 4 directions at once with SSE2 and the rest with the scalar loop
+	// NOTE: Only the texels of the lookup tables are loaded lane by lane (SSE2 has no gather)
+	size_t i = 0;
+#ifdef ATMOSPHERE_SSE2
+	const float radius = EARTH_RADIUS + height;
+	const __m128 radius4 = _mm_set1_ps(radius);
+	const __m128 earthRadius4 = _mm_set1_ps(EARTH_RADIUS);
+	const __m128 inverseHR4 = _mm_set1_ps(-1.f / HR);
+	const __m128 inverseHM4 = _mm_set1_ps(-1.f / HM);
+	const __m128 one4 = _mm_set1_ps(1.f);
+	for (; i + 4 <= count; i += 4) {
+		// Directions, phase functions and segment lengths of the lanes
+		float dx[4], dy[4], dz[4], rayleighPHASE[4], miePHASE[4], segmentLength[4];
+		for (int lane = 0; lane < 4; ++lane) {
+			const glm::vec3& direction = directions[i + lane];
+			float mu = glm::dot(direction, sunDirection);
+			dx[lane] = direction.x;
+			dy[lane] = direction.y;
+			dz[lane] = direction.z;
+			rayleighPHASE[lane] = rayleighPhase(mu);
+			miePHASE[lane] = miePhase(mu);
+			segmentLength[lane] = distanceToTop(radius, direction.y) / static_cast<float>(samples);
+		}
+		const __m128 dx4 = _mm_loadu_ps(dx);
+		const __m128 dy4 = _mm_loadu_ps(dy);
+		const __m128 dz4 = _mm_loadu_ps(dz);
+		const __m128 rayleighPHASE4 = _mm_loadu_ps(rayleighPHASE);
+		const __m128 miePHASE4 = _mm_loadu_ps(miePHASE);
+		const __m128 segmentLength4 = _mm_loadu_ps(segmentLength);
+
+		// Throughput and luminance of every color channel
+		__m128 throughput[3] = { one4, one4, one4 };
+		__m128 luminance[3] = { _mm_setzero_ps(), _mm_setzero_ps(), _mm_setzero_ps() };
+		for (int s = 0; s < samples; ++s) {
+			__m128 t = _mm_mul_ps(_mm_set1_ps(static_cast<float>(s) + 0.5f), segmentLength4);
+			__m128 px = _mm_mul_ps(dx4, t);
+			__m128 py = _mm_add_ps(radius4, _mm_mul_ps(dy4, t));
+			__m128 pz = _mm_mul_ps(dz4, t);
+			__m128 sampleRadius = _mm_sqrt_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(px, px), _mm_mul_ps(py, py)), _mm_mul_ps(pz, pz)));
+			__m128 sampleHeight = _mm_sub_ps(sampleRadius, earthRadius4);
+			__m128 muSun = _mm_add_ps(_mm_add_ps(_mm_mul_ps(px, _mm_set1_ps(sunDirection.x)), _mm_mul_ps(py, _mm_set1_ps(sunDirection.y))), _mm_mul_ps(pz, _mm_set1_ps(sunDirection.z)));
+			muSun = _mm_div_ps(muSun, sampleRadius);
+			__m128 rayleighDensity = exp4(_mm_mul_ps(sampleHeight, inverseHR4));
+			__m128 mieDensity = exp4(_mm_mul_ps(sampleHeight, inverseHM4));
+
+			// Single scattering of the sun and the multiple scattering (same table coordinates as heightZenithToUV)
+			__m128 u = _mm_add_ps(_mm_mul_ps(muSun, _mm_set1_ps(0.5f)), _mm_set1_ps(0.5f));
+			__m128 v = _mm_div_ps(sampleHeight, _mm_set1_ps(ATMOSPHERE_RADIUS - EARTH_RADIUS));
+			__m128 sunTransmittance[3], multipleScattering[3];
+			sampleTable4(transmittance, ATMOSPHERE_TRANSMITTANCE_WIDTH, ATMOSPHERE_TRANSMITTANCE_HEIGHT, u, v, sunTransmittance);
+			sampleTable4(multiScattering, ATMOSPHERE_MULTI_SCATTERING_RESOLUTION, ATMOSPHERE_MULTI_SCATTERING_RESOLUTION, u, v, multipleScattering);
+
+			for (int c = 0; c < 3; ++c) {
+				__m128 rayleigh = _mm_mul_ps(_mm_set1_ps(BETA_R[c]), rayleighDensity);
+				__m128 mie = _mm_mul_ps(_mm_set1_ps(BETA_M[c]), mieDensity);
+				__m128 extinction = _mm_add_ps(rayleigh, mie);
+				__m128 scattered = _mm_add_ps(_mm_mul_ps(rayleigh, _mm_add_ps(_mm_mul_ps(rayleighPHASE4, sunTransmittance[c]), multipleScattering[c])),
+					_mm_mul_ps(mie, _mm_add_ps(_mm_mul_ps(miePHASE4, sunTransmittance[c]), multipleScattering[c])));
+
+				// Integrate the segment analytically
+				__m128 segmentTransmittance = exp4(_mm_sub_ps(_mm_setzero_ps(), _mm_mul_ps(extinction, segmentLength4)));
+				luminance[c] = _mm_add_ps(luminance[c], _mm_div_ps(_mm_mul_ps(_mm_mul_ps(throughput[c], scattered), _mm_sub_ps(one4, segmentTransmittance)), extinction));
+				throughput[c] = _mm_mul_ps(throughput[c], segmentTransmittance);
+			}
+		}
+
+		// Back to the array of the colors
+		float result[3][4];
+		for (int c = 0; c < 3; ++c)
+			_mm_storeu_ps(result[c], luminance[c]);
+		for (int lane = 0; lane < 4; ++lane)
+			luminances[i + lane] = glm::vec3(result[0][lane], result[1][lane], result[2][lane]);
+	}
+#endif
+	for (; i < count; ++i)
+		luminances[i] = integrateSkyLuminance(transmittance, multiScattering, height, directions[i], sunDirection, samples);
+}
+
+float Atmosphere::calculateSunElevation(float sunAltitude)
+{
+	const float sunAngularDiameter = 0.009250245f;
+	return 4.f * -sunAngularDiameter + 1.6f * (PI / 4.f) * (0.5f + std::cos((1.f - sunAltitude) * 3.f) / 2.f);
+}
+
+void Atmosphere::buildStaticTables()
+{
+	if (isCPUBaker) {
+		// Bake and upload the tables
+		bakeTransmittance(transmittanceData, bakerPool);
+		bakeMultiScattering(transmittanceData, multiScatteringData, bakerPool);
+		glBindTexture(GL_TEXTURE_2D, transmittanceTable);
+		glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, ATMOSPHERE_TRANSMITTANCE_WIDTH, ATMOSPHERE_TRANSMITTANCE_HEIGHT, GL_RGBA, GL_FLOAT, &transmittanceData[0]);
+		glBindTexture(GL_TEXTURE_2D, multiScatteringTable);
+		glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, ATMOSPHERE_MULTI_SCATTERING_RESOLUTION, ATMOSPHERE_MULTI_SCATTERING_RESOLUTION, GL_RGBA, GL_FLOAT, &multiScatteringData[0]);
+		glBindTexture(GL_TEXTURE_2D, 0);
+		return;
+	}
+
+	// Build transmittance
+	transmittanceShader->use();
+	glBindImageTexture(0, transmittanceTable, 0, GL_FALSE, 0, GL_WRITE_ONLY, GL_RGBA16F);
+	glDispatchCompute(INT_CEIL(ATMOSPHERE_TRANSMITTANCE_WIDTH, 8), INT_CEIL(ATMOSPHERE_TRANSMITTANCE_HEIGHT, 8), 1);
+	glMemoryBarrier(GL_TEXTURE_FETCH_BARRIER_BIT);
+
+	// Build multiple scattering (samples transmittance)
+	multiScatteringShader->use();
+	glActiveTexture(GL_TEXTURE0);
+	glBindTexture(GL_TEXTURE_2D, transmittanceTable);
+	glBindImageTexture(0, multiScatteringTable, 0, GL_FALSE, 0, GL_WRITE_ONLY, GL_RGBA16F);
+	glDispatchCompute(INT_CEIL(ATMOSPHERE_MULTI_SCATTERING_RESOLUTION, 8), INT_CEIL(ATMOSPHERE_MULTI_SCATTERING_RESOLUTION, 8), 1);
+	glMemoryBarrier(GL_TEXTURE_FETCH_BARRIER_BIT);
+}
+
+void Atmosphere::buildSkyView()
+{
+	if (isCPUBaker) {
+		// Bake and upload the table
+		std::vector<glm::vec4> skyViewData;
+		bakeSkyView(transmittanceData, multiScatteringData, builtSunElevation, skyViewData, bakerPool);
+		glBindTexture(GL_TEXTURE_2D, skyViewTable);
+		glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, ATMOSPHERE_SKY_VIEW_WIDTH, ATMOSPHERE_SKY_VIEW_HEIGHT, GL_RGBA, GL_FLOAT, &skyViewData[0]);
+		glBindTexture(GL_TEXTURE_2D, 0);
+		return;
+	}
+
+	// Build sky-view (samples transmittance and multiple scattering)
+	skyViewShader->use();
+	skyViewShader->setFloat("sunElevation", builtSunElevation);
+	glActiveTexture(GL_TEXTURE0);
+	glBindTexture(GL_TEXTURE_2D, transmittanceTable);
+	glActiveTexture(GL_TEXTURE1);
+	glBindTexture(GL_TEXTURE_2D, multiScatteringTable);
+	glBindImageTexture(0, skyViewTable, 0, GL_FALSE, 0, GL_WRITE_ONLY, GL_RGBA16F);
+	glDispatchCompute(INT_CEIL(ATMOSPHERE_SKY_VIEW_WIDTH, 8), INT_CEIL(ATMOSPHERE_SKY_VIEW_HEIGHT, 8), 1);
+	glMemoryBarrier(GL_TEXTURE_FETCH_BARRIER_BIT);
+	glActiveTexture(GL_TEXTURE0);
+}
+
+unsigned int Atmosphere::createTable(GLsizei width, GLsizei height)
+{
+	unsigned int table;
+	glGenTextures(1, &table);
+	glBindTexture(GL_TEXTURE_2D, table);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+	glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA16F, width, height, 0, GL_RGBA, GL_FLOAT, NULL);
+	glBindTexture(GL_TEXTURE_2D, 0);
+	return table;
+}
@@ -0,0 +1,84 @@
+#ifndef ATMOSPHERE_H
+#define ATMOSPHERE_H
+
+#include <glad/glad.h>
+#include <GLFW/glfw3.h>
+#include <glm/glm.hpp>
+
+#include <vector>
+
+// resolutions of the lookup tables (have to match the atmosphere shaders)
+#define ATMOSPHERE_TRANSMITTANCE_WIDTH 256
+#define ATMOSPHERE_TRANSMITTANCE_HEIGHT 64
+#define ATMOSPHERE_MULTI_SCATTERING_RESOLUTION 32
+#define ATMOSPHERE_SKY_VIEW_WIDTH 192
+#define ATMOSPHERE_SKY_VIEW_HEIGHT 108
+
+class Shader;
+class ThreadPool;
+
+// Precomputed atmospheric scattering (Hillaire 2020, "A Scalable and Production Ready Sky and Atmosphere Rendering Technique")
+// Transmittance and multiple scattering lookup tables depend only on the atmosphere, so they are built once. Sky-view
+// lookup table holds the sky around the observer on the ground (for the sun of unit intensity) with the azimuth relative
+// to the sun, so it is rebuilt only when the sun elevation changes. Tables are built by compute shaders or by the CPU baker
+class Atmosphere {
+public:
+	Atmosphere();
+	~Atmosphere();
+
+	// rebuilds the lookup tables that are out of date (sun elevation is in radians)
+	void update(float sunElevation);
+	// bind the lookup tables to the given texture unit
+	void bindTransmittance(GLenum unit) const;
+	void bindMultiScattering(GLenum unit) const;
+	void bindSkyView(GLenum unit) const;
+
+	// CPU baker builds the same tables on the CPU (all the tables are rebuilt once it is switched)
+	void setCPUBaker(bool _isCPUBaker);
+	inline bool getCPUBaker() const { return isCPUBaker; }
+	inline size_t getBuilds() const { return builds; }
+
+	// CPU baker (tables are stored row by row, RGB is the value and A is unused)
+	// NOTE: Rows are baked in parallel on the pool if it is given
+	static void bakeTransmittance(std::vector<glm::vec4>& transmittance, ThreadPool* pool = nullptr);
+	static void bakeMultiScattering(const std::vector<glm::vec4>& transmittance, std::vector<glm::vec4>& multiScattering, ThreadPool* pool = nullptr);
+	static void bakeSkyView(const std::vector<glm::vec4>& transmittance, const std::vector<glm::vec4>& multiScattering, float sunElevation, std::vector<glm::vec4>& skyView, ThreadPool* pool = nullptr);
+	// transmittance from the height in the direction with the cosine of the zenith angle mu to the top of the atmosphere
+	static glm::vec3 integrateTransmittance(float height, float mu);
+	// sky luminance (for the sun of unit intensity) seen from the height in the direction (reference without the sky-view table)
+	static glm::vec3 integrateSkyLuminance(const std::vector<glm::vec4>& transmittance, const std::vector<glm::vec4>& multiScattering, float height, glm::vec3 direction, glm::vec3 sunDirection, int samples);
+	// same for the batch of the directions (4 at once with SSE2, the results differ from the single ones only by the rounding of exp)
+	static void integrateSkyLuminance(const std::vector<glm::vec4>& transmittance, const std::vector<glm::vec4>& multiScattering, float height, const glm::vec3* directions, glm::vec3 sunDirection, int samples, glm::vec3* luminances, size_t count);
+	// sun elevation in radians of the sun altitude from range [0.0, 1.0] (same as in the sky, terrain and clouds shaders)
+	static float calculateSunElevation(float sunAltitude);
+
+private:
+	void buildStaticTables();
+	void buildSkyView();
+
+	static unsigned int createTable(GLsizei width, GLsizei height);
+
+	Shader* transmittanceShader = nullptr;
+	Shader* multiScatteringShader = nullptr;
+	Shader* skyViewShader = nullptr;
+
+	// lookup tables
+	unsigned int transmittanceTable = 0;
+	unsigned int multiScatteringTable = 0;
+	unsigned int skyViewTable = 0;
+
+	// CPU copies of the static tables (only used by the CPU baker)
+	std::vector<glm::vec4> transmittanceData;
+	std::vector<glm::vec4> multiScatteringData;
+	// workers of the CPU baker (created once it is switched on)
+	ThreadPool* bakerPool = nullptr;
+
+	// data the tables were built with
+	bool isCPUBaker = false;
+	bool areStaticTablesBuilt = false;
+	float builtSunElevation = 0.f;
+	bool isSkyViewBuilt = false;
+	size_t builds = 0;
+};
+
+#endif // !ATMOSPHERE_H
@@ -0,0 +1,173 @@
+#include "AtmosphereBaker.h"
+#include "Atmosphere.h"
+#include "../ThreadPool.h"
+
+#include <iostream>
+#include <fstream>
+#include <cstdio>
+#include <cmath>
+#include <chrono>
+
+// Sun (same as the defaults of SkyboxEnvironment)
+static const float PI = 3.14159265358979323846f;
+static const float SUN_INTENSITY = 20.f;
+static const glm::vec3 SUN_COLOR_DAY = glm::vec3(1.f, 0.96f, 0.9f);
+static const glm::vec3 SUN_COLOR_SUNSET = glm::vec3(0.36f, 0.14f, 0.07f);
+
+AtmosphereBaker::AtmosphereBaker(size_t numberOfThreads)
+{
+	pool = new ThreadPool(numberOfThreads);
+}
+
+AtmosphereBaker::~AtmosphereBaker()
+{
+	delete pool;
+}
+
+bool AtmosphereBaker::bake(const std::string& directory, int sunAltitudeSteps)
+{
+	if (sunAltitudeSteps < 1) {
+		std::cout << "ERROR::ATMOSPHERE_BAKER::bake() At least one sun altitude has to be baked!" << std::endl;
+		return false;
+	}
+	auto start = std::chrono::high_resolution_clock::now();
+
+	// Tables which do not depend on the sun
+	bakeStaticTables();
+	if (!writePFM(directory + "/transmittance.pfm", ATMOSPHERE_TRANSMITTANCE_WIDTH, ATMOSPHERE_TRANSMITTANCE_HEIGHT, transmittance))
+		return false;
+	if (!writePFM(directory + "/multiScattering.pfm", ATMOSPHERE_MULTI_SCATTERING_RESOLUTION, ATMOSPHERE_MULTI_SCATTERING_RESOLUTION, multiScattering))
+		return false;
+
+	// Index of the baked sun altitudes (altitude and elevation in radians of every file)
+	std::ofstream index(directory + "/sun.txt");
+	if (!index.is_open()) {
+		std::cout << "ERROR::ATMOSPHERE_BAKER::bake() Unable to write the index to " << directory << "!" << std::endl;
+		return false;
+	}
+	index << "# step altitude elevation" << std::endl;
+
+	// Sky-view tables and the reference skies for every sun altitude
+	std::vector<glm::vec4> skyView;
+	std::vector<glm::vec4> luminance;
+	std::vector<glm::vec4> display;
+	for (int step = 0; step < sunAltitudeSteps; ++step) {
+		float sunAltitude = sunAltitudeSteps > 1 ? static_cast<float>(step) / static_cast<float>(sunAltitudeSteps - 1) : 1.f;
+		float sunElevation = Atmosphere::calculateSunElevation(sunAltitude);
+		index << step << " " << sunAltitude << " " << sunElevation << std::endl;
+
+		char suffix[16];
+		snprintf(suffix, sizeof(suffix), "_%03d", step);
+		Atmosphere::bakeSkyView(transmittance, multiScattering, sunElevation, skyView, pool);
+		if (!writePFM(directory + "/skyView" + suffix + ".pfm", ATMOSPHERE_SKY_VIEW_WIDTH, ATMOSPHERE_SKY_VIEW_HEIGHT, skyView))
+			return false;
+		renderReferenceSky(sunElevation, SUN_INTENSITY, luminance, display);
+		if (!writePFM(directory + "/reference" + suffix + ".pfm", ATMOSPHERE_REFERENCE_WIDTH, ATMOSPHERE_REFERENCE_HEIGHT, luminance))
+			return false;
+		if (!writePPM(directory + "/reference" + suffix + ".ppm", ATMOSPHERE_REFERENCE_WIDTH, ATMOSPHERE_REFERENCE_HEIGHT, display))
+			return false;
+	}
+
+	auto end = std::chrono::high_resolution_clock::now();
+	std::cout << "Atmosphere baked (" << sunAltitudeSteps << " sun altitudes, " << pool->getNumberOfThreads() << " threads) in ";
+	std::cout << std::chrono::duration<double>(end - start).count() << " s to " << directory << std::endl;
+	return true;
+}
+
+void AtmosphereBaker::bakeStaticTables()
+{
+	if (areStaticTablesBaked)
+		return;
+	Atmosphere::bakeTransmittance(transmittance, pool);
+	Atmosphere::bakeMultiScattering(transmittance, multiScattering, pool);
+	areStaticTablesBaked = true;
+}
+
+void AtmosphereBaker::renderReferenceSky(float sunElevation, float sunIntensity, std::vector<glm::vec4>& luminance, std::vector<glm::vec4>& display)
+{
+	bakeStaticTables();
+
+	// Light color (same as skyPanorama.comp)
+	glm::vec3 sunDirection = glm::vec3(std::cos(sunElevation), std::sin(sunElevation), 0.f);
+	float sigmoid = 1.f / (1.f + std::exp(8.f - sunDirection.y * 40.f));
+	float a = glm::clamp(sigmoid, 0.f, 1.f);
+	glm::vec3 lightColor = (SUN_COLOR_DAY * a + SUN_COLOR_SUNSET * (1.f - a)) * (sunIntensity / 20.f);
+
+	luminance.resize(ATMOSPHERE_REFERENCE_WIDTH * ATMOSPHERE_REFERENCE_HEIGHT);
+	display.resize(ATMOSPHERE_REFERENCE_WIDTH * ATMOSPHERE_REFERENCE_HEIGHT);
+	for (int y = 0; y < ATMOSPHERE_REFERENCE_HEIGHT; ++y) {
+		pool->enqueue([this, y, sunDirection, sunIntensity, lightColor, &luminance, &display] {
+			// Panorama coordinates to the view directions (same as skyPanorama.comp)
+			std::vector<glm::vec3> directions(ATMOSPHERE_REFERENCE_WIDTH);
+			for (int x = 0; x < ATMOSPHERE_REFERENCE_WIDTH; ++x) {
+				float u = (static_cast<float>(x) + 0.5f) / ATMOSPHERE_REFERENCE_WIDTH;
+				float v = (static_cast<float>(y) + 0.5f) / ATMOSPHERE_REFERENCE_HEIGHT;
+				float azimuth = (u - 0.5f) * 2.f * PI;
+				float elevation = v * v * 0.5f * PI;
+				directions[x] = glm::vec3(std::cos(elevation) * std::cos(azimuth), std::sin(elevation), std::cos(elevation) * std::sin(azimuth));
+			}
+
+			// Full integral along the view rays (whole row at once)
+			std::vector<glm::vec3> sky(ATMOSPHERE_REFERENCE_WIDTH);
+			Atmosphere::integrateSkyLuminance(transmittance, multiScattering, 0.f, &directions[0], sunDirection, ATMOSPHERE_REFERENCE_SAMPLES, &sky[0], ATMOSPHERE_REFERENCE_WIDTH);
+
+			for (int x = 0; x < ATMOSPHERE_REFERENCE_WIDTH; ++x) {
+				// Sky color the ray displays
+				glm::vec3 color = sunIntensity * sky[x] * lightColor;
+				luminance[x + y * ATMOSPHERE_REFERENCE_WIDTH] = glm::vec4(color, 1.f);
+
+				// Tone mapping, gamma and contrast (same as sky.frag)
+				color = color / (color + 0.5f);
+				color = glm::mix(color, glm::pow(color, glm::vec3(1.f / 2.2f)), 0.85f);
+				display[x + y * ATMOSPHERE_REFERENCE_WIDTH] = glm::vec4(color, 1.f);
+			}
+		});
+	}
+	pool->wait();
+}
+
+bool AtmosphereBaker::writePFM(const std::string& path, int width, int height, const std::vector<glm::vec4>& data)
+{
+	std::ofstream file(path, std::ios::binary);
+	if (!file.is_open()) {
+		std::cout << "ERROR::ATMOSPHERE_BAKER::writePFM() Unable to open " << path << "!" << std::endl;
+		return false;
+	}
+
+	// Header (negative scale is little endian), rows go from the bottom to the top
+	file << "PF\n" << width << " " << height << "\n-1.0\n";
+	std::vector<float> row(static_cast<size_t>(width) * 3);
+	for (int y = 0; y < height; ++y) {
+		for (int x = 0; x < width; ++x) {
+			const glm::vec4& texel = data[x + y * width];
+			row[x * 3 + 0] = texel.r;
+			row[x * 3 + 1] = texel.g;
+			row[x * 3 + 2] = texel.b;
+		}
+		file.write(reinterpret_cast<const char*>(row.data()), row.size() * sizeof(float));
+	}
+	return file.good();
+}
+
+bool AtmosphereBaker::writePPM(const std::string& path, int width, int height, const std::vector<glm::vec4>& data)
+{
+	std::ofstream file(path, std::ios::binary);
+	if (!file.is_open()) {
+		std::cout << "ERROR::ATMOSPHERE_BAKER::writePPM() Unable to open " << path << "!" << std::endl;
+		return false;
+	}
+
+	// Header, rows go from the top to the bottom
+	file << "P6\n" << width << " " << height << "\n255\n";
+	std::vector<unsigned char> row(static_cast<size_t>(width) * 3);
+	for (int y = height - 1; y >= 0; --y) {
+		for (int x = 0; x < width; ++x) {
+			glm::vec3 color = glm::clamp(glm::vec3(data[x + y * width]), 0.f, 1.f);
+			row[x * 3 + 0] = static_cast<unsigned char>(color.r * 255.f + 0.5f);
+			row[x * 3 + 1] = static_cast<unsigned char>(color.g * 255.f + 0.5f);
+			row[x * 3 + 2] = static_cast<unsigned char>(color.b * 255.f + 0.5f);
+		}
+		file.write(reinterpret_cast<const char*>(row.data()), row.size());
+	}
+	return file.good();
+}
\ No newline at end of file
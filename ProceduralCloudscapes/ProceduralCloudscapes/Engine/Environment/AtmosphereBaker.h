@@ -0,0 +1,51 @@
+#ifndef ATMOSPHERE_BAKER_H
+#define ATMOSPHERE_BAKER_H
+
+#include <glm/glm.hpp>
+
+#include <vector>
+#include <string>
+
+// resolution of the reference sky images (same layout as the sky panorama of SkyboxEnvironment)
+#define ATMOSPHERE_REFERENCE_WIDTH 512
+#define ATMOSPHERE_REFERENCE_HEIGHT 128
+// number of samples along every view ray of the reference sky
+#define ATMOSPHERE_REFERENCE_SAMPLES 128
+
+class ThreadPool;
+
+// Offline (headless) baker of the atmosphere lookup tables on the CPU
+// Tables are written as PFM images (linear RGB, bottom row first like the GL textures) for a grid of sun altitudes,
+// together with the reference sky images which are integrated per pixel without the sky-view table. This does not
+// need an OpenGL context, so it can run on the machines without a GPU
+class AtmosphereBaker {
+public:
+	// 0 uses all the hardware threads except one
+	AtmosphereBaker(size_t numberOfThreads = 0);
+	~AtmosphereBaker();
+
+	// bakes all the tables and the reference skies for the sun altitudes from range [0.0, 1.0] into the directory (has to exist)
+	bool bake(const std::string& directory, int sunAltitudeSteps);
+
+	// bakes the tables which do not depend on the sun (done once)
+	void bakeStaticTables();
+	// renders the sky the way sky.frag displays it (sun azimuth is 0, sun disk is not included)
+	void renderReferenceSky(float sunElevation, float sunIntensity, std::vector<glm::vec4>& luminance, std::vector<glm::vec4>& display);
+
+	inline const std::vector<glm::vec4>& getTransmittance() const { return transmittance; }
+	inline const std::vector<glm::vec4>& getMultiScattering() const { return multiScattering; }
+
+	// image writers
+	static bool writePFM(const std::string& path, int width, int height, const std::vector<glm::vec4>& data);
+	static bool writePPM(const std::string& path, int width, int height, const std::vector<glm::vec4>& data);
+
+private:
+	ThreadPool* pool;
+
+	// static tables
+	std::vector<glm::vec4> transmittance;
+	std::vector<glm::vec4> multiScattering;
+	bool areStaticTablesBaked = false;
+};
+
+#endif // !ATMOSPHERE_BAKER_H
@@ -32,26 +32,30 @@ public:
 
 		// framebuffer configuration
 		framebuffer = new FrameBufferObject();
-		// create a color attachment texture
-		framebuffer->attachColorTexture((unsigned int)window->getWidth(), (unsigned int)window->getHeight());
-		// create a renderbuffer object for depth and stencil attachment (we won't be sampling these)
-		framebuffer->attachDepthTexture((unsigned int)window->getWidth(), (unsigned int)window->getHeight());
+		// create a color attachment texture (it is shown directly, so it keeps more precision than the compact HDR format)
+		// NOTE: Environments are drawn as fullscreen passes without depth testing, so there is no depth attachment
+		framebuffer->attachColorTexture((unsigned int)window->getWidth(), (unsigned int)window->getHeight(), TextureFormat::RGBA16F);
 		// now that we actually created the framebuffer and added all attachments we want to check if it is actually complete now
 		if (!framebuffer->checkStatus())
 			std::cout << "ERROR::FRAMEBUFFER:: Framebuffer is not complete!" << std::endl;
+		// resize the framebuffer together with the window
+		window->registerRenderTarget(framebuffer);
+
+		// create a screen shader for rendering the buffer on the screen (once, not every frame)
+		screenShader = new ScreenShader("Shaders/Default/textureShader2D.frag");
 	}
 	virtual ~Environment() {
 		delete data;
+		window->unregisterRenderTarget(framebuffer);
 		delete framebuffer;
+		delete screenShader;
 	};
 
 	static Environment* createEnvironment(EnvironmentType environmentType, Window* _window);
 
 	Texture* getTexture() const { return framebuffer->getColorTexture(0); }
 
-	void draw() {
-		// clear the buffers
-		glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+	virtual void draw() {
 		// bind the framebuffer
 		framebuffer->bind();
 		// clear its data before any rendering
@@ -63,18 +67,14 @@ public:
 		// unbind the buffer (set the default buffer)
 		FrameBufferObject::unbind();
 
-		// create a screen shader for rendering the buffer on the screen
-		ScreenShader* screenShader = new ScreenShader("Shaders/Default/textureShader2D.frag");
-		// disable depth test so screen-space quad isn't discarded due to depth test
-		glDisable(GL_DEPTH_TEST);
 		// draw the screen shader with the buffer texture
+		// NOTE: Scene draws the environment as a background pass (depth tested at the far plane, without depth writes)
 		screenShader->draw(*getTexture());
-		// delete the created screen shader
-		delete screenShader;
-		// enable back depth test
-		glEnable(GL_DEPTH_TEST);
 	}
 
+	// per-frame work the scene objects depend on (called before anything in the scene is drawn)
+	virtual void prepare() {}
+
 	virtual void update() = 0;
 
 	void buildGUI() override {
@@ -138,6 +138,7 @@ protected:
 	EnvironmentData* data = nullptr;
 	Window* window;
 	FrameBufferObject* framebuffer;
+	ScreenShader* screenShader;
 };
 
 #endif // !ENVIRONMENT_H
@@ -1,4 +1,5 @@
 #include "SkyboxEnvironment.h"
+#include "Atmosphere.h"
 #include "../ScreenShader.h"
 #include "../FrameBufferObject.h"
 #include "../Utilities.h"
@@ -22,12 +23,73 @@ SkyboxEnvironment::SkyboxEnvironment(Window* _window) : Environment(_window)
 	skyboxData->isVignette = true;
 
 	// Build and compile shader program
-	skyboxShader = new ScreenShader("Shaders/Skybox/sky.frag");
+	// NOTE: Sky lies on the far plane, so the pixels covered by the scene objects are not shaded (see draw)
+	skyboxShader = new ScreenShader("Shaders/Skybox/sky.frag", "Shaders/Screen/farPlane.vert");
+
+	// Create precomputed atmosphere
+	atmosphere = new Atmosphere();
+
+	// Create sky panorama
+	panoramaShader = new Shader();
+	panoramaShader->attachShader("Shaders/Skybox/skyPanorama.comp", ShaderInfo(ShaderType::kCompute));
+	panoramaShader->linkProgram();
+	glGenTextures(1, &panoramaTexture);
+	glBindTexture(GL_TEXTURE_2D, panoramaTexture);
+	glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA16F, SKY_PANORAMA_WIDTH, SKY_PANORAMA_HEIGHT, 0, GL_RGBA, GL_FLOAT, NULL);
+	// azimuth wraps around, elevation is clamped to the horizon and the zenith
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+	glBindTexture(GL_TEXTURE_2D, 0);
+
+	// Create aerial perspective volume
+	aerialPerspectiveShader = new Shader();
+	aerialPerspectiveShader->attachShader("Shaders/Skybox/aerialPerspective.comp", ShaderInfo(ShaderType::kCompute));
+	aerialPerspectiveShader->linkProgram();
+	glGenTextures(1, &aerialPerspectiveVolume);
+	glBindTexture(GL_TEXTURE_3D, aerialPerspectiveVolume);
+	glTexImage3D(GL_TEXTURE_3D, 0, GL_RGBA16F, AERIAL_PERSPECTIVE_RESOLUTION, AERIAL_PERSPECTIVE_RESOLUTION, AERIAL_PERSPECTIVE_RESOLUTION, 0, GL_RGBA, GL_FLOAT, NULL);
+	glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+	glBindTexture(GL_TEXTURE_3D, 0);
 }
 
 SkyboxEnvironment::~SkyboxEnvironment()
 {
 	delete skyboxShader;
+	delete atmosphere;
+	delete panoramaShader;
+	glDeleteTextures(1, &panoramaTexture);
+	delete aerialPerspectiveShader;
+	glDeleteTextures(1, &aerialPerspectiveVolume);
+}
+
+void SkyboxEnvironment::prepare()
+{
+	// evaluate the sun once for all the passes of this frame
+	updateSun();
+
+	// rebuild atmosphere lookup tables if the sun has moved
+	atmosphere->update(getSunElevation());
+
+	// rebuild sky panorama if the sun or the lookup tables have changed
+	if (isSkyDirty || panoramaAtmosphereBuilds != atmosphere->getBuilds())
+		buildPanorama();
+
+	// rebuild aerial perspective for the current camera
+	buildAerialPerspective();
+}
+
+void SkyboxEnvironment::draw()
+{
+	// render the sky straight into the default framebuffer (the environment framebuffer has none of the scene depth,
+	// so only here the pixels covered by the scene objects fail the far plane depth test before sky.frag runs)
+	update();
+	skyboxShader->draw();
 }
 
 void SkyboxEnvironment::update()
@@ -45,12 +107,11 @@ void SkyboxEnvironment::update()
 	shader->setVec2("resolution", window->getSize());
 
 	// set shaders sky info
-	shader->setFloat("sunAltitude", getSunAltitude());
-	shader->setFloat("sunAzimuth", getSunAzimuth());
-	shader->setFloat("sunIntensity", getSunIntensity());
-	shader->setVec3("sunColorDay", getSunColorDay().getf());
-	shader->setVec3("sunColorSunset", getSunColorSunset().getf());
+	setSunUniforms(shader);
 	shader->setFloat("sunScale", getSunScale());
+	glActiveTexture(GL_TEXTURE6);
+	glBindTexture(GL_TEXTURE_2D, panoramaTexture);
+	glActiveTexture(GL_TEXTURE0);
 
 	// set shaders post-processing info
 	shader->setBool("isGammaAndContrast", getIsGammaAndContrast());
@@ -93,6 +154,20 @@ void SkyboxEnvironment::extendGUI()
 		setSunColorSunset(Color::fromIMGUI(sunColorSunset));
 	}
 
+	// Create skybox atmosphere header
+	if (ImGui::CollapsingHeader("Atmosphere", ImGuiTreeNodeFlags_DefaultOpen))
+	{
+		// CPU baker
+		bool isCPUBaker = atmosphere->getCPUBaker();
+		imgui_exp::ToggleButton("CPU baker", &isCPUBaker);
+		atmosphere->setCPUBaker(isCPUBaker);
+
+		// Lookup table statistics
+		ImGui::Text("Sky-view builds: %zu", atmosphere->getBuilds());
+		ImGui::Text("Sky panorama builds: %zu", getPanoramaBuilds());
+		ImGui::Text("Aerial perspective: %dx%dx%d (%.0f km)", AERIAL_PERSPECTIVE_RESOLUTION, AERIAL_PERSPECTIVE_RESOLUTION, AERIAL_PERSPECTIVE_RESOLUTION, AERIAL_PERSPECTIVE_DISTANCE / 1000.f);
+	}
+
 	// Create skybox post processing header
 	if (ImGui::CollapsingHeader("Post-processing", ImGuiTreeNodeFlags_DefaultOpen))
 	{
@@ -107,3 +182,82 @@ void SkyboxEnvironment::extendGUI()
 		setVignette(isVignette);
 	}
 }
+
+
+float SkyboxEnvironment::getSunElevation() const
+{
+	return Atmosphere::calculateSunElevation(getSunAltitude());
+}
+
+void SkyboxEnvironment::setSunUniforms(Shader* shader) const
+{
+	shader->setVec3("sunDirection", sunDirection);
+	shader->setFloat("sunIntensity", getSunIntensity());
+	shader->setVec3("sunColor", sunColor);
+	shader->setVec3("sunTransmittance", sunTransmittance);
+}
+
+void SkyboxEnvironment::updateSun()
+{
+	// same mapping of the sun azimuth as the shaders used to have
+	float elevation = getSunElevation();
+	float azimuth = (1.f - getSunAzimuth() * 0.7f) * 4.6f;
+	sunDirection = glm::vec3(glm::cos(azimuth) * glm::cos(elevation), glm::sin(elevation), glm::sin(azimuth) * glm::cos(elevation));
+
+	// blend between the day and the sunset colors close to the horizon
+	float sigmoid = 1.f / (1.f + glm::exp(8.f - sunDirection.y * 40.f));
+	float a = glm::clamp(sigmoid, 0.f, 1.f);
+	sunColor = getSunColorDay().getf() * a + getSunColorSunset().getf() * (1.f - a);
+
+	// light that reaches the camera through the atmosphere (relative, so the sun at the zenith keeps the set colors)
+	float height = glm::max(window->getCamera()->getPosition().y, 0.f);
+	glm::vec3 zenithTransmittance = Atmosphere::integrateTransmittance(height, 1.f);
+	sunTransmittance = Atmosphere::integrateTransmittance(height, sunDirection.y) / zenithTransmittance;
+}
+
+void SkyboxEnvironment::buildPanorama()
+{
+	// render the sky of the upper hemisphere from the sky-view lookup table
+	panoramaShader->use();
+	panoramaShader->setVec3("sunDirection", sunDirection);
+	panoramaShader->setFloat("sunIntensity", getSunIntensity());
+	panoramaShader->setVec3("sunColor", sunColor);
+	atmosphere->bindSkyView(0);
+	glBindImageTexture(0, panoramaTexture, 0, GL_FALSE, 0, GL_WRITE_ONLY, GL_RGBA16F);
+	glDispatchCompute(INT_CEIL(SKY_PANORAMA_WIDTH, 8), INT_CEIL(SKY_PANORAMA_HEIGHT, 8), 1);
+	// make sure the panorama is written before the sky samples it
+	glMemoryBarrier(GL_TEXTURE_FETCH_BARRIER_BIT);
+
+	// remember what the panorama was built with
+	isSkyDirty = false;
+	panoramaAtmosphereBuilds = atmosphere->getBuilds();
+	++panoramaBuilds;
+}
+
+void SkyboxEnvironment::bindAerialPerspective(GLenum unit) const
+{
+	glActiveTexture(GL_TEXTURE0 + unit);
+	glBindTexture(GL_TEXTURE_3D, aerialPerspectiveVolume);
+}
+
+void SkyboxEnvironment::buildAerialPerspective()
+{
+	Camera* camera = window->getCamera();
+
+	// march through the froxels of the camera frustum
+	aerialPerspectiveShader->use();
+	aerialPerspectiveShader->setVec3("cameraPosition", camera->getPosition());
+	aerialPerspectiveShader->setMat4("inverseProjection", glm::inverse(window->getProjectionMatrix()));
+	aerialPerspectiveShader->setMat4("inverseView", glm::inverse(camera->getViewMatrix()));
+	aerialPerspectiveShader->setVec3("sunDirection", sunDirection);
+	aerialPerspectiveShader->setFloat("sunIntensity", getSunIntensity());
+	aerialPerspectiveShader->setVec3("sunColor", sunColor);
+	aerialPerspectiveShader->setBool("isGammaAndContrast", getIsGammaAndContrast());
+	atmosphere->bindTransmittance(0);
+	atmosphere->bindMultiScattering(1);
+	glActiveTexture(GL_TEXTURE0);
+	glBindImageTexture(0, aerialPerspectiveVolume, 0, GL_TRUE, 0, GL_WRITE_ONLY, GL_RGBA16F);
+	glDispatchCompute(INT_CEIL(AERIAL_PERSPECTIVE_RESOLUTION, 8), INT_CEIL(AERIAL_PERSPECTIVE_RESOLUTION, 8), 1);
+	// make sure the volume is written before the scene objects sample it
+	glMemoryBarrier(GL_TEXTURE_FETCH_BARRIER_BIT);
+}
\ No newline at end of file
@@ -5,8 +5,17 @@
 #include "../../Engine/Color.h"
 #include <glm/glm.hpp>
 
+// resolution of the cached sky panorama (azimuth x elevation of the upper hemisphere)
+#define SKY_PANORAMA_WIDTH 512
+#define SKY_PANORAMA_HEIGHT 128
+// resolution of the aerial perspective volume (froxels of the camera frustum) and the distance it covers (has to match the shaders)
+#define AERIAL_PERSPECTIVE_RESOLUTION 32
+#define AERIAL_PERSPECTIVE_DISTANCE 1e5f
+
+class Shader;
 class ScreenShader;
 class FrameBufferObject;
+class Atmosphere;
 
 struct SkyboxEnvironmentData : EnvironmentData {
 
@@ -45,19 +54,22 @@ public:
 	SkyboxEnvironment(Window* _window);
 	~SkyboxEnvironment();
 
+	void prepare() override;
+	void draw() override;
 	void update() override;
     void extendGUI() override;
 
     // SETTERS
 
-    void setSunAltitude(float _sunAltitude) { static_cast<SkyboxEnvironmentData*>(data)->sunAltitude = _sunAltitude; }
-    void setSunAzimuth(float _sunAzimuth) { static_cast<SkyboxEnvironmentData*>(data)->sunAzimuth = _sunAzimuth; }
-    void setSunIntensity(float _sunIntensity) { static_cast<SkyboxEnvironmentData*>(data)->sunIntensity = _sunIntensity; }
-    void setSunScale(float _sunScale) { static_cast<SkyboxEnvironmentData*>(data)->sunScale = _sunScale; }
+    // NOTE: Sky panorama is rebuilt only once the sun properties have changed
+    void setSunAltitude(float _sunAltitude) { isSkyDirty |= _sunAltitude != getSunAltitude(); static_cast<SkyboxEnvironmentData*>(data)->sunAltitude = _sunAltitude; }
+    void setSunAzimuth(float _sunAzimuth) { isSkyDirty |= _sunAzimuth != getSunAzimuth(); static_cast<SkyboxEnvironmentData*>(data)->sunAzimuth = _sunAzimuth; }
+    void setSunIntensity(float _sunIntensity) { isSkyDirty |= _sunIntensity != getSunIntensity(); static_cast<SkyboxEnvironmentData*>(data)->sunIntensity = _sunIntensity; }
+    void setSunScale(float _sunScale) { isSkyDirty |= _sunScale != getSunScale(); static_cast<SkyboxEnvironmentData*>(data)->sunScale = _sunScale; }
     void setGammaAndContrast(bool _isGammaAndContrast) { static_cast<SkyboxEnvironmentData*>(data)->isGammaAndContrast = _isGammaAndContrast; }
     void setVignette(bool _isVignette) { static_cast<SkyboxEnvironmentData*>(data)->isVignette = _isVignette; }
-    void setSunColorDay(Color _sunColorDay) { static_cast<SkyboxEnvironmentData*>(data)->sunColorDay = _sunColorDay; }
-    void setSunColorSunset(Color _sunColorSunset) { static_cast<SkyboxEnvironmentData*>(data)->sunColorSunset = _sunColorSunset; }
+    void setSunColorDay(Color _sunColorDay) { isSkyDirty |= _sunColorDay.getf() != getSunColorDay().getf(); static_cast<SkyboxEnvironmentData*>(data)->sunColorDay = _sunColorDay; }
+    void setSunColorSunset(Color _sunColorSunset) { isSkyDirty |= _sunColorSunset.getf() != getSunColorSunset().getf(); static_cast<SkyboxEnvironmentData*>(data)->sunColorSunset = _sunColorSunset; }
 
     // GETTERS
 
@@ -69,10 +81,48 @@ public:
     inline bool getIsVignette() const { return static_cast<SkyboxEnvironmentData*>(data)->isVignette; }
     inline Color getSunColorDay() const { return static_cast<SkyboxEnvironmentData*>(data)->sunColorDay; }
     inline Color getSunColorSunset() const { return static_cast<SkyboxEnvironmentData*>(data)->sunColorSunset; }
+    // sun elevation above the horizon in radians (same as in sky.frag)
+    float getSunElevation() const;
+    // sun evaluated once per frame (in prepare)
+    inline glm::vec3 getSunDirection() const { return sunDirection; }
+    inline glm::vec3 getSunColor() const { return sunColor; }
+    inline glm::vec3 getSunTransmittance() const { return sunTransmittance; }
+    // sets the sun of the current frame to the shader (sunDirection, sunIntensity, sunColor and sunTransmittance)
+    void setSunUniforms(Shader* shader) const;
+    inline size_t getPanoramaBuilds() const { return panoramaBuilds; }
+
+    // binds the aerial perspective volume (fog color and amount between the camera and the scene objects) to the given texture unit
+    void bindAerialPerspective(GLenum unit) const;
 
     // DRAWING
 
     ScreenShader* skyboxShader;
+    Atmosphere* atmosphere;
+
+private:
+    void updateSun();
+    void buildPanorama();
+    void buildAerialPerspective();
+
+    // sun of the current frame
+    glm::vec3 sunDirection = glm::vec3(0.f, 1.f, 0.f);
+    // blend of the day and sunset colors at the current sun elevation
+    glm::vec3 sunColor = glm::vec3(1.f);
+    // transmittance of the atmosphere from the camera to the sun (relative to the sun at the zenith)
+    glm::vec3 sunTransmittance = glm::vec3(1.f);
+
+    // sky panorama (sky without the sun disk which stays analytic in sky.frag)
+    Shader* panoramaShader;
+    unsigned int panoramaTexture;
+
+    // aerial perspective (rebuilt every frame since it follows the camera)
+    Shader* aerialPerspectiveShader;
+    unsigned int aerialPerspectiveVolume;
+
+    // data the sky panorama was built with
+    bool isSkyDirty = true;
+    size_t panoramaAtmosphereBuilds = 0;
+    size_t panoramaBuilds = 0;
 };
 
 #endif // !SKYBOX_ENVIRONMENT_H
@@ -1,6 +1,6 @@
 #include "FrameBufferObject.h"
 
-#include "Texture.h"
+#include <iostream>
 
 FrameBufferObject::FrameBufferObject()
 {
@@ -11,11 +11,8 @@ FrameBufferObject::~FrameBufferObject()
 {
 	// delete the frame buffer
 	glDeleteFramebuffers(1, &FBO);
-	// delete color attachments
-	for (auto colorTex : colorTextures)
-	{
-		glDeleteTextures(1, &colorTex->ID);
-	}
+	// delete attachments
+	deleteAttachments();
 }
 
 void FrameBufferObject::bind() const
@@ -26,7 +23,7 @@ void FrameBufferObject::bind() const
 void FrameBufferObject::clear() const
 {
 	glClearColor(0.0f, 0.0f, 0.0f, 1.0f);
-	glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+	glClear(depthPolicy == DepthPolicy::none ? GL_COLOR_BUFFER_BIT : GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 }
 
 void FrameBufferObject::unbind()
@@ -42,12 +39,14 @@ bool FrameBufferObject::checkStatus()
 	return true;
 }
 
-void FrameBufferObject::attachColorTexture(unsigned int width, unsigned int height)
+void FrameBufferObject::attachColorTexture(unsigned int _width, unsigned int _height, TextureFormat format)
 {
 	// first bind the FBO
 	bind();
 
-	Texture* colorTex = new Texture(TextureType::twoDimensional, glm::vec3(width, height, 0.0), 3, false);
+	width = _width;
+	height = _height;
+	Texture* colorTex = new Texture(TextureType::twoDimensional, glm::vec3(width, height, 0.0), format);
 
 	glFramebufferTexture2D(GL_FRAMEBUFFER, getColorAttachmentNumber(), colorTex->getGLType(), colorTex->ID, 0);
 
@@ -56,24 +55,89 @@ void FrameBufferObject::attachColorTexture(unsigned int width, unsigned int heig
 
 	// add the attachment to the list
 	colorTextures.push_back(colorTex);
+	colorFormats.push_back(format);
 }
 
-void FrameBufferObject::attachDepthTexture(unsigned int width, unsigned int height)
+void FrameBufferObject::attachDepth(unsigned int _width, unsigned int _height, DepthPolicy policy)
 {
+	if (depthPolicy != DepthPolicy::none) {
+		std::cout << "ERROR::FRAME_BUFFER_OBJECT::attachDepth() Depth is already attached!" << std::endl;
+		return;
+	}
+	depthPolicy = policy;
+	width = _width;
+	height = _height;
+
 	// first bind the FBO
 	bind();
 
-	glGenTextures(1, &depthTexture);
-	glBindTexture(GL_TEXTURE_2D, depthTexture);
-	glTexImage2D(GL_TEXTURE_2D, 0, GL_DEPTH_COMPONENT32, width, height, 0, GL_DEPTH_COMPONENT, GL_FLOAT, NULL);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-	glFramebufferTexture(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, depthTexture, 0);
+	switch (depthPolicy)
+	{
+	case DepthPolicy::renderbuffer:
+		glGenRenderbuffers(1, &depthRenderbuffer);
+		glBindRenderbuffer(GL_RENDERBUFFER, depthRenderbuffer);
+		glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, width, height);
+		glBindRenderbuffer(GL_RENDERBUFFER, 0);
+		glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, depthRenderbuffer);
+		break;
+	case DepthPolicy::texture:
+		glGenTextures(1, &depthTexture);
+		glBindTexture(GL_TEXTURE_2D, depthTexture);
+		glTexStorage2D(GL_TEXTURE_2D, 1, GL_DEPTH_COMPONENT32, width, height);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+		glFramebufferTexture(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, depthTexture, 0);
+		break;
+	default:
+		break;
+	}
 
 	// unbind the FBO since the configuration is done
 	unbind();
 }
 
+void FrameBufferObject::resize(unsigned int _width, unsigned int _height)
+{
+	// minimized window has no size (attachments stay as they are until it is restored)
+	if ((_width == width && _height == height) || _width == 0 || _height == 0)
+		return;
+
+	// storage of the attachments is immutable, so they are created again
+	std::vector<TextureFormat> formats(colorFormats);
+	DepthPolicy policy = depthPolicy;
+	deleteAttachments();
+	for (TextureFormat format : formats)
+		attachColorTexture(_width, _height, format);
+	if (policy != DepthPolicy::none)
+		attachDepth(_width, _height, policy);
+	width = _width;
+	height = _height;
+
+	bind();
+	if (!checkStatus())
+		std::cout << "ERROR::FRAME_BUFFER_OBJECT::resize() Framebuffer is not complete!" << std::endl;
+	unbind();
+}
+
+void FrameBufferObject::deleteAttachments()
+{
+	// delete color attachments
+	for (auto colorTex : colorTextures)
+	{
+		delete colorTex;
+	}
+	colorTextures.clear();
+	colorFormats.clear();
+	// delete depth attachment
+	if (depthTexture != 0)
+		glDeleteTextures(1, &depthTexture);
+	if (depthRenderbuffer != 0)
+		glDeleteRenderbuffers(1, &depthRenderbuffer);
+	depthTexture = 0;
+	depthRenderbuffer = 0;
+	depthPolicy = DepthPolicy::none;
+}
+
 GLenum FrameBufferObject::getColorAttachmentNumber() const
 {
 	return static_cast<GLenum>(GL_COLOR_ATTACHMENT0 + colorTextures.size());
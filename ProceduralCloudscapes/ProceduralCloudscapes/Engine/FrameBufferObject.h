@@ -7,7 +7,17 @@
 
 #include <vector>
 
-class Texture;
+#include "Texture.h"
+
+// how the depth of the FBO is stored
+enum class DepthPolicy {
+	// passes which are not depth tested
+	none = 0,
+	// depth tested passes (depth is never sampled, so it can stay in the renderbuffer)
+	renderbuffer = 1,
+	// depth is sampled or copied into by the later passes
+	texture = 2
+};
 
 class FrameBufferObject {
 public:
@@ -25,14 +35,28 @@ public:
 	// determines whether the FBO is complete
 	bool checkStatus();
 
-	void attachColorTexture(unsigned int width, unsigned int height);
-	void attachDepthTexture(unsigned int width, unsigned int height);
+	// HDR color without alpha by default (quarter of the RGB32F bandwidth), RGBA16F when alpha or more precision is needed
+	void attachColorTexture(unsigned int width, unsigned int height, TextureFormat format = TextureFormat::R11G11B10F);
+	void attachDepth(unsigned int width, unsigned int height, DepthPolicy policy);
+	// allocates all the attachments again in the new size (same formats and depth policy)
+	// NOTE: Attachments are new textures afterwards, so they must not be cached by their users
+	void resize(unsigned int _width, unsigned int _height);
 
+	inline unsigned int getWidth() const { return width; }
+	inline unsigned int getHeight() const { return height; }
 	Texture* getColorTexture(size_t texIndex) const { return colorTextures.at(texIndex); }
 	inline unsigned int getDepthTextureID() const { return depthTexture; }
+	inline DepthPolicy getDepthPolicy() const { return depthPolicy; }
 private:
+	unsigned int width{ 0 };
+	unsigned int height{ 0 };
+	DepthPolicy depthPolicy{ DepthPolicy::none };
 	unsigned int depthTexture{ 0 };
+	unsigned int depthRenderbuffer{ 0 };
 	std::vector<Texture*> colorTextures;
+	std::vector<TextureFormat> colorFormats;
+
+	void deleteAttachments();
 
 	// determines the suitable GLenum for the current color texture
 	GLenum getColorAttachmentNumber() const;
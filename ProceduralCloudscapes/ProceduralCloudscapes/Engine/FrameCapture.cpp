@@ -0,0 +1,392 @@
+#include "FrameCapture.h"
+
+#include "ThreadPool.h"
+
+#include <imgui.h>
+#include <iostream>
+#include <cstdio>
+#include <ctime>
+#include <vector>
+
+#include <sys/types.h>
+#include <sys/stat.h>
+#ifdef _WIN32
+#include <direct.h>
+#endif
+
+namespace {
+	// CRC of the PNG chunks (polynomial 0xEDB88320)
+	uint32_t crc32(uint32_t crc, const unsigned char* data, size_t size)
+	{
+		static uint32_t table[256] = { 0 };
+		static bool isTableReady = false;
+		if (!isTableReady) {
+			for (uint32_t n = 0; n < 256; ++n) {
+				uint32_t c = n;
+				for (int k = 0; k < 8; ++k)
+					c = (c & 1) ? 0xEDB88320u ^ (c >> 1) : c >> 1;
+				table[n] = c;
+			}
+			isTableReady = true;
+		}
+		crc = ~crc;
+		for (size_t i = 0; i < size; ++i)
+			crc = table[(crc ^ data[i]) & 0xFF] ^ (crc >> 8);
+		return ~crc;
+	}
+
+	void appendUint32(std::vector<unsigned char>& buffer, uint32_t value)
+	{
+		buffer.push_back(static_cast<unsigned char>(value >> 24));
+		buffer.push_back(static_cast<unsigned char>(value >> 16));
+		buffer.push_back(static_cast<unsigned char>(value >> 8));
+		buffer.push_back(static_cast<unsigned char>(value));
+	}
+
+	bool writeChunk(FILE* file, const char* type, const std::vector<unsigned char>& data)
+	{
+		std::vector<unsigned char> header;
+		appendUint32(header, static_cast<uint32_t>(data.size()));
+		header.insert(header.end(), type, type + 4);
+		uint32_t crc = crc32(0, header.data() + 4, 4);
+		if (!data.empty())
+			crc = crc32(crc, data.data(), data.size());
+		std::vector<unsigned char> footer;
+		appendUint32(footer, crc);
+
+		bool isWritten = fwrite(header.data(), 1, header.size(), file) == header.size();
+		if (!data.empty())
+			isWritten = isWritten && fwrite(data.data(), 1, data.size(), file) == data.size();
+		return isWritten && fwrite(footer.data(), 1, footer.size(), file) == footer.size();
+	}
+}
+
+FrameCapture::FrameCapture(Window* _window) : window(_window)
+{
+	// One writer thread (encoding is cheaper than the frame, more threads would only compete with the texture loader)
+	writer = new ThreadPool(1);
+	window->subscribeToKeyReaction(this);
+}
+
+FrameCapture::~FrameCapture()
+{
+	// Write what has been captured so far
+	finish();
+	delete writer;
+	deleteRing();
+}
+
+void FrameCapture::requestScreenshot()
+{
+	isScreenshotRequested = true;
+}
+
+void FrameCapture::startRecording(const std::string& directory, CaptureFormat format)
+{
+	recordingDirectory = directory;
+	if (!recordingDirectory.empty() && recordingDirectory.back() != '/' && recordingDirectory.back() != '\\')
+		recordingDirectory.push_back('/');
+	if (!recordingDirectory.empty() && !createDirectory(recordingDirectory)) {
+		std::cout << "ERROR::FRAME_CAPTURE::startRecording() Unable to create the directory " << recordingDirectory << "!" << std::endl;
+		return;
+	}
+	recordingFormat = format;
+	recordedFrames = 0;
+	recording = true;
+}
+
+void FrameCapture::stopRecording()
+{
+	recording = false;
+}
+
+void FrameCapture::update()
+{
+	// Hand the finished reads to the writer (their slots are free again once the frames are written)
+	collect();
+
+	// Screenshot (requested again the next frame if it is dropped)
+	if (isScreenshotRequested) {
+		char name[64];
+		time_t now = time(nullptr);
+		strftime(name, sizeof(name), "screenshot_%Y%m%d_%H%M%S", localtime(&now));
+		isScreenshotRequested = !capture(std::string(name) + formatExtension(CaptureFormat::png), CaptureFormat::png);
+	}
+
+	// Frame of the sequence (frames are numbered by the rendered frames, so the dropped ones leave gaps)
+	if (recording) {
+		char name[32];
+		snprintf(name, sizeof(name), "frame_%06llu", static_cast<unsigned long long>(recordedFrames++));
+		capture(recordingDirectory + name + formatExtension(recordingFormat), recordingFormat);
+	}
+}
+
+void FrameCapture::finish()
+{
+	// Wait for the reads in flight (the only place the render thread blocks on the capture)
+	for (CaptureSlot& slot : slots) {
+		if (slot.fence != nullptr)
+			glClientWaitSync(slot.fence, GL_SYNC_FLUSH_COMMANDS_BIT, GL_TIMEOUT_IGNORED);
+	}
+	collect();
+	writer->wait();
+}
+
+void FrameCapture::report(std::ostream& stream) const
+{
+	stream << "Frame capture: " << capturedFrames << " captured, " << writtenFrames << " written, " << droppedFrames << " dropped";
+	if (failedFrames > 0)
+		stream << ", " << failedFrames << " failed";
+	stream << std::endl;
+}
+
+void FrameCapture::react(GLFWwindow* /*window*/, int key, int /*scancode*/, int action, int /*mods*/)
+{
+	if (action != GLFW_PRESS)
+		return;
+
+	// Take screenshot
+	if (key == GLFW_KEY_F12)
+		requestScreenshot();
+
+	// Start/stop recording the image sequence
+	if (key == GLFW_KEY_F9) {
+		if (recording)
+			stopRecording();
+		else
+			startRecording("Recordings/", recordingFormat);
+	}
+}
+
+void FrameCapture::buildGUI()
+{
+	// Create the capture window (collapsed, it is needed only while recording)
+	ImGui::SetNextWindowCollapsed(true, ImGuiCond_FirstUseEver);
+	ImGui::Begin("Capture");
+
+	// Screenshot button
+	if (ImGui::Button("Screenshot (F12)"))
+		requestScreenshot();
+
+	// Recording button
+	if (ImGui::Button(recording ? "Stop recording (F9)" : "Record (F9)")) {
+		if (recording)
+			stopRecording();
+		else
+			startRecording("Recordings/", recordingFormat);
+	}
+
+	// Format of the recorded frames
+	int format = static_cast<int>(recordingFormat);
+	ImGui::Combo("Format", &format, "PNG\0Raw (PPM)\0");
+	recordingFormat = static_cast<CaptureFormat>(format);
+
+	// Statistics
+	if (recording)
+		ImGui::Text("Recording frame %llu", static_cast<unsigned long long>(recordedFrames));
+	ImGui::Text("Captured %llu, written %llu, dropped %llu", static_cast<unsigned long long>(capturedFrames),
+		static_cast<unsigned long long>(writtenFrames), static_cast<unsigned long long>(droppedFrames));
+
+	// Finish the window
+	ImGui::End();
+}
+
+bool FrameCapture::writePNG(const std::string& path, const unsigned char* pixels, int width, int height)
+{
+	FILE* file = fopen(path.c_str(), "wb");
+	if (file == nullptr)
+		return false;
+
+	// Signature and header (8 bit RGB, no interlacing)
+	const unsigned char signature[8] = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n' };
+	bool isWritten = fwrite(signature, 1, sizeof(signature), file) == sizeof(signature);
+	std::vector<unsigned char> header;
+	appendUint32(header, static_cast<uint32_t>(width));
+	appendUint32(header, static_cast<uint32_t>(height));
+	header.push_back(8);
+	header.push_back(2);
+	header.push_back(0);
+	header.push_back(0);
+	header.push_back(0);
+	isWritten = isWritten && writeChunk(file, "IHDR", header);
+
+	// Scanlines (top-down, every row starts with its filter type) stored in the uncompressed deflate blocks
+	size_t rowBytes = static_cast<size_t>(width) * 3;
+	size_t rawBytes = (rowBytes + 1) * static_cast<size_t>(height);
+	std::vector<unsigned char> data;
+	data.reserve(rawBytes + rawBytes / 65535 * 5 + 11);
+	data.push_back(0x78);
+	data.push_back(0x01);
+	uint32_t adlerA = 1, adlerB = 0;
+	size_t blockLeft = 0;
+	for (size_t byte = 0; byte < rawBytes; ++byte) {
+		// Start the next block
+		if (blockLeft == 0) {
+			blockLeft = rawBytes - byte < 65535 ? rawBytes - byte : 65535;
+			data.push_back(byte + blockLeft == rawBytes ? 1 : 0);
+			data.push_back(static_cast<unsigned char>(blockLeft & 0xFF));
+			data.push_back(static_cast<unsigned char>(blockLeft >> 8));
+			data.push_back(static_cast<unsigned char>(~blockLeft & 0xFF));
+			data.push_back(static_cast<unsigned char>((~blockLeft >> 8) & 0xFF));
+		}
+		size_t row = byte / (rowBytes + 1);
+		size_t column = byte % (rowBytes + 1);
+		unsigned char value = column == 0 ? 0 : pixels[(static_cast<size_t>(height) - 1 - row) * rowBytes + column - 1];
+		data.push_back(value);
+		adlerA = (adlerA + value) % 65521;
+		adlerB = (adlerB + adlerA) % 65521;
+		--blockLeft;
+	}
+	appendUint32(data, (adlerB << 16) | adlerA);
+	isWritten = isWritten && writeChunk(file, "IDAT", data);
+	isWritten = isWritten && writeChunk(file, "IEND", std::vector<unsigned char>());
+
+	fclose(file);
+	return isWritten;
+}
+
+bool FrameCapture::writeRaw(const std::string& path, const unsigned char* pixels, int width, int height)
+{
+	FILE* file = fopen(path.c_str(), "wb");
+	if (file == nullptr)
+		return false;
+
+	// Header and the rows (top-down)
+	bool isWritten = fprintf(file, "P6\n%d %d\n255\n", width, height) > 0;
+	size_t rowBytes = static_cast<size_t>(width) * 3;
+	for (int row = height - 1; isWritten && row >= 0; --row)
+		isWritten = fwrite(pixels + static_cast<size_t>(row) * rowBytes, 1, rowBytes, file) == rowBytes;
+
+	fclose(file);
+	return isWritten;
+}
+
+void FrameCapture::allocateRing(int _width, int _height)
+{
+	deleteRing();
+	width = _width;
+	height = _height;
+	slotBytes = static_cast<size_t>(width) * static_cast<size_t>(height) * 3;
+
+	// Allocate all the slots in one persistently mapped buffer (frames are encoded straight from it)
+	glGenBuffers(1, &readbackBuffer);
+	glBindBuffer(GL_PIXEL_PACK_BUFFER, readbackBuffer);
+	GLbitfield flags = GL_MAP_READ_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+	glBufferStorage(GL_PIXEL_PACK_BUFFER, FRAME_CAPTURE_SLOTS * slotBytes, NULL, flags);
+	readbackData = static_cast<unsigned char*>(glMapBufferRange(GL_PIXEL_PACK_BUFFER, 0, FRAME_CAPTURE_SLOTS * slotBytes, flags));
+	glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+	if (readbackData == nullptr) {
+		std::cout << "ERROR::FRAME_CAPTURE::allocateRing() Readback buffer could not be mapped!" << std::endl;
+	}
+}
+
+void FrameCapture::deleteRing()
+{
+	if (readbackBuffer == 0)
+		return;
+	for (CaptureSlot& slot : slots) {
+		if (slot.fence != nullptr) {
+			glDeleteSync(slot.fence);
+			slot.fence = nullptr;
+		}
+	}
+	glBindBuffer(GL_PIXEL_PACK_BUFFER, readbackBuffer);
+	glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+	glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+	glDeleteBuffers(1, &readbackBuffer);
+	readbackBuffer = 0;
+	readbackData = nullptr;
+}
+
+void FrameCapture::collect()
+{
+	for (CaptureSlot& slot : slots) {
+		// Read is still in flight (it is checked again the next frame)
+		if (slot.fence == nullptr)
+			continue;
+		GLenum status = glClientWaitSync(slot.fence, 0, 0);
+		if (status != GL_ALREADY_SIGNALED && status != GL_CONDITION_SATISFIED)
+			continue;
+		glDeleteSync(slot.fence);
+		slot.fence = nullptr;
+
+		// Encode the frame on the writer thread
+		slot.isWriting = true;
+		CaptureSlot* writtenSlot = &slot;
+		const unsigned char* pixels = readbackData + (&slot - slots) * slotBytes;
+		int frameWidth = width, frameHeight = height;
+		writer->enqueue([this, writtenSlot, pixels, frameWidth, frameHeight]() {
+			bool isWritten = writtenSlot->format == CaptureFormat::png ? writePNG(writtenSlot->path, pixels, frameWidth, frameHeight) : writeRaw(writtenSlot->path, pixels, frameWidth, frameHeight);
+			if (isWritten) {
+				++writtenFrames;
+			}
+			else {
+				std::cout << "ERROR::FRAME_CAPTURE::collect() Unable to write " << writtenSlot->path << "!" << std::endl;
+				++failedFrames;
+			}
+			writtenSlot->isWriting = false;
+		});
+	}
+}
+
+bool FrameCapture::capture(const std::string& path, CaptureFormat format)
+{
+	// Reallocate the ring once the window is resized (frames of the old size are written first)
+	int frameWidth = static_cast<int>(window->getWidth());
+	int frameHeight = static_cast<int>(window->getHeight());
+	if (frameWidth <= 0 || frameHeight <= 0)
+		return false;
+	if (frameWidth != width || frameHeight != height) {
+		finish();
+		allocateRing(frameWidth, frameHeight);
+	}
+
+	// Drop the frame when all the slots are busy (render thread never waits for the GPU or the writer)
+	CaptureSlot& slot = slots[nextSlot];
+	if (readbackData == nullptr || slot.fence != nullptr || slot.isWriting) {
+		++droppedFrames;
+		return false;
+	}
+	slot.path = path;
+	slot.format = format;
+
+	// Copy the frame into the slot (the copy runs on the GPU, it is fenced and collected a few frames later)
+	glBindFramebuffer(GL_READ_FRAMEBUFFER, 0);
+	glBindBuffer(GL_PIXEL_PACK_BUFFER, readbackBuffer);
+	glPixelStorei(GL_PACK_ALIGNMENT, 1);
+	glReadPixels(0, 0, width, height, GL_RGB, GL_UNSIGNED_BYTE, (void*)(nextSlot * slotBytes));
+	glPixelStorei(GL_PACK_ALIGNMENT, 4);
+	glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+	slot.fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+	nextSlot = (nextSlot + 1) % FRAME_CAPTURE_SLOTS;
+	++capturedFrames;
+	return true;
+}
+
+bool FrameCapture::createDirectory(const std::string& directory)
+{
+	// Create every directory of the path (existing ones are fine)
+	for (size_t separator = directory.find_first_of("/\\", 1); separator != std::string::npos; separator = directory.find_first_of("/\\", separator + 1)) {
+		std::string parent = directory.substr(0, separator);
+#ifdef _WIN32
+		_mkdir(parent.c_str());
+#else
+		mkdir(parent.c_str(), 0755);
+#endif
+	}
+	std::string path = directory;
+	while (!path.empty() && (path.back() == '/' || path.back() == '\\'))
+		path.pop_back();
+#ifdef _WIN32
+	struct _stat info;
+	return _stat(path.c_str(), &info) == 0 && (info.st_mode & _S_IFDIR) != 0;
+#else
+	struct stat info;
+	return stat(path.c_str(), &info) == 0 && S_ISDIR(info.st_mode);
+#endif
+}
+
+const char* FrameCapture::formatExtension(CaptureFormat format)
+{
+	return format == CaptureFormat::png ? ".png" : ".ppm";
+}
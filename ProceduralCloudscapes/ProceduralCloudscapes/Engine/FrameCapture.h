@@ -0,0 +1,106 @@
+#ifndef FRAME_CAPTURE_H
+#define FRAME_CAPTURE_H
+
+// include glad to get all the required OpenGL headers
+#include <glad/glad.h>
+#include <GLFW/glfw3.h>
+
+#include <string>
+#include <atomic>
+#include <cstdint>
+#include <ostream>
+
+#include "Window.h"
+#include "GUI/GUIBuilder.h"
+
+// number of frames that can be read back or written at the same time (slots of the readback ring)
+#define FRAME_CAPTURE_SLOTS 3
+
+class ThreadPool;
+
+// file formats of the captured frames
+enum class CaptureFormat {
+	png = 0,
+	// binary PPM (RGB without compression, the fastest to write)
+	raw = 1
+};
+
+// Asynchronous capture of the window framebuffer (screenshots and image sequences)
+// Frames are read into the ring of persistently mapped pixel pack buffers and their slots are fenced. Once the GPU has
+// finished the copy (it is polled, never waited on), the writer thread encodes the frame straight from the mapped slot
+// and frees it again. Frames are dropped instead of stalling the render thread when all the slots are busy.
+class FrameCapture : public GUIBuilder, public KeyReactor {
+public:
+	FrameCapture(Window* _window);
+	~FrameCapture();
+
+	// captures the next frame into the working directory
+	void requestScreenshot();
+	// captures every frame into the directory (numbered from 0)
+	void startRecording(const std::string& directory, CaptureFormat format = CaptureFormat::png);
+	void stopRecording();
+	// reads the frame (called once the scene is drawn, before the GUI) and hands the finished reads to the writer
+	void update();
+	// waits until all the captured frames are written
+	void finish();
+
+	// captured, written and dropped frames (also printed by the benchmark)
+	void report(std::ostream& stream) const;
+	void react(GLFWwindow* window, int key, int scancode, int action, int mods) override;
+	void buildGUI() override;
+
+	inline bool isRecording() const { return recording; }
+	inline uint64_t getCapturedFrames() const { return capturedFrames; }
+	inline uint64_t getDroppedFrames() const { return droppedFrames; }
+	inline uint64_t getWrittenFrames() const { return writtenFrames; }
+
+	// writes the tightly packed RGB image (rows are stored bottom-up, the same way as they are read from GL)
+	static bool writePNG(const std::string& path, const unsigned char* pixels, int width, int height);
+	static bool writeRaw(const std::string& path, const unsigned char* pixels, int width, int height);
+
+private:
+	struct CaptureSlot {
+		GLsync fence = nullptr;
+		// slot is read by the writer thread
+		std::atomic<bool> isWriting{ false };
+		std::string path;
+		CaptureFormat format = CaptureFormat::png;
+	};
+
+	void allocateRing(int _width, int _height);
+	void deleteRing();
+	// hands the slots whose reads have finished to the writer
+	void collect();
+	// false if the frame is dropped
+	bool capture(const std::string& path, CaptureFormat format);
+
+	static bool createDirectory(const std::string& directory);
+	static const char* formatExtension(CaptureFormat format);
+
+	Window* window;
+	ThreadPool* writer;
+
+	// readback ring (all the slots are in one persistently mapped buffer)
+	unsigned int readbackBuffer = 0;
+	unsigned char* readbackData = nullptr;
+	size_t slotBytes = 0;
+	int width = 0;
+	int height = 0;
+	CaptureSlot slots[FRAME_CAPTURE_SLOTS];
+	size_t nextSlot = 0;
+
+	// capture requests
+	bool isScreenshotRequested = false;
+	bool recording = false;
+	std::string recordingDirectory;
+	CaptureFormat recordingFormat = CaptureFormat::png;
+	uint64_t recordedFrames = 0;
+
+	// statistics
+	uint64_t capturedFrames = 0;
+	uint64_t droppedFrames = 0;
+	std::atomic<uint64_t> writtenFrames{ 0 };
+	std::atomic<uint64_t> failedFrames{ 0 };
+};
+
+#endif // !FRAME_CAPTURE_H
@@ -0,0 +1,43 @@
+#include "GPUTimer.h"
+
+GPUTimer::GPUTimer()
+{
+	glGenQueries(GPU_TIMER_FRAMES * 2, &queries[0][0]);
+}
+
+GPUTimer::~GPUTimer()
+{
+	glDeleteQueries(GPU_TIMER_FRAMES * 2, &queries[0][0]);
+}
+
+void GPUTimer::begin()
+{
+	slot = (slot + 1) % GPU_TIMER_FRAMES;
+	collect(slot);
+	glQueryCounter(queries[slot][0], GL_TIMESTAMP);
+}
+
+void GPUTimer::end()
+{
+	glQueryCounter(queries[slot][1], GL_TIMESTAMP);
+	isIssued[slot] = true;
+}
+
+void GPUTimer::collect(size_t _slot)
+{
+	if (!isIssued[_slot])
+		return;
+	isIssued[_slot] = false;
+
+	// measurement is skipped if the GPU is still behind (waiting for it would stall the frame)
+	GLint isAvailable = GL_FALSE;
+	glGetQueryObjectiv(queries[_slot][1], GL_QUERY_RESULT_AVAILABLE, &isAvailable);
+	if (isAvailable == GL_FALSE)
+		return;
+
+	GLuint64 beginTime = 0, endTime = 0;
+	glGetQueryObjectui64v(queries[_slot][0], GL_QUERY_RESULT, &beginTime);
+	glGetQueryObjectui64v(queries[_slot][1], GL_QUERY_RESULT, &endTime);
+	milliseconds = static_cast<float>(static_cast<double>(endTime - beginTime) / 1000000.0);
+	++results;
+}
@@ -0,0 +1,38 @@
+#ifndef GPU_TIMER_H
+#define GPU_TIMER_H
+
+// include glad to get all the required OpenGL headers
+#include <glad/glad.h>
+
+#include <cstddef>
+#include <cstdint>
+
+// number of frames the queries are kept in flight (results are read that many frames later, so reading never stalls)
+#define GPU_TIMER_FRAMES 4
+
+// Measures the GPU time of the commands issued between begin and end
+// Timestamps are used instead of the elapsed time queries, so the timers can be nested (e.g. a pass inside the frame).
+class GPUTimer {
+public:
+	GPUTimer();
+	~GPUTimer();
+
+	void begin();
+	void end();
+
+	// GPU time of the latest finished measurement
+	inline float getMilliseconds() const { return milliseconds; }
+	inline bool hasResult() const { return results > 0; }
+private:
+	// reads the measurement which is about to be overwritten
+	void collect(size_t _slot);
+
+	unsigned int queries[GPU_TIMER_FRAMES][2];
+	bool isIssued[GPU_TIMER_FRAMES] = {};
+	size_t slot = 0;
+
+	float milliseconds = 0.f;
+	uint64_t results = 0;
+};
+
+#endif // !GPU_TIMER_H
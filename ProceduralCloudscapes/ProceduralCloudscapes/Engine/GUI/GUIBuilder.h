@@ -3,6 +3,7 @@
 
 class GUIBuilder {
 public:
+	virtual ~GUIBuilder() = default;
 	virtual void buildGUI() = 0;
 	virtual void buildHiddenGUI() {};
 };
@@ -1,38 +1,208 @@
 #include "PBRMaterial.h"
+#include "TextureLoader.h"
+#include "CompressedTexture.h"
+
+#include <iostream>
+#include <atomic>
+#include <memory>
+#include <stb_image.h>
+
+// images of the material (albedo, normal, ao, roughness, metallic) and their number of channels
+static const char* IMAGE_NAMES[5] = { "albedo.png", "normal.png", "ao.png", "roughness.png", "metallic.png" };
+static const int IMAGE_CHANNELS[5] = { 3, 3, 1, 1, 1 };
+
+// Loads the image with the forced number of channels (all the layers have to be of the same size)
+static unsigned char* loadLayerImage(const std::string& path, int channels, glm::ivec2& size)
+{
+    int width, height, nrComponents;
+    unsigned char* data = stbi_load(path.c_str(), &width, &height, &nrComponents, channels);
+    if (!data) {
+        std::cout << "Texture failed to load at path: " << path << std::endl;
+        return nullptr;
+    }
+
+    // first loaded image determines the size of the layers
+    if (size == glm::ivec2(0)) {
+        size = glm::ivec2(width, height);
+    }
+    else if (size != glm::ivec2(width, height)) {
+        std::cout << "ERROR::PBR_MATERIAL Texture at path: " << path << " has different size than the other layers!" << std::endl;
+        stbi_image_free(data);
+        return nullptr;
+    }
+    return data;
+}
+
+// Packs the images of the one layer (missing images are replaced with neutral values: white albedo, flat normal,
+// no occlusion, full roughness and no metalness)
+static void packLayer(unsigned char* const images[5], size_t texels, unsigned char* albedo, unsigned char* normal, unsigned char* orm)
+{
+    if (images[0])
+        std::copy(images[0], images[0] + texels * 3, albedo);
+    else
+        std::fill(albedo, albedo + texels * 3, static_cast<unsigned char>(255));
+
+    for (size_t texel = 0; texel < texels; ++texel) {
+        // normal
+        normal[texel * 3 + 0] = images[1] ? images[1][texel * 3 + 0] : 128;
+        normal[texel * 3 + 1] = images[1] ? images[1][texel * 3 + 1] : 128;
+        normal[texel * 3 + 2] = images[1] ? images[1][texel * 3 + 2] : 255;
+        // occlusion, roughness and metallic
+        orm[texel * 3 + 0] = images[2] ? images[2][texel] : 255;
+        orm[texel * 3 + 1] = images[3] ? images[3][texel] : 255;
+        orm[texel * 3 + 2] = images[4] ? images[4][texel] : 0;
+    }
+}
+
+// Images of the one layer decoded by the worker threads (the last decoded image packs the layer)
+struct LayerImages {
+    std::string path;
+    unsigned char* images[5] = {};
+    glm::ivec2 sizes[5] = {};
+    std::atomic<int> remaining{ 5 };
+};
 
 PBRMaterial::PBRMaterial(const char* texturesPath)
 {
-    // generate paths for the textures
-    std::string baseTexturePath(texturesPath);
-    // albedo
-    std::string albedoPath(baseTexturePath);
-    albedoPath.append("albedo.png");
-    // normal
-    std::string normalPath(baseTexturePath);
-    normalPath.append("normal.png");
-    // metallic
-    std::string metallicPath(baseTexturePath);
-    metallicPath.append("metallic.png");
-    // roughness
-    std::string roughnessPath(baseTexturePath);
-    roughnessPath.append("roughness.png");
-    // ao
-    std::string aoPath(baseTexturePath);
-    aoPath.append("ao.png");
-
-    // load and create textures
-    albedoTex = new Texture(albedoPath.c_str());
-    normalTex = new Texture(normalPath.c_str());
-    metallicTex = new Texture(metallicPath.c_str());
-    roughnessTex = new Texture(roughnessPath.c_str());
-    aoTex = new Texture(aoPath.c_str());
+    loadMaterials({ std::string(texturesPath) });
+}
+
+PBRMaterial::PBRMaterial(const std::vector<std::string>& texturesPaths)
+{
+    loadMaterials(texturesPaths);
+}
+
+PBRMaterial::PBRMaterial(const std::vector<std::string>& texturesPaths, TextureLoader* loader)
+{
+    loadMaterials(texturesPaths, loader);
 }
 
 PBRMaterial::~PBRMaterial()
 {
-	delete albedoTex;
-	delete normalTex;
-	delete metallicTex;
-	delete roughnessTex;
-	delete aoTex;
+    delete albedoTex;
+    delete normalTex;
+    delete ormTex;
+}
+
+void PBRMaterial::loadMaterials(const std::vector<std::string>& texturesPaths)
+{
+    if (loadCompressedMaterials(texturesPaths))
+        return;
+    layers = texturesPaths.size();
+
+    // load images of all the materials
+    std::vector<unsigned char*> images(layers * 5, nullptr);
+    glm::ivec2 size(0);
+    for (size_t layer = 0; layer < layers; ++layer) {
+        for (size_t i = 0; i < 5; ++i) {
+            std::string path(texturesPaths[layer]);
+            path.append(IMAGE_NAMES[i]);
+            images[layer * 5 + i] = loadLayerImage(path, IMAGE_CHANNELS[i], size);
+        }
+    }
+    if (size == glm::ivec2(0))
+        size = glm::ivec2(1);
+
+    // pack the layers
+    size_t texels = static_cast<size_t>(size.x) * static_cast<size_t>(size.y);
+    std::vector<unsigned char> albedoData(texels * 3 * layers);
+    std::vector<unsigned char> normalData(texels * 3 * layers);
+    std::vector<unsigned char> ormData(texels * 3 * layers);
+    for (size_t layer = 0; layer < layers; ++layer) {
+        packLayer(&images[layer * 5], texels, &albedoData[texels * 3 * layer], &normalData[texels * 3 * layer], &ormData[texels * 3 * layer]);
+    }
+
+    // free images data
+    for (unsigned char* image : images) {
+        if (image)
+            stbi_image_free(image);
+    }
+
+    // create texture arrays
+    glm::vec3 arraySize(size.x, size.y, layers);
+    albedoTex = new Texture(arraySize, &albedoData[0], 3);
+    normalTex = new Texture(arraySize, &normalData[0], 3);
+    ormTex = new Texture(arraySize, &ormData[0], 3);
+}
+
+void PBRMaterial::loadMaterials(const std::vector<std::string>& texturesPaths, TextureLoader* loader)
+{
+    if (loadCompressedMaterials(texturesPaths))
+        return;
+    layers = texturesPaths.size();
+
+    // create texture arrays (they are resident once all the layers are uploaded)
+    albedoTex = loader->create(TextureType::twoDimensionalArray, layers);
+    normalTex = loader->create(TextureType::twoDimensionalArray, layers);
+    ormTex = loader->create(TextureType::twoDimensionalArray, layers);
+    uint64_t albedoTicket = albedoTex->getLoadTicket();
+    uint64_t normalTicket = normalTex->getLoadTicket();
+    uint64_t ormTicket = ormTex->getLoadTicket();
+
+    // decode every image on its own worker thread
+    for (size_t layer = 0; layer < layers; ++layer) {
+        std::shared_ptr<LayerImages> layerImages = std::make_shared<LayerImages>();
+        layerImages->path = texturesPaths[layer];
+        for (size_t i = 0; i < 5; ++i) {
+            loader->enqueue([loader, layerImages, layer, i, albedoTicket, normalTicket, ormTicket]() {
+                std::string path(layerImages->path);
+                path.append(IMAGE_NAMES[i]);
+                layerImages->images[i] = loadLayerImage(path, IMAGE_CHANNELS[i], layerImages->sizes[i]);
+                if (--layerImages->remaining > 0)
+                    return;
+
+                // all the images of the layer have to be of the same size
+                glm::ivec2 size(0);
+                for (size_t j = 0; j < 5; ++j) {
+                    if (!layerImages->images[j])
+                        continue;
+                    if (size == glm::ivec2(0)) {
+                        size = layerImages->sizes[j];
+                    }
+                    else if (size != layerImages->sizes[j]) {
+                        std::cout << "ERROR::PBR_MATERIAL Texture at path: " << layerImages->path << IMAGE_NAMES[j] << " has different size than the other images of the layer!" << std::endl;
+                        stbi_image_free(layerImages->images[j]);
+                        layerImages->images[j] = nullptr;
+                    }
+                }
+                if (size == glm::ivec2(0))
+                    size = glm::ivec2(1);
+
+                // pack the layer and queue it for the upload
+                size_t texels = static_cast<size_t>(size.x) * static_cast<size_t>(size.y);
+                std::vector<unsigned char> albedoData(texels * 3);
+                std::vector<unsigned char> normalData(texels * 3);
+                std::vector<unsigned char> ormData(texels * 3);
+                packLayer(layerImages->images, texels, &albedoData[0], &normalData[0], &ormData[0]);
+                for (unsigned char* image : layerImages->images) {
+                    if (image)
+                        stbi_image_free(image);
+                }
+                int layerIndex = static_cast<int>(layer);
+                loader->queueUpload(albedoTicket, layerIndex, size, 3, std::move(albedoData));
+                loader->queueUpload(normalTicket, layerIndex, size, 3, std::move(normalData));
+                loader->queueUpload(ormTicket, layerIndex, size, 3, std::move(ormData));
+            });
+        }
+    }
+}
+
+bool PBRMaterial::loadCompressedMaterials(const std::vector<std::string>& texturesPaths)
+{
+    // all the layers have to be compressed (otherwise the images are loaded)
+    std::vector<std::string> albedoPaths, normalPaths, ormPaths;
+    for (const std::string& texturesPath : texturesPaths) {
+        albedoPaths.push_back(texturesPath + "albedo" + COMPRESSED_TEXTURE_EXTENSION);
+        normalPaths.push_back(texturesPath + "normal" + COMPRESSED_TEXTURE_EXTENSION);
+        ormPaths.push_back(texturesPath + "orm" + COMPRESSED_TEXTURE_EXTENSION);
+        if (!CompressedTexture::exists(albedoPaths.back()) || !CompressedTexture::exists(normalPaths.back()) || !CompressedTexture::exists(ormPaths.back()))
+            return false;
+    }
+
+    // create texture arrays (mip chains are uploaded from the mapped containers)
+    layers = texturesPaths.size();
+    albedoTex = new Texture(albedoPaths);
+    normalTex = new Texture(normalPaths);
+    ormTex = new Texture(ormPaths);
+    return true;
 }
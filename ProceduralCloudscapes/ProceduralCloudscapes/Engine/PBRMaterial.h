@@ -3,23 +3,39 @@
 
 #include "Texture.h"
 
+#include <vector>
+
+class TextureLoader;
+
+// Set of PBR materials stored as texture arrays (one layer per material)
+// Metallic, roughness and AO are packed into one ORM texture: occlusion (r), roughness (g), metallic (b)
+// Precompressed containers written by TextureCompressor are preferred over the images (nothing has to be decoded)
 class PBRMaterial {
 public:
 	PBRMaterial(const char* texturesPath);
+	PBRMaterial(const std::vector<std::string>& texturesPaths);
+	// images are decoded by the loader's worker threads (material can be used once it is resident)
+	PBRMaterial(const std::vector<std::string>& texturesPaths, TextureLoader* loader);
 	~PBRMaterial();
 
+	inline bool isResident() const { return albedoTex->isResident() && normalTex->isResident() && ormTex->isResident(); }
+
 	inline Texture* getAlbedo() const { return albedoTex; }
 	inline Texture* getNormal() const { return normalTex; }
-	inline Texture* getMetallic() const { return metallicTex; }
-	inline Texture* getRoughness() const { return roughnessTex; }
-	inline Texture* getAO() const { return aoTex; }
+	inline Texture* getORM() const { return ormTex; }
+	inline size_t getLayers() const { return layers; }
+	inline size_t getMemorySize() const { return albedoTex->getMemorySize() + normalTex->getMemorySize() + ormTex->getMemorySize(); }
 
 private:
+	void loadMaterials(const std::vector<std::string>& texturesPaths);
+	void loadMaterials(const std::vector<std::string>& texturesPaths, TextureLoader* loader);
+	// maps the precompressed containers (albedo, normal and ORM) if all the materials have them
+	bool loadCompressedMaterials(const std::vector<std::string>& texturesPaths);
+
 	Texture* albedoTex = nullptr;
 	Texture* normalTex = nullptr;
-	Texture* metallicTex = nullptr;
-	Texture* roughnessTex = nullptr;
-	Texture* aoTex = nullptr;
+	Texture* ormTex = nullptr;
+	size_t layers = 0;
 };
 
-#endif // !PBR_MATERIAL_H
+#endif // !PBR_MATERIAL_H
\ No newline at end of file
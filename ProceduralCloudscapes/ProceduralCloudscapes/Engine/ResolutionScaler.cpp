@@ -0,0 +1,188 @@
+#include "ResolutionScaler.h"
+
+#include "Window.h"
+#include "GPUTimer.h"
+
+#include <imgui.h>
+#include <cmath>
+#include <iomanip>
+#include <sstream>
+
+ResolutionScaler::ResolutionScaler(Window* _window) : window(_window)
+{
+	frameTimer = new GPUTimer();
+}
+
+ResolutionScaler::~ResolutionScaler()
+{
+	delete frameTimer;
+}
+
+void ResolutionScaler::beginFrame()
+{
+	frameTimer->begin();
+}
+
+void ResolutionScaler::endFrame()
+{
+	frameTimer->end();
+}
+
+void ResolutionScaler::reportPass(float milliseconds)
+{
+	measuredPassTime += milliseconds;
+}
+
+void ResolutionScaler::update()
+{
+	++frame;
+	// Passes of the last frame reported the measurements from the same frame as the frame timer
+	passTime = measuredPassTime;
+	measuredPassTime = 0.f;
+	if (!frameTimer->hasResult())
+		return;
+	frameTime = frameTimer->getMilliseconds();
+
+	// Collect statistics
+	++measuredFrames;
+	if (frameTime > targetFrameTime)
+		++framesOverBudget;
+	scaleSum += scale;
+	frameTimeSum += frameTime;
+	passTimeSum += passTime;
+	lowestScale = glm::min(lowestScale, scale);
+
+	if (!enabled)
+		return;
+
+	// Count the frames out of the hysteresis band (single spikes do not change the scale)
+	if (frameTime > targetFrameTime * (1.f + hysteresis)) {
+		++framesOver;
+		framesUnder = 0;
+	}
+	else if (frameTime < targetFrameTime * (1.f - hysteresis)) {
+		++framesUnder;
+		framesOver = 0;
+	}
+	else {
+		framesOver = 0;
+		framesUnder = 0;
+	}
+
+	// Measurements of the previous scale are still in flight for a few frames after the change
+	if (frame - lastChange <= GPU_TIMER_FRAMES)
+		return;
+	// Nothing is scaled in this scene
+	if (passTime <= 0.f)
+		return;
+	if (framesOver < settleFrames && framesUnder < settleFrames)
+		return;
+
+	// Scaled passes get what is left of the budget after the rest of the frame
+	float fixedTime = glm::max(frameTime - passTime, 0.f);
+	float desiredScale = minScale;
+	if (targetFrameTime > fixedTime)
+		desiredScale = scale * std::sqrt((targetFrameTime - fixedTime) / passTime);
+	// raise the scale carefully (lowering has to be quick, the frames are over the budget)
+	desiredScale = glm::min(desiredScale, scale + 2.f * RESOLUTION_SCALE_STEP);
+	desiredScale = std::round(desiredScale / RESOLUTION_SCALE_STEP) * RESOLUTION_SCALE_STEP;
+	if (framesOver >= settleFrames)
+		desiredScale = glm::min(desiredScale, scale - RESOLUTION_SCALE_STEP);
+	else
+		desiredScale = glm::max(desiredScale, scale);
+	desiredScale = glm::clamp(desiredScale, minScale, maxScale);
+
+	if (std::abs(desiredScale - scale) >= 0.5f * RESOLUTION_SCALE_STEP)
+		applyScale(desiredScale);
+	framesOver = 0;
+	framesUnder = 0;
+}
+
+void ResolutionScaler::report(std::ostream& stream) const
+{
+	glm::ivec2 renderSize = window->getRenderSize();
+	stream << std::fixed << std::setprecision(2);
+	stream << "Render scale: " << scale << " (" << renderSize.x << "x" << renderSize.y << ", " << getStateName() << ")" << std::endl;
+	stream << "GPU frame: " << frameTime << " ms (target " << targetFrameTime << " ms), scaled passes: " << passTime << " ms" << std::endl;
+	if (measuredFrames == 0)
+		return;
+	double frames = static_cast<double>(measuredFrames);
+	stream << "Average over " << measuredFrames << " frames: scale " << scaleSum / frames << " (lowest " << lowestScale << "), GPU frame ";
+	stream << frameTimeSum / frames << " ms, scaled passes " << passTimeSum / frames << " ms" << std::endl;
+	stream << "Frames over budget: " << 100.0 * static_cast<double>(framesOverBudget) / frames << "%, scale changes: " << changes << std::endl;
+}
+
+void ResolutionScaler::buildGUI()
+{
+	// Create the resolution scaling window (collapsed, it is needed only while profiling)
+	ImGui::SetNextWindowCollapsed(true, ImGuiCond_FirstUseEver);
+	ImGui::Begin("Resolution scaling");
+
+	// Enable switch
+	bool isControllerEnabled = isEnabled();
+	ImGui::Checkbox("Enabled", &isControllerEnabled);
+	setEnabled(isControllerEnabled);
+
+	// Target frame time
+	float target = getTargetFrameTime();
+	ImGui::SliderFloat("Target frame time (ms)", &target, 4.f, 50.f);
+	setTargetFrameTime(target);
+
+	// Scale bounds
+	float lowest = getMinScale();
+	float highest = getMaxScale();
+	ImGui::SliderFloat("Min scale", &lowest, 0.25f, 1.f);
+	ImGui::SliderFloat("Max scale", &highest, 0.25f, 1.f);
+	setScaleBounds(lowest, highest);
+
+	// Hysteresis
+	float band = getHysteresis();
+	ImGui::SliderFloat("Hysteresis", &band, 0.f, 0.5f);
+	setHysteresis(band);
+
+	// Controller state
+	std::ostringstream stream;
+	report(stream);
+	ImGui::TextUnformatted(stream.str().c_str());
+
+	// Finish the window
+	ImGui::End();
+}
+
+void ResolutionScaler::setEnabled(bool _enabled)
+{
+	if (enabled == _enabled)
+		return;
+	enabled = _enabled;
+	// passes are rendered in the full resolution without the controller
+	if (!enabled)
+		applyScale(maxScale);
+}
+
+void ResolutionScaler::setScaleBounds(float _minScale, float _maxScale)
+{
+	minScale = glm::clamp(_minScale, RESOLUTION_SCALE_STEP, 1.f);
+	maxScale = glm::clamp(_maxScale, minScale, 1.f);
+	float boundedScale = glm::clamp(scale, minScale, maxScale);
+	if (boundedScale != scale)
+		applyScale(boundedScale);
+}
+
+void ResolutionScaler::applyScale(float _scale)
+{
+	scale = _scale;
+	window->setRenderScale(scale);
+	lastChange = frame;
+	++changes;
+}
+
+const char* ResolutionScaler::getStateName() const
+{
+	if (!enabled)
+		return "disabled";
+	if (framesOver > 0)
+		return "over budget";
+	if (framesUnder > 0 && scale < maxScale)
+		return "under budget";
+	return "holding";
+}
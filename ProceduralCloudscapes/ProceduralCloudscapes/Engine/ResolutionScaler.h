@@ -0,0 +1,85 @@
+#ifndef RESOLUTION_SCALER_H
+#define RESOLUTION_SCALER_H
+
+#include <cstdint>
+#include <ostream>
+
+#include "GUI/GUIBuilder.h"
+
+// render scale is changed in steps (render targets are reallocated on every change)
+#define RESOLUTION_SCALE_STEP 0.05f
+
+class Window;
+class GPUTimer;
+
+// Dynamic resolution scaling of the expensive fullscreen passes (clouds)
+// Frame GPU time is measured around the scene and the scaled passes report their own GPU time. Once the frame stays
+// out of the hysteresis band around the target time for a while, the render scale is set so the scaled passes fit
+// into what is left of the budget (their cost follows the number of pixels, i.e. the square of the scale).
+class ResolutionScaler : public GUIBuilder {
+public:
+	ResolutionScaler(Window* _window);
+	~ResolutionScaler();
+
+	// measures the frame (brackets the scene drawing)
+	void beginFrame();
+	void endFrame();
+	// GPU time of the scaled pass measured during the current frame
+	void reportPass(float milliseconds);
+	// adjusts the render scale (called once per frame, before the render targets are resized)
+	void update();
+
+	// controller state and statistics since the start (also printed by the benchmark)
+	void report(std::ostream& stream) const;
+	void buildGUI() override;
+
+	inline float getScale() const { return scale; }
+	inline bool isEnabled() const { return enabled; }
+	inline float getTargetFrameTime() const { return targetFrameTime; }
+	inline float getMinScale() const { return minScale; }
+	inline float getMaxScale() const { return maxScale; }
+	inline float getHysteresis() const { return hysteresis; }
+
+	void setEnabled(bool _enabled);
+	inline void setTargetFrameTime(float _targetFrameTime) { targetFrameTime = _targetFrameTime; }
+	void setScaleBounds(float _minScale, float _maxScale);
+	inline void setHysteresis(float _hysteresis) { hysteresis = _hysteresis; }
+
+private:
+	void applyScale(float _scale);
+	const char* getStateName() const;
+
+	Window* window;
+	GPUTimer* frameTimer;
+
+	// settings
+	bool enabled = true;
+	float targetFrameTime = 16.6f;
+	float minScale = 0.5f;
+	float maxScale = 1.f;
+	// relative half-width of the band around the target time where the scale is kept
+	float hysteresis = 0.1f;
+	// consecutive frames out of the band before the scale is changed
+	int settleFrames = 15;
+
+	// state
+	float scale = 1.f;
+	float frameTime = 0.f;
+	float passTime = 0.f;
+	float measuredPassTime = 0.f;
+	int framesOver = 0;
+	int framesUnder = 0;
+	uint64_t frame = 0;
+	uint64_t lastChange = 0;
+
+	// statistics
+	uint64_t measuredFrames = 0;
+	uint64_t framesOverBudget = 0;
+	uint64_t changes = 0;
+	double scaleSum = 0.0;
+	double frameTimeSum = 0.0;
+	double passTimeSum = 0.0;
+	float lowestScale = 1.f;
+};
+
+#endif // !RESOLUTION_SCALER_H
@@ -0,0 +1,193 @@
+#include "ResourceManager.h"
+
+#include "Texture.h"
+#include "TextureLoader.h"
+#include "PBRMaterial.h"
+
+#include <imgui.h>
+#include <algorithm>
+#include <iomanip>
+#include <sstream>
+
+ResourceManager::ResourceManager(TextureLoader* _loader) : loader(_loader)
+{
+}
+
+ResourceManager::~ResourceManager()
+{
+	// Resources still in use are gone as well (their users have to be deleted before the manager)
+	for (auto& resource : resources) {
+		if (resource.second.references > 0) {
+			std::cout << "ERROR::RESOURCE_MANAGER Resource " << resource.first << " is still used by " << resource.second.references << " objects!" << std::endl;
+		}
+		destroy(resource.second);
+	}
+}
+
+Texture* ResourceManager::acquireTexture(const std::string& path)
+{
+	return static_cast<Texture*>(acquire("texture:" + path, ResourceType::texture, [this, &path]() {
+		return static_cast<void*>(loader->load(path));
+	}));
+}
+
+Texture* ResourceManager::acquireTexture(const std::string& key, std::function<Texture*()> create)
+{
+	return static_cast<Texture*>(acquire("texture:" + key, ResourceType::texture, [&create]() {
+		return static_cast<void*>(create());
+	}));
+}
+
+Shader* ResourceManager::acquireShader(const ShaderStages& stages)
+{
+	// Key is made out of all the stages (same files can be linked with the different stages)
+	std::string key("shader:");
+	for (const auto& stage : stages) {
+		key.append(stage.first);
+		key.append(ShaderInfo(stage.second).name);
+		key.push_back(';');
+	}
+
+	return static_cast<Shader*>(acquire(key, ResourceType::shader, [&stages]() {
+		Shader* shader = new Shader();
+		for (const auto& stage : stages) {
+			shader->attachShader(stage.first.c_str(), ShaderInfo(stage.second));
+		}
+		shader->linkProgram();
+		return static_cast<void*>(shader);
+	}));
+}
+
+PBRMaterial* ResourceManager::acquireMaterial(const std::vector<std::string>& texturesPaths)
+{
+	std::string key("material:");
+	for (const std::string& path : texturesPaths) {
+		key.append(path);
+		key.push_back(';');
+	}
+
+	return static_cast<PBRMaterial*>(acquire(key, ResourceType::material, [this, &texturesPaths]() {
+		return static_cast<void*>(new PBRMaterial(texturesPaths, loader));
+	}));
+}
+
+void ResourceManager::release(const void* resource)
+{
+	auto key = keys.find(resource);
+	if (key == keys.end()) {
+		std::cout << "ERROR::RESOURCE_MANAGER::release() Resource was not acquired from the manager!" << std::endl;
+		return;
+	}
+	Resource& entry = resources.at(key->second);
+	if (entry.references == 0) {
+		std::cout << "ERROR::RESOURCE_MANAGER::release() Resource " << key->second << " is released more times than it was acquired!" << std::endl;
+		return;
+	}
+	--entry.references;
+}
+
+void ResourceManager::purgeUnused()
+{
+	for (auto resource = resources.begin(); resource != resources.end();) {
+		if (resource->second.references == 0) {
+			keys.erase(resource->second.object);
+			destroy(resource->second);
+			resource = resources.erase(resource);
+		}
+		else {
+			++resource;
+		}
+	}
+}
+
+void ResourceManager::report(std::ostream& stream) const
+{
+	// Sort the resources by their keys (same types are next to each other)
+	std::vector<std::string> sortedKeys;
+	for (const auto& resource : resources)
+		sortedKeys.push_back(resource.first);
+	std::sort(sortedKeys.begin(), sortedKeys.end());
+
+	stream << "Resources: " << resources.size() << " objects, " << std::fixed << std::setprecision(2);
+	stream << static_cast<double>(getResidentBytes()) / (1024.0 * 1024.0) << " MB (" << hits << " hits, " << misses << " loads)" << std::endl;
+	for (const std::string& key : sortedKeys) {
+		const Resource& resource = resources.at(key);
+		stream << "  [" << resource.references << "] " << key << " " << static_cast<double>(calculateBytes(resource)) / (1024.0 * 1024.0) << " MB" << std::endl;
+	}
+}
+
+void ResourceManager::buildGUI()
+{
+	// Create the resources window (collapsed, it is needed only while profiling)
+	ImGui::SetNextWindowCollapsed(true, ImGuiCond_FirstUseEver);
+	ImGui::Begin("Resources");
+
+	// Purge button
+	if (ImGui::Button("Purge unused"))
+		purgeUnused();
+
+	// Resources with their references and memory
+	std::ostringstream stream;
+	report(stream);
+	ImGui::TextUnformatted(stream.str().c_str());
+
+	// Finish the window
+	ImGui::End();
+}
+
+size_t ResourceManager::getResidentBytes() const
+{
+	size_t bytes = 0;
+	for (const auto& resource : resources)
+		bytes += calculateBytes(resource.second);
+	return bytes;
+}
+
+void* ResourceManager::acquire(const std::string& key, ResourceType type, std::function<void*()> create)
+{
+	// Share the cached resource
+	auto resource = resources.find(key);
+	if (resource != resources.end()) {
+		++resource->second.references;
+		++hits;
+		return resource->second.object;
+	}
+
+	// Create the new one
+	void* object = create();
+	resources[key] = Resource{ type, object, 1 };
+	keys[object] = key;
+	++misses;
+	return object;
+}
+
+void ResourceManager::destroy(const Resource& resource)
+{
+	switch (resource.type)
+	{
+	case ResourceType::texture:
+		delete static_cast<Texture*>(resource.object);
+		break;
+	case ResourceType::shader:
+		delete static_cast<Shader*>(resource.object);
+		break;
+	case ResourceType::material:
+		delete static_cast<PBRMaterial*>(resource.object);
+		break;
+	default:
+		break;
+	}
+}
+
+size_t ResourceManager::calculateBytes(const Resource& resource)
+{
+	switch (resource.type)
+	{
+	case ResourceType::texture:
+		return static_cast<Texture*>(resource.object)->getMemorySize();
+	case ResourceType::material:
+		return static_cast<PBRMaterial*>(resource.object)->getMemorySize();
+	default:
+		return 0;
+	}
+}
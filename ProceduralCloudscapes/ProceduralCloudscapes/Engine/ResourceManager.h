@@ -0,0 +1,75 @@
+#ifndef RESOURCE_MANAGER_H
+#define RESOURCE_MANAGER_H
+
+#include <string>
+#include <vector>
+#include <functional>
+#include <unordered_map>
+#include <utility>
+#include <ostream>
+
+#include "Shader.h"
+#include "GUI/GUIBuilder.h"
+
+class Texture;
+class TextureLoader;
+class PBRMaterial;
+
+// stages of the shader program (path and type of every attached shader)
+typedef std::vector<std::pair<std::string, ShaderType>> ShaderStages;
+
+// Reference counted cache of the GPU resources (textures, shaders and PBR materials)
+// Resources are keyed by their path and parameters, so the repeated requests share the same object. Resources that
+// are no longer used stay cached (the next scene that needs them does not load them again) until they are purged.
+// NOTE: Shared resources must not be modified nor deleted by the objects that acquired them, they are released instead
+class ResourceManager : public GUIBuilder {
+public:
+	ResourceManager(TextureLoader* _loader);
+	~ResourceManager();
+
+	// texture at the path (streamed in by the texture loader)
+	Texture* acquireTexture(const std::string& path);
+	// texture created by the function (generated textures, key has to contain all the parameters of the generation)
+	Texture* acquireTexture(const std::string& key, std::function<Texture*()> create);
+	// linked shader program of the stages
+	Shader* acquireShader(const ShaderStages& stages);
+	// PBR material of the texture directories (streamed in by the texture loader)
+	PBRMaterial* acquireMaterial(const std::vector<std::string>& texturesPaths);
+	// drops the reference of the acquired resource (it stays cached until it is purged)
+	void release(const void* resource);
+	// deletes the cached resources nobody uses
+	void purgeUnused();
+
+	// report of the cached resources (references and GPU memory of every resource)
+	void report(std::ostream& stream) const;
+	void buildGUI() override;
+
+	inline size_t getResidentObjects() const { return resources.size(); }
+	size_t getResidentBytes() const;
+
+private:
+	enum class ResourceType {
+		texture = 0,
+		shader = 1,
+		material = 2
+	};
+	struct Resource {
+		ResourceType type;
+		void* object;
+		size_t references;
+	};
+
+	void* acquire(const std::string& key, ResourceType type, std::function<void*()> create);
+	static void destroy(const Resource& resource);
+	static size_t calculateBytes(const Resource& resource);
+
+	TextureLoader* loader;
+
+	// resources (key -> resource) and the keys of the objects
+	std::unordered_map<std::string, Resource> resources;
+	std::unordered_map<const void*, std::string> keys;
+	size_t hits = 0;
+	size_t misses = 0;
+};
+
+#endif // !RESOURCE_MANAGER_H
@@ -0,0 +1,37 @@
+#include "Sampler.h"
+
+#include <algorithm>
+
+Sampler::Sampler(GLenum minFilter, GLenum magFilter, GLenum wrap, float anisotropy)
+{
+	glGenSamplers(1, &ID);
+
+	// set sampler properties
+	glSamplerParameteri(ID, GL_TEXTURE_MIN_FILTER, minFilter);
+	glSamplerParameteri(ID, GL_TEXTURE_MAG_FILTER, magFilter);
+	glSamplerParameteri(ID, GL_TEXTURE_WRAP_S, wrap);
+	glSamplerParameteri(ID, GL_TEXTURE_WRAP_T, wrap);
+	glSamplerParameteri(ID, GL_TEXTURE_WRAP_R, wrap);
+
+	// set anisotropic filtering
+	if (anisotropy > 1.f) {
+		float maxAnisotropy = 1.f;
+		glGetFloatv(GL_MAX_TEXTURE_MAX_ANISOTROPY, &maxAnisotropy);
+		glSamplerParameterf(ID, GL_TEXTURE_MAX_ANISOTROPY, std::min(anisotropy, maxAnisotropy));
+	}
+}
+
+Sampler::~Sampler()
+{
+	glDeleteSamplers(1, &ID);
+}
+
+void Sampler::bind(GLenum unit) const
+{
+	glBindSampler(unit, ID);
+}
+
+void Sampler::unbind(GLenum unit)
+{
+	glBindSampler(unit, 0);
+}
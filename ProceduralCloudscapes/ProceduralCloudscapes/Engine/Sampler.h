@@ -0,0 +1,34 @@
+#ifndef SAMPLER_H
+#define SAMPLER_H
+
+// include glad to get all the required OpenGL headers
+#include <glad/glad.h>
+
+// anisotropic filtering is core since GL 4.6 (older GLAD headers know it only as the extension)
+#ifndef GL_TEXTURE_MAX_ANISOTROPY
+#define GL_TEXTURE_MAX_ANISOTROPY 0x84FE
+#endif
+#ifndef GL_MAX_TEXTURE_MAX_ANISOTROPY
+#define GL_MAX_TEXTURE_MAX_ANISOTROPY 0x84FF
+#endif
+
+// Sampling state which is bound to the texture unit instead of the texture
+// The same texture can be sampled differently by its users and the state is not changed on every bind.
+class Sampler {
+public:
+	// sampler ID
+	unsigned int ID;
+
+	// anisotropy is clamped to the maximum supported by the GPU (1 disables it)
+	Sampler(GLenum minFilter, GLenum magFilter, GLenum wrap, float anisotropy = 1.f);
+	~Sampler();
+	// sampler object belongs to the one owner only
+	Sampler(const Sampler&) = delete;
+	Sampler& operator=(const Sampler&) = delete;
+
+	void bind(GLenum unit) const;
+	// texture unit samples with the parameters of the bound texture again
+	static void unbind(GLenum unit);
+};
+
+#endif // !SAMPLER_H
@@ -7,13 +7,31 @@
 #include "Window.h"
 #include "SceneObject.h"
 #include "FrameBufferObject.h"
+#include "ResolutionScaler.h"
 #include "Environment/Environment.h"
 
+enum class RenderOrder
+{
+	// environment first, then all the scene objects in the order they were added
+	EnvironmentFirst,
+	// opaque scene objects first, then the environment and background scene objects at the far plane
+	// (early depth test discards their pixels which are covered by the opaque ones before they are shaded)
+	OpaqueFirst
+};
+
 class Scene {
 public:
 	Scene(Window* _window, const char* _name, EnvironmentType environmentType) : window(_window), name(_name) {
 		// create the environment
 		environment = Environment::createEnvironment(environmentType, window);
+		// create the scene depth texture (copy of the depth buffer that background objects can sample)
+		depthBuffer = new FrameBufferObject();
+		depthBuffer->attachDepth((unsigned int)window->getWidth(), (unsigned int)window->getHeight(), DepthPolicy::texture);
+		depthBuffer->bind();
+		glClear(GL_DEPTH_BUFFER_BIT);
+		FrameBufferObject::unbind();
+		// resize the scene depth together with the window (depth of the default framebuffer is copied into it)
+		window->registerRenderTarget(depthBuffer);
 		// set the window title
 		window->setTitle(name);
 	};
@@ -25,25 +43,72 @@ public:
 		}
 		// delete the environment
 		delete environment;
+		// delete the scene depth
+		window->unregisterRenderTarget(depthBuffer);
+		delete depthBuffer;
 	}
 
 	void draw() {
+		// measure the GPU time of the scene (resolution scaler holds it at the target frame time)
+		window->getResolutionScaler()->beginFrame();
 		// clear the buffers
 		glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-		// render the environment (environment is rendered in main buffer and in seperate texture)
-		environment->draw();
-		// update the scene
-		update();
-		// draw every scene object
-		for (auto sceneObject : sceneObjects)
-		{
-			sceneObject->draw();
+		// prepare the environment data the scene objects use (it is drawn after the opaque ones)
+		environment->prepare();
+
+		if (renderOrder == RenderOrder::OpaqueFirst) {
+			// update the scene
+			update();
+			// draw opaque scene objects (they fill the depth buffer)
+			for (auto sceneObject : sceneObjects)
+			{
+				if (!sceneObject->isBackground())
+					sceneObject->draw();
+			}
+			// render the environment and draw background scene objects only where nothing opaque is
+			copyDepth();
+			beginBackground();
+			environment->draw();
+			for (auto sceneObject : sceneObjects)
+			{
+				if (sceneObject->isBackground())
+					sceneObject->draw();
+			}
+			endBackground();
+		}
+		else {
+			// render the environment (environment is rendered in main buffer and in seperate texture)
+			beginBackground();
+			environment->draw();
+			endBackground();
+			// update the scene
+			update();
+			// draw every scene object
+			for (auto sceneObject : sceneObjects)
+			{
+				if (sceneObject->isBackground()) {
+					copyDepth();
+					beginBackground();
+					sceneObject->draw();
+					endBackground();
+				}
+				else {
+					sceneObject->draw();
+				}
+			}
 		}
+
+		window->getResolutionScaler()->endFrame();
 	}
 
 	virtual void update() = 0;
 
+	inline RenderOrder getRenderOrder() const { return renderOrder; }
+	inline void setRenderOrder(RenderOrder _renderOrder) { renderOrder = _renderOrder; }
+
 	Texture* getEnvironmentTexture() const { return environment->getTexture(); }
+	// depth of the scene objects drawn before the background ones (1.0 where there are none)
+	unsigned int getDepthTextureID() const { return depthBuffer->getDepthTextureID(); }
 
 	template<class T, typename std::enable_if<!std::is_same<T, Environment>::value, int>::type = 0>
 	T* getEnvironment() {
@@ -71,6 +136,26 @@ protected:
 private:
 	Environment* environment;
 	std::vector<SceneObject*> sceneObjects;
+	RenderOrder renderOrder = RenderOrder::EnvironmentFirst;
+	FrameBufferObject* depthBuffer;
+
+	void copyDepth() const {
+		// copy the depth buffer of the default framebuffer into the scene depth texture
+		glBindTexture(GL_TEXTURE_2D, depthBuffer->getDepthTextureID());
+		glCopyTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, 0, 0, (GLsizei)window->getWidth(), (GLsizei)window->getHeight());
+		glBindTexture(GL_TEXTURE_2D, 0);
+	}
+
+	// background passes lie on the far plane, so they pass only where the depth buffer is still clear
+	// and they never write into it
+	static void beginBackground() {
+		glDepthFunc(GL_LEQUAL);
+		glDepthMask(GL_FALSE);
+	}
+	static void endBackground() {
+		glDepthFunc(GL_LESS);
+		glDepthMask(GL_TRUE);
+	}
 };
 
 #endif // !SCENE_H
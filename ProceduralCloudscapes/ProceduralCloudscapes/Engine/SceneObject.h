@@ -17,6 +17,9 @@ public:
 
 	virtual void update() = 0;
 
+	// background objects are fullscreen passes at the far plane (drawn behind everything opaque)
+	virtual bool isBackground() const { return false; }
+
 protected:
 	Window* window;
 	Scene* scene = nullptr;
@@ -19,6 +19,12 @@ ScreenShader::~ScreenShader()
     delete shader;
 }
 
+void ScreenShader::draw()
+{
+    glBindVertexArray(quadVAO);
+    glDrawArrays(GL_TRIANGLES, 0, 6);
+}
+
 void ScreenShader::draw(const Texture& texture)
 {
     glBindVertexArray(quadVAO);
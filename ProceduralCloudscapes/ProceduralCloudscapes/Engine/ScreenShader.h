@@ -10,6 +10,8 @@ public:
 	ScreenShader(const char* fragShaderPath, const char* vertShaderPath = "Shaders/Screen/shader.vert");
 	~ScreenShader();
 
+	// draws the quad without binding any texture (shader samples only the textures it has bound itself)
+	void draw();
 	void draw(const Texture& texture);
 	void draw(const unsigned int textureID);
 
@@ -1,6 +1,7 @@
 #include "Shader.h"
 
 #include "Texture.h"
+#include "Sampler.h"
 
 Shader::Shader()
 {
@@ -68,6 +69,11 @@ void Shader::setMat4(const std::string& name, glm::mat4 value) const
 	glUniformMatrix4fv(glGetUniformLocation(ID, name.c_str()), 1, GL_FALSE, glm::value_ptr(value));
 }
 
+void Shader::setVec4(const std::string& name, glm::vec4 value) const
+{
+	glUniform4fv(glGetUniformLocation(ID, name.c_str()), 1, glm::value_ptr(value));
+}
+
 void Shader::setVec3(const std::string& name, glm::vec3 value) const
 {
 	glUniform3fv(glGetUniformLocation(ID, name.c_str()), 1, glm::value_ptr(value));
@@ -78,11 +84,25 @@ void Shader::setVec2(const std::string& name, glm::vec2 value) const
 	glUniform2fv(glGetUniformLocation(ID, name.c_str()), 1, glm::value_ptr(value));
 }
 
+void Shader::setIVec4Array(const std::string& name, const glm::ivec4* values, size_t count) const
+{
+	glUniform4iv(glGetUniformLocation(ID, name.c_str()), static_cast<GLsizei>(count), glm::value_ptr(values[0]));
+}
+
 void Shader::setSampler(const std::string& name, const Texture& texture, GLenum unit)
 {
 	glActiveTexture(GL_TEXTURE0 + unit);
 	glBindTexture(texture.getGLType(), texture.ID);
-	glUniform1i(glGetUniformLocation(texture.ID, name.c_str()), unit);
+	Sampler::unbind(unit);
+	glUniform1i(glGetUniformLocation(ID, name.c_str()), unit);
+}
+
+void Shader::setSampler(const std::string& name, const Texture& texture, GLenum unit, const Sampler& sampler)
+{
+	glActiveTexture(GL_TEXTURE0 + unit);
+	glBindTexture(texture.getGLType(), texture.ID);
+	sampler.bind(unit);
+	glUniform1i(glGetUniformLocation(ID, name.c_str()), unit);
 }
 
 void Shader::checkCompileErrors(unsigned int shader, std::string type)
@@ -14,6 +14,7 @@
 #include <list>
 
 class Texture;
+class Sampler;
 
 enum class ShaderType {
 	kVertex = 0,
@@ -85,9 +86,14 @@ public:
 	void setInt(const std::string& name, int value) const;
 	void setFloat(const std::string& name, float value) const;
 	void setMat4(const std::string& name, glm::mat4 value) const;
+	void setVec4(const std::string& name, glm::vec4 value) const;
 	void setVec3(const std::string& name, glm::vec3 value) const;
 	void setVec2(const std::string& name, glm::vec2 value) const;
+	void setIVec4Array(const std::string& name, const glm::ivec4* values, size_t count) const;
+	// texture is sampled with its own parameters
 	void setSampler(const std::string& name, const Texture& texture, GLenum unit);
+	// texture is sampled with the parameters of the sampler object (it stays bound to the unit until it is unbound)
+	void setSampler(const std::string& name, const Texture& texture, GLenum unit, const Sampler& sampler);
 private:
 	// utility function for checking shader compilation/linking errros
 	void checkCompileErrors(unsigned int shader, std::string type);
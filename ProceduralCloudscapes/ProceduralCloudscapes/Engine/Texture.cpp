@@ -1,20 +1,33 @@
 #include "Texture.h"
+#include "TextureLoader.h"
+#include "CompressedTexture.h"
 
 #include <iostream>
 #include <stb_image.h>
 
-Texture::Texture(TextureType _type, glm::vec3 _size, uint8_t nrChannels, bool is8bit)
+Texture::Texture(TextureType _type, glm::vec3 _size, TextureFormat _format, int _levels)
 {
 	// initialize member variables
 	size = _size;
 	// create texture info
 	info = new TextureInfo(_type);
-	// create GL texture
-	ID = generateGlTexture(nrChannels, is8bit);
+
+	// generate texture and allocate its storage
+	glGenTextures(1, &ID);
+	if (_levels <= 0)
+		_levels = calculateLevels(static_cast<int>(size.x), static_cast<int>(size.y), _type == TextureType::threeDimensional ? static_cast<int>(size.z) : 1);
+	TextureFormatInfo formatInfo(_format);
+	allocateStorage(formatInfo.internalFormat, _levels, formatInfo.bytesPerTexel);
 }
 
 Texture::Texture(char const* path)
 {
+	// precompressed containers do not need to be decoded
+	if (CompressedTexture::isContainer(path)) {
+		loadCompressed({ std::string(path) }, TextureType::twoDimensional);
+		return;
+	}
+
 	int width, height, nrComponents;
 	unsigned char* data = stbi_load(path, &width, &height, &nrComponents, 0);
 	if (data)
@@ -27,25 +40,15 @@ Texture::Texture(char const* path)
 		// create texture info
 		info = new TextureInfo(TextureType::twoDimensional);
 
-		// determine the texture format
-		GLenum format{};
-		if (nrComponents == 1)
-			format = GL_RED;
-		else if (nrComponents == 3)
-			format = GL_RGB;
-		else if (nrComponents == 4)
-			format = GL_RGBA;
-
-		// bind texture and set its data
-		glBindTexture(GL_TEXTURE_2D, ID);
-		glTexImage2D(GL_TEXTURE_2D, 0, format, width, height, 0, format, GL_UNSIGNED_BYTE, data);
-		glGenerateMipmap(GL_TEXTURE_2D);
+		// allocate the whole mip chain in the format of the image
+		TextureFormatInfo formatInfo(channelsToFormat(nrComponents));
+		allocateStorage(formatInfo.internalFormat, calculateLevels(width, height), formatInfo.bytesPerTexel);
 
-		// set texture properties
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+		// set texture data (rows of the RGB images do not have to be 4-byte aligned) and generate its mipmaps
+		glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+		glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, width, height, formatInfo.pixelFormat, GL_UNSIGNED_BYTE, data);
+		glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+		glGenerateMipmap(GL_TEXTURE_2D);
 
 		// free texture data
 		stbi_image_free(data);
@@ -60,66 +63,177 @@ Texture::Texture(char const* path)
 	}
 }
 
-void Texture::bind(int binding)
+Texture::Texture(const std::vector<std::string>& layerPaths)
+{
+	loadCompressed(layerPaths, TextureType::twoDimensionalArray);
+}
+
+Texture::Texture(glm::vec3 _size, const unsigned char* layersData, uint8_t nrChannels)
 {
-	glBindImageTexture(binding, ID, 0, GL_FALSE, 0, GL_WRITE_ONLY, GL_RGBA32F);
+	// initialize member variables
+	size = _size;
+	// create texture info
+	info = new TextureInfo(TextureType::twoDimensionalArray);
+
+	// generate texture and allocate the whole mip chain
+	glGenTextures(1, &ID);
+	TextureFormatInfo formatInfo(channelsToFormat(nrChannels));
+	allocateStorage(formatInfo.internalFormat, calculateLevels(static_cast<int>(size.x), static_cast<int>(size.y)), formatInfo.bytesPerTexel);
+
+	// set layers data (rows of the RGB layers are not 4-byte aligned) and generate their mipmaps
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+	glTexSubImage3D(GL_TEXTURE_2D_ARRAY, 0, 0, 0, 0, static_cast<GLsizei>(size.x), static_cast<GLsizei>(size.y), static_cast<GLsizei>(size.z), formatInfo.pixelFormat, GL_UNSIGNED_BYTE, layersData);
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+	glGenerateMipmap(GL_TEXTURE_2D_ARRAY);
+}
+
+Texture::Texture(TextureType _type)
+{
+	// generate texture (its storage is allocated by the loader once the first layer is decoded)
+	glGenTextures(1, &ID);
+
+	// initialize member variables
+	size = glm::vec3(0.f);
+	resident = false;
+	// create texture info
+	info = new TextureInfo(_type);
+}
+
+void Texture::bind(int binding) const
+{
+	GLboolean isLayered = info->type == TextureType::threeDimensional || info->type == TextureType::twoDimensionalArray ? GL_TRUE : GL_FALSE;
+	glBindImageTexture(binding, ID, 0, isLayered, 0, GL_READ_WRITE, internalFormat);
 }
 
 Texture::~Texture()
 {
+	// drop the data that has not been uploaded yet
+	if (loader != nullptr)
+		loader->cancel(this);
 	delete info;
 	glDeleteTextures(1, &ID);
 }
 
-unsigned int Texture::generateGlTexture(uint8_t nrChannels, bool is8bit)
+TextureFormat Texture::channelsToFormat(int nrChannels)
 {
-	unsigned int texture;
-	glGenTextures(1, &texture);
-	glActiveTexture(GL_TEXTURE0);
-	glBindTexture(info->glType, texture);
-
-	glTexParameteri(info->glType, GL_TEXTURE_WRAP_S, GL_REPEAT);
-	glTexParameteri(info->glType, GL_TEXTURE_WRAP_T, GL_REPEAT);
-	glTexParameteri(info->glType, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-	glTexParameteri(info->glType, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-
-	GLenum format{GL_RGBA32F};
-	if (nrChannels == 1) {
-		format = GL_RED;
-	}
-	else if (nrChannels == 3) {
-		if (is8bit)
-			format = GL_RGB8;
-		else
-			format = GL_RGB32F;
-	}
-	else if (nrChannels == 4) {
-		if (is8bit)
-			format = GL_RGBA8;
-		else
-			format = GL_RGBA32F;
-	}
-	else {
+	switch (nrChannels)
+	{
+	case 1:
+		return TextureFormat::R8;
+	case 2:
+		return TextureFormat::RG8;
+	case 3:
+		return TextureFormat::RGB8;
+	case 4:
+		return TextureFormat::RGBA8;
+	default:
 		std::cout << "ERROR::TEXTURE nrChannels invalidly set!" << std::endl;
+		return TextureFormat::RGBA8;
+	}
+}
+
+int Texture::calculateLevels(int width, int height, int depth)
+{
+	int largest = glm::max(width, glm::max(height, depth));
+	int levels = 1;
+	while (largest > 1) {
+		largest >>= 1;
+		++levels;
 	}
+	return levels;
+}
 
+void Texture::allocateStorage(GLenum _internalFormat, int _levels, size_t bytesPerTexel)
+{
+	internalFormat = _internalFormat;
+	levels = _levels;
+	GLsizei width = glm::max(static_cast<GLsizei>(size.x), 1);
+	GLsizei height = glm::max(static_cast<GLsizei>(size.y), 1);
+	GLsizei depth = glm::max(static_cast<GLsizei>(size.z), 1);
+
+	// allocate all the levels at once (storage can not be resized nor reformatted afterwards)
+	glBindTexture(info->glType, ID);
 	switch (info->type)
 	{
 	case TextureType::oneDimensional:
-		glTexImage1D(GL_TEXTURE_1D, 0, format, static_cast<GLsizei>(size.x), 0, GL_RGBA, GL_FLOAT, NULL);
+		glTexStorage1D(GL_TEXTURE_1D, levels, internalFormat, width);
 		break;
 	case TextureType::twoDimensional:
-		glTexImage2D(GL_TEXTURE_2D, 0, format, static_cast<GLsizei>(size.x), static_cast<GLsizei>(size.y), 0, GL_RGBA, GL_FLOAT, NULL);
+		glTexStorage2D(GL_TEXTURE_2D, levels, internalFormat, width, height);
 		break;
 	case TextureType::threeDimensional:
-		glTexImage3D(GL_TEXTURE_3D, 0, format, static_cast<GLsizei>(size.x), static_cast<GLsizei>(size.y), static_cast<GLsizei>(size.z), 0, GL_RGBA, GL_FLOAT, NULL);
+	case TextureType::twoDimensionalArray:
+		glTexStorage3D(info->glType, levels, internalFormat, width, height, depth);
 		break;
 	default:
 		std::cout << "ERROR::TEXTURE TextureType is invalidly set!" << std::endl;
-		break;
+		return;
 	}
 
-	glBindImageTexture(0, texture, 0, GL_FALSE, 0, GL_WRITE_ONLY, format);
+	// set texture properties
+	glTexParameteri(info->glType, GL_TEXTURE_MAX_LEVEL, levels - 1);
+	glTexParameteri(info->glType, GL_TEXTURE_WRAP_S, GL_REPEAT);
+	glTexParameteri(info->glType, GL_TEXTURE_WRAP_T, GL_REPEAT);
+	glTexParameteri(info->glType, GL_TEXTURE_WRAP_R, GL_REPEAT);
+	glTexParameteri(info->glType, GL_TEXTURE_MIN_FILTER, levels > 1 ? GL_LINEAR_MIPMAP_LINEAR : GL_LINEAR);
+	glTexParameteri(info->glType, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
 
-	return texture;
+	// memory of all the levels (layers of the array textures are not reduced by the mip chain)
+	memorySize = 0;
+	for (int level = 0; level < levels; ++level) {
+		size_t levelWidth = static_cast<size_t>(glm::max(width >> level, 1));
+		size_t levelHeight = static_cast<size_t>(info->type == TextureType::oneDimensional ? 1 : glm::max(height >> level, 1));
+		size_t levelDepth = static_cast<size_t>(info->type == TextureType::threeDimensional ? glm::max(depth >> level, 1) : depth);
+		memorySize += levelWidth * levelHeight * levelDepth * bytesPerTexel;
+	}
+}
+
+void Texture::loadCompressed(const std::vector<std::string>& paths, TextureType type)
+{
+	// map the containers (all the layers have to match the first one)
+	std::vector<CompressedTexture> containers(paths.size());
+	bool isValid = !paths.empty();
+	for (size_t i = 0; i < paths.size() && isValid; ++i) {
+		isValid = containers[i].open(paths[i]);
+		if (!isValid) {
+			std::cout << "Texture failed to load at path: " << paths[i] << std::endl;
+		}
+		else if (containers[i].getGLFormat() != containers[0].getGLFormat() || containers[i].getWidth() != containers[0].getWidth() ||
+			containers[i].getHeight() != containers[0].getHeight() || containers[i].getLevels() != containers[0].getLevels()) {
+			std::cout << "ERROR::TEXTURE Container at path: " << paths[i] << " has different format or size than the other layers!" << std::endl;
+			isValid = false;
+		}
+	}
+	if (!isValid) {
+		ID = 0;
+		size = glm::vec3(0.f);
+		info = new TextureInfo(TextureType::faulty);
+		return;
+	}
+
+	// initialize member variables
+	const CompressedTexture& first = containers[0];
+	GLsizei layers = static_cast<GLsizei>(containers.size());
+	size = glm::vec3(first.getWidth(), first.getHeight(), type == TextureType::twoDimensionalArray ? layers : 0);
+	// create texture info
+	info = new TextureInfo(type);
+
+	// generate texture and allocate the mip chain of the containers
+	glGenTextures(1, &ID);
+	allocateStorage(first.getGLFormat(), first.getLevels(), 0);
+
+	// upload the mip chains straight from the mapped files
+	for (int level = 0; level < first.getLevels(); ++level) {
+		GLsizei width = first.getLevelWidth(level);
+		GLsizei height = first.getLevelHeight(level);
+		if (type == TextureType::twoDimensionalArray) {
+			for (GLsizei layer = 0; layer < layers; ++layer) {
+				glCompressedTexSubImage3D(GL_TEXTURE_2D_ARRAY, level, 0, 0, layer, width, height, 1, first.getGLFormat(), containers[layer].getLevelSize(level), containers[layer].getLevelData(level));
+			}
+		}
+		else {
+			glCompressedTexSubImage2D(GL_TEXTURE_2D, level, 0, 0, width, height, first.getGLFormat(), first.getLevelSize(level), first.getLevelData(level));
+		}
+		memorySize += static_cast<size_t>(first.getLevelSize(level)) * layers;
+	}
 }
@@ -5,13 +5,15 @@
 #include <glad/glad.h>
 
 #include <string>
+#include <vector>
 #include <glm/glm.hpp>
 
 enum class TextureType {
 	oneDimensional = 0,
 	twoDimensional = 1,
 	threeDimensional = 2,
-	faulty = 3
+	twoDimensionalArray = 3,
+	faulty = 4
 };
 
 struct TextureInfo {
@@ -30,6 +32,10 @@ struct TextureInfo {
 			name = "Tex_3D";
 			glType = GL_TEXTURE_3D;
 			break;
+		case TextureType::twoDimensionalArray:
+			name = "Tex_2D_Array";
+			glType = GL_TEXTURE_2D_ARRAY;
+			break;
 		case TextureType::faulty:
 			break;
 		default:
@@ -43,23 +49,122 @@ struct TextureInfo {
 	std::string name;
 };
 
+// sized internal formats of the textures (chosen per use, so no memory is spent on the channels that are never read)
+enum class TextureFormat {
+	R8 = 0,
+	RG8 = 1,
+	RGB8 = 2,
+	RGBA8 = 3,
+	R11G11B10F = 4,
+	RGBA16F = 5
+};
+
+struct TextureFormatInfo {
+	TextureFormatInfo(TextureFormat _format) : format(_format) {
+		switch (format)
+		{
+		case TextureFormat::R8:
+			internalFormat = GL_R8;
+			pixelFormat = GL_RED;
+			pixelType = GL_UNSIGNED_BYTE;
+			bytesPerTexel = 1;
+			break;
+		case TextureFormat::RG8:
+			internalFormat = GL_RG8;
+			pixelFormat = GL_RG;
+			pixelType = GL_UNSIGNED_BYTE;
+			bytesPerTexel = 2;
+			break;
+		case TextureFormat::RGB8:
+			internalFormat = GL_RGB8;
+			pixelFormat = GL_RGB;
+			pixelType = GL_UNSIGNED_BYTE;
+			bytesPerTexel = 3;
+			break;
+		case TextureFormat::R11G11B10F:
+			internalFormat = GL_R11F_G11F_B10F;
+			pixelFormat = GL_RGB;
+			pixelType = GL_FLOAT;
+			bytesPerTexel = 4;
+			break;
+		case TextureFormat::RGBA16F:
+			internalFormat = GL_RGBA16F;
+			pixelFormat = GL_RGBA;
+			pixelType = GL_FLOAT;
+			bytesPerTexel = 8;
+			break;
+		case TextureFormat::RGBA8:
+		default:
+			internalFormat = GL_RGBA8;
+			pixelFormat = GL_RGBA;
+			pixelType = GL_UNSIGNED_BYTE;
+			bytesPerTexel = 4;
+			break;
+		}
+	}
+	TextureFormat format;
+	// sized format of the storage
+	GLenum internalFormat;
+	// format and type of the data uploaded into the storage
+	GLenum pixelFormat;
+	GLenum pixelType;
+	size_t bytesPerTexel;
+};
+
+class TextureLoader;
+
 class Texture {
 public:
 	// texture ID
 	unsigned int ID;
 
-	Texture(TextureType _type, glm::vec3 _size, uint8_t nrChannels, bool is8bit);
+	// allocates the immutable storage of the format (0 levels allocate the whole mip chain), its data is written by the caller
+	Texture(TextureType _type, glm::vec3 _size, TextureFormat _format, int _levels = 1);
+	// loads the image or maps the precompressed container (its mip chain is uploaded as it is)
 	Texture(char const* path);
-	void bind(int binding);
+	// creates 2D array texture from the precompressed containers (one per layer, all of the same format and size)
+	Texture(const std::vector<std::string>& layerPaths);
+	// creates 8-bit 2D array texture with mipmaps from the tightly packed layers (size.z is the number of layers)
+	Texture(glm::vec3 _size, const unsigned char* layersData, uint8_t nrChannels);
+	// binds the base level to the image unit (all the layers of the 3D and array textures)
+	void bind(int binding) const;
 	~Texture();
 
 	unsigned int getGLType() const { return info->glType; }
 	TextureType getType() const { return info->type; }
+	glm::vec3 getSize() const { return size; }
+	// GPU memory of the texture with its mipmaps (estimated from the format, drivers may pad it)
+	size_t getMemorySize() const { return memorySize; }
+	// textures streamed in by the loader are not resident until all of their data is uploaded
+	bool isResident() const { return resident; }
+	uint64_t getLoadTicket() const { return loadTicket; }
+	GLenum getInternalFormat() const { return internalFormat; }
+	int getLevels() const { return levels; }
+
+	// format of the 8-bit image with the given number of channels
+	static TextureFormat channelsToFormat(int nrChannels);
+	// number of levels of the whole mip chain
+	static int calculateLevels(int width, int height, int depth = 1);
 private:
-	unsigned int generateGlTexture(uint8_t nrChannels, bool is8bit);
+	// creates the empty texture which data is uploaded by the loader
+	Texture(TextureType _type);
+
+	// allocates the immutable storage of the bound texture with the default sampling (sampler objects override it)
+	void allocateStorage(GLenum _internalFormat, int _levels, size_t bytesPerTexel);
+	void loadCompressed(const std::vector<std::string>& paths, TextureType type);
 
 	TextureInfo* info;
 	glm::vec3 size;
+	GLenum internalFormat = GL_NONE;
+	int levels = 0;
+	size_t memorySize = 0;
+
+	// loading state (loader is set only while the texture is being loaded)
+	bool resident = true;
+	TextureLoader* loader = nullptr;
+	uint64_t loadTicket = 0;
+
+	friend class TextureLoader;
 };
 
 #endif // !TEXTURE_H
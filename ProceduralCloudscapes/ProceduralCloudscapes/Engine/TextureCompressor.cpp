@@ -0,0 +1,418 @@
+#include "TextureCompressor.h"
+#include "ThreadPool.h"
+
+#include <iostream>
+#include <fstream>
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <climits>
+#include <stb_image.h>
+
+// Writes the bits of the compressed block (from the lowest bit of the first byte)
+struct BlockWriter {
+	unsigned char* block;
+	int bit;
+
+	void write(uint32_t value, int count) {
+		for (int i = 0; i < count; ++i, ++bit) {
+			if ((value >> i) & 1u)
+				block[bit >> 3] |= static_cast<unsigned char>(1u << (bit & 7));
+		}
+	}
+};
+
+// Squared distance of the two RGBA colors (only the first channels are used)
+static int distance(const int* a, const int* b, int channels)
+{
+	int result = 0;
+	for (int c = 0; c < channels; ++c)
+		result += (a[c] - b[c]) * (a[c] - b[c]);
+	return result;
+}
+
+// BC4: two 8-bit endpoints and 3-bit indices (of the channel with the given offset in the RGBA texels)
+static void encodeBC4(const unsigned char* texels, int channel, unsigned char* block)
+{
+	int low = 255, high = 0;
+	for (int i = 0; i < 16; ++i) {
+		low = std::min<int>(low, texels[i * 4 + channel]);
+		high = std::max<int>(high, texels[i * 4 + channel]);
+	}
+
+	// First endpoint is larger (8 interpolated values), step 0 is the first endpoint and step 7 is the second one
+	uint64_t indices = 0;
+	if (high > low) {
+		for (int i = 0; i < 16; ++i) {
+			int step = ((high - texels[i * 4 + channel]) * 7 + (high - low) / 2) / (high - low);
+			uint64_t index = step == 0 ? 0 : (step == 7 ? 1 : step + 1);
+			indices |= index << (3 * i);
+		}
+	}
+	block[0] = static_cast<unsigned char>(high);
+	block[1] = static_cast<unsigned char>(low);
+	for (int i = 0; i < 6; ++i)
+		block[2 + i] = static_cast<unsigned char>(indices >> (8 * i));
+}
+
+// BC1: two RGB565 endpoints and 2-bit indices (4 color mode only)
+static void encodeBC1(const unsigned char* texels, unsigned char* block)
+{
+	// Endpoints are the corners of the bounding box (inset a bit, so the extremes are matched by the interpolated values)
+	int low[3] = { 255, 255, 255 }, high[3] = { 0, 0, 0 };
+	for (int i = 0; i < 16; ++i) {
+		for (int c = 0; c < 3; ++c) {
+			low[c] = std::min<int>(low[c], texels[i * 4 + c]);
+			high[c] = std::max<int>(high[c], texels[i * 4 + c]);
+		}
+	}
+	for (int c = 0; c < 3; ++c) {
+		int inset = (high[c] - low[c]) / 16;
+		low[c] += inset;
+		high[c] -= inset;
+	}
+	auto pack = [](const int* color) {
+		return static_cast<uint16_t>(((color[0] * 31 + 127) / 255) << 11 | ((color[1] * 63 + 127) / 255) << 5 | ((color[2] * 31 + 127) / 255));
+	};
+	auto unpack = [](uint16_t color, int* result) {
+		result[0] = ((color >> 11) & 31) * 255 / 31;
+		result[1] = ((color >> 5) & 63) * 255 / 63;
+		result[2] = (color & 31) * 255 / 31;
+	};
+	uint16_t color0 = pack(high);
+	uint16_t color1 = pack(low);
+	if (color0 < color1)
+		std::swap(color0, color1);
+
+	// Palette of the quantized endpoints
+	uint32_t indices = 0;
+	if (color0 != color1) {
+		int palette[4][4] = {};
+		unpack(color0, palette[0]);
+		unpack(color1, palette[1]);
+		for (int c = 0; c < 3; ++c) {
+			palette[2][c] = (2 * palette[0][c] + palette[1][c]) / 3;
+			palette[3][c] = (palette[0][c] + 2 * palette[1][c]) / 3;
+		}
+		for (int i = 0; i < 16; ++i) {
+			int texel[3] = { texels[i * 4 + 0], texels[i * 4 + 1], texels[i * 4 + 2] };
+			uint32_t best = 0;
+			for (uint32_t p = 1; p < 4; ++p) {
+				if (distance(texel, palette[p], 3) < distance(texel, palette[best], 3))
+					best = p;
+			}
+			indices |= best << (2 * i);
+		}
+	}
+	block[0] = static_cast<unsigned char>(color0);
+	block[1] = static_cast<unsigned char>(color0 >> 8);
+	block[2] = static_cast<unsigned char>(color1);
+	block[3] = static_cast<unsigned char>(color1 >> 8);
+	for (int i = 0; i < 4; ++i)
+		block[4 + i] = static_cast<unsigned char>(indices >> (8 * i));
+}
+
+// BC7 mode 6: one subset, two RGBA 7-bit endpoints with the unique P-bits and 4-bit indices
+static void encodeBC7(const unsigned char* texels, unsigned char* block)
+{
+	static const int weights[16] = { 0, 4, 9, 13, 17, 21, 26, 30, 34, 38, 43, 47, 51, 55, 60, 64 };
+
+	// Principal axis of the texels (few power iterations of the covariance)
+	glm::vec4 mean(0.f);
+	for (int i = 0; i < 16; ++i)
+		mean += glm::vec4(texels[i * 4 + 0], texels[i * 4 + 1], texels[i * 4 + 2], texels[i * 4 + 3]);
+	mean /= 16.f;
+	glm::mat4 covariance(0.f);
+	for (int i = 0; i < 16; ++i) {
+		glm::vec4 d = glm::vec4(texels[i * 4 + 0], texels[i * 4 + 1], texels[i * 4 + 2], texels[i * 4 + 3]) - mean;
+		covariance += glm::outerProduct(d, d);
+	}
+	glm::vec4 axis(1.f, 1.f, 1.f, 0.f);
+	for (int iteration = 0; iteration < 4; ++iteration) {
+		glm::vec4 next = covariance * axis;
+		float length = glm::length(next);
+		if (length < 1e-6f)
+			break;
+		axis = next / length;
+	}
+
+	// Endpoints are the extremes of the texels projected onto the axis
+	float tMin = 0.f, tMax = 0.f;
+	for (int i = 0; i < 16; ++i) {
+		float t = glm::dot(glm::vec4(texels[i * 4 + 0], texels[i * 4 + 1], texels[i * 4 + 2], texels[i * 4 + 3]) - mean, axis);
+		tMin = std::min(tMin, t);
+		tMax = std::max(tMax, t);
+	}
+	glm::vec4 endpoints[2] = { glm::clamp(mean + axis * tMin, 0.f, 255.f), glm::clamp(mean + axis * tMax, 0.f, 255.f) };
+
+	// Quantize the endpoints to 7 bits with the P-bit which fits them better
+	int quantized[2][4];
+	int pBits[2];
+	int values[2][4];
+	for (int e = 0; e < 2; ++e) {
+		int bestError = INT_MAX;
+		for (int p = 0; p < 2; ++p) {
+			int candidate[4], error = 0;
+			for (int c = 0; c < 4; ++c) {
+				candidate[c] = glm::clamp(static_cast<int>((endpoints[e][c] - static_cast<float>(p)) * 0.5f + 0.5f), 0, 127);
+				int value = candidate[c] * 2 + p;
+				error += (value - static_cast<int>(endpoints[e][c] + 0.5f)) * (value - static_cast<int>(endpoints[e][c] + 0.5f));
+			}
+			if (error < bestError) {
+				bestError = error;
+				pBits[e] = p;
+				for (int c = 0; c < 4; ++c) {
+					quantized[e][c] = candidate[c];
+					values[e][c] = candidate[c] * 2 + p;
+				}
+			}
+		}
+	}
+
+	// Palette and the nearest entry for every texel
+	int palette[16][4];
+	for (int i = 0; i < 16; ++i) {
+		for (int c = 0; c < 4; ++c)
+			palette[i][c] = ((64 - weights[i]) * values[0][c] + weights[i] * values[1][c] + 32) >> 6;
+	}
+	int indices[16];
+	for (int i = 0; i < 16; ++i) {
+		int texel[4] = { texels[i * 4 + 0], texels[i * 4 + 1], texels[i * 4 + 2], texels[i * 4 + 3] };
+		int best = 0, bestDistance = distance(texel, palette[0], 4);
+		for (int p = 1; p < 16; ++p) {
+			int d = distance(texel, palette[p], 4);
+			if (d < bestDistance) {
+				bestDistance = d;
+				best = p;
+			}
+		}
+		indices[i] = best;
+	}
+
+	// Highest bit of the first index is implicit zero (swap the endpoints if it is not)
+	if (indices[0] >= 8) {
+		for (int c = 0; c < 4; ++c)
+			std::swap(quantized[0][c], quantized[1][c]);
+		std::swap(pBits[0], pBits[1]);
+		for (int& index : indices)
+			index = 15 - index;
+	}
+
+	// Write the block
+	std::memset(block, 0, 16);
+	BlockWriter writer{ block, 0 };
+	writer.write(1u << 6, 7);
+	for (int c = 0; c < 4; ++c) {
+		writer.write(static_cast<uint32_t>(quantized[0][c]), 7);
+		writer.write(static_cast<uint32_t>(quantized[1][c]), 7);
+	}
+	writer.write(static_cast<uint32_t>(pBits[0]), 1);
+	writer.write(static_cast<uint32_t>(pBits[1]), 1);
+	writer.write(static_cast<uint32_t>(indices[0]), 3);
+	for (int i = 1; i < 16; ++i)
+		writer.write(static_cast<uint32_t>(indices[i]), 4);
+}
+
+TextureCompressor::TextureCompressor(size_t numberOfThreads)
+{
+	pool = new ThreadPool(numberOfThreads);
+}
+
+TextureCompressor::~TextureCompressor()
+{
+	delete pool;
+}
+
+bool TextureCompressor::compress(const std::string& imagePath, const std::string& containerPath, CompressedFormat format)
+{
+	int width, height, nrComponents;
+	unsigned char* data = stbi_load(imagePath.c_str(), &width, &height, &nrComponents, 4);
+	if (!data) {
+		std::cout << "Texture failed to load at path: " << imagePath << std::endl;
+		return false;
+	}
+	std::vector<unsigned char> rgba(data, data + static_cast<size_t>(width) * static_cast<size_t>(height) * 4);
+	stbi_image_free(data);
+	return compress(rgba, glm::ivec2(width, height), format, format == CompressedFormat::BC5, containerPath);
+}
+
+bool TextureCompressor::compressMaterial(const std::string& materialPath)
+{
+	auto start = std::chrono::high_resolution_clock::now();
+	bool isSuccessful = true;
+	size_t containers = 0;
+
+	// Images used by the PBR sphere (missing ones are skipped)
+	const char* names[5] = { "albedo", "normal", "ao", "roughness", "metallic" };
+	const CompressedFormat formats[5] = { CompressedFormat::BC7, CompressedFormat::BC5, CompressedFormat::BC4, CompressedFormat::BC4, CompressedFormat::BC4 };
+	unsigned char* ormImages[3] = {};
+	glm::ivec2 ormSize(0);
+	for (int i = 0; i < 5; ++i) {
+		std::string imagePath = materialPath + names[i] + ".png";
+		if (!CompressedTexture::exists(imagePath))
+			continue;
+		isSuccessful &= compress(imagePath, CompressedTexture::containerPath(imagePath), formats[i]);
+		++containers;
+
+		// Keep the maps packed into the ORM (all of them have to be of the same size)
+		if (i >= 2) {
+			int width, height, nrComponents;
+			ormImages[i - 2] = stbi_load(imagePath.c_str(), &width, &height, &nrComponents, 1);
+			if (ormImages[i - 2] && ormSize != glm::ivec2(0) && ormSize != glm::ivec2(width, height)) {
+				std::cout << "ERROR::TEXTURE_COMPRESSOR::compressMaterial() Texture at path: " << imagePath << " has different size than the other ORM maps!" << std::endl;
+				stbi_image_free(ormImages[i - 2]);
+				ormImages[i - 2] = nullptr;
+				isSuccessful = false;
+			}
+			else if (ormImages[i - 2]) {
+				ormSize = glm::ivec2(width, height);
+			}
+		}
+	}
+
+	// Packed occlusion (r), roughness (g) and metallic (b) of the terrain materials (same neutral values as PBRMaterial)
+	if (ormSize != glm::ivec2(0)) {
+		size_t texels = static_cast<size_t>(ormSize.x) * static_cast<size_t>(ormSize.y);
+		std::vector<unsigned char> orm(texels * 4);
+		for (size_t texel = 0; texel < texels; ++texel) {
+			orm[texel * 4 + 0] = ormImages[0] ? ormImages[0][texel] : 255;
+			orm[texel * 4 + 1] = ormImages[1] ? ormImages[1][texel] : 255;
+			orm[texel * 4 + 2] = ormImages[2] ? ormImages[2][texel] : 0;
+			orm[texel * 4 + 3] = 255;
+		}
+		isSuccessful &= compress(orm, ormSize, CompressedFormat::BC7, false, materialPath + "orm" + COMPRESSED_TEXTURE_EXTENSION);
+		++containers;
+	}
+	for (unsigned char* image : ormImages) {
+		if (image)
+			stbi_image_free(image);
+	}
+
+	auto end = std::chrono::high_resolution_clock::now();
+	std::cout << "Material compressed (" << containers << " containers, " << pool->getNumberOfThreads() << " threads) in ";
+	std::cout << std::chrono::duration<double>(end - start).count() << " s to " << materialPath << std::endl;
+	return isSuccessful && containers > 0;
+}
+
+bool TextureCompressor::compress(const std::vector<unsigned char>& rgba, glm::ivec2 size, CompressedFormat format, bool isNormalMap, const std::string& containerPath)
+{
+	// Compress every level of the mip chain (block rows are compressed in parallel)
+	size_t bytesPerBlock = CompressedTexture::blockBytes(format);
+	std::vector<std::vector<unsigned char>> levels;
+	std::vector<unsigned char> level(rgba);
+	std::vector<unsigned char> nextLevel;
+	glm::ivec2 levelSize = size;
+	while (true) {
+		int blocksX = (levelSize.x + 3) / 4;
+		int blocksY = (levelSize.y + 3) / 4;
+		levels.emplace_back(static_cast<size_t>(blocksX) * static_cast<size_t>(blocksY) * bytesPerBlock);
+		std::vector<unsigned char>& compressed = levels.back();
+		for (int by = 0; by < blocksY; ++by) {
+			pool->enqueue([&level, &compressed, levelSize, blocksX, by, format, bytesPerBlock]() {
+				unsigned char texels[64];
+				for (int bx = 0; bx < blocksX; ++bx) {
+					// Gather the block (texels outside of the level are clamped to its edge)
+					for (int y = 0; y < 4; ++y) {
+						for (int x = 0; x < 4; ++x) {
+							int sx = std::min(bx * 4 + x, levelSize.x - 1);
+							int sy = std::min(by * 4 + y, levelSize.y - 1);
+							std::memcpy(&texels[(x + y * 4) * 4], &level[(static_cast<size_t>(sx) + static_cast<size_t>(sy) * levelSize.x) * 4], 4);
+						}
+					}
+					encodeBlock(format, texels, &compressed[(static_cast<size_t>(bx) + static_cast<size_t>(by) * blocksX) * bytesPerBlock]);
+				}
+			});
+		}
+		pool->wait();
+
+		if (levelSize == glm::ivec2(1))
+			break;
+		generateLevel(level, levelSize, isNormalMap, nextLevel);
+		level.swap(nextLevel);
+		levelSize = glm::max(levelSize / 2, glm::ivec2(1));
+	}
+
+	std::ofstream file(containerPath, std::ios::binary);
+	if (!file.is_open()) {
+		std::cout << "ERROR::TEXTURE_COMPRESSOR::compress() Unable to open " << containerPath << "!" << std::endl;
+		return false;
+	}
+
+	// Header and the level index (levels are aligned to 16 bytes)
+	CompressedTextureHeader header = {};
+	std::memcpy(header.magic, CompressedTexture::magic(), sizeof(header.magic));
+	header.glFormat = CompressedTexture::formatToGL(format);
+	header.width = static_cast<uint32_t>(size.x);
+	header.height = static_cast<uint32_t>(size.y);
+	header.levels = static_cast<uint32_t>(levels.size());
+	std::vector<CompressedTextureLevel> index(levels.size());
+	uint64_t offset = sizeof(CompressedTextureHeader) + levels.size() * sizeof(CompressedTextureLevel);
+	for (size_t i = 0; i < levels.size(); ++i) {
+		offset = (offset + 15) & ~static_cast<uint64_t>(15);
+		index[i].offset = offset;
+		index[i].size = levels[i].size();
+		offset += levels[i].size();
+	}
+	file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+	file.write(reinterpret_cast<const char*>(index.data()), index.size() * sizeof(CompressedTextureLevel));
+
+	// Level data
+	const char padding[16] = {};
+	for (size_t i = 0; i < levels.size(); ++i) {
+		file.write(padding, static_cast<std::streamsize>(index[i].offset - static_cast<uint64_t>(file.tellp())));
+		file.write(reinterpret_cast<const char*>(levels[i].data()), levels[i].size());
+	}
+	return file.good();
+}
+
+void TextureCompressor::encodeBlock(CompressedFormat format, const unsigned char* texels, unsigned char* block)
+{
+	switch (format)
+	{
+	case CompressedFormat::BC1:
+		encodeBC1(texels, block);
+		break;
+	case CompressedFormat::BC4:
+		encodeBC4(texels, 0, block);
+		break;
+	case CompressedFormat::BC5:
+		encodeBC4(texels, 0, block);
+		encodeBC4(texels, 1, block + 8);
+		break;
+	default:
+		encodeBC7(texels, block);
+		break;
+	}
+}
+
+void TextureCompressor::generateLevel(const std::vector<unsigned char>& source, glm::ivec2 sourceSize, bool isNormalMap, std::vector<unsigned char>& level)
+{
+	// Box filter of the 2x2 texels (last row and column are repeated for the odd sizes)
+	glm::ivec2 size = glm::max(sourceSize / 2, glm::ivec2(1));
+	level.resize(static_cast<size_t>(size.x) * static_cast<size_t>(size.y) * 4);
+	for (int y = 0; y < size.y; ++y) {
+		for (int x = 0; x < size.x; ++x) {
+			glm::vec4 sum(0.f);
+			for (int j = 0; j < 2; ++j) {
+				for (int i = 0; i < 2; ++i) {
+					int sx = std::min(x * 2 + i, sourceSize.x - 1);
+					int sy = std::min(y * 2 + j, sourceSize.y - 1);
+					const unsigned char* texel = &source[(static_cast<size_t>(sx) + static_cast<size_t>(sy) * sourceSize.x) * 4];
+					sum += glm::vec4(texel[0], texel[1], texel[2], texel[3]);
+				}
+			}
+			glm::vec4 average = sum * 0.25f;
+
+			// Normals are kept of unit length
+			if (isNormalMap) {
+				glm::vec3 normal = glm::vec3(average) / 127.5f - 1.f;
+				normal = glm::length(normal) > 1e-6f ? glm::normalize(normal) : glm::vec3(0.f, 0.f, 1.f);
+				average = glm::vec4((normal + 1.f) * 127.5f, average.a);
+			}
+
+			unsigned char* texel = &level[(static_cast<size_t>(x) + static_cast<size_t>(y) * size.x) * 4];
+			for (int c = 0; c < 4; ++c)
+				texel[c] = static_cast<unsigned char>(glm::clamp(average[c] + 0.5f, 0.f, 255.f));
+		}
+	}
+}
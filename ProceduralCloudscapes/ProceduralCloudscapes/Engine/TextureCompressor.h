@@ -0,0 +1,40 @@
+#ifndef TEXTURE_COMPRESSOR_H
+#define TEXTURE_COMPRESSOR_H
+
+#include <glm/glm.hpp>
+
+#include <vector>
+#include <string>
+
+#include "CompressedTexture.h"
+
+class ThreadPool;
+
+// Offline (headless) converter of the images into the precompressed texture containers
+// Mip chains are generated with the box filter (normal maps are renormalized on every level) and every level is
+// block compressed on the worker threads. Encoders are simple range fits (BC7 uses mode 6 only), which is
+// enough for the terrain and the PBR textures and does not need any external library
+class TextureCompressor {
+public:
+	// 0 uses all the hardware threads except one
+	TextureCompressor(size_t numberOfThreads = 0);
+	~TextureCompressor();
+
+	// compresses the image into the container
+	bool compress(const std::string& imagePath, const std::string& containerPath, CompressedFormat format);
+	// compresses the images of the PBR material directory next to them: albedo (BC7), normal (BC5),
+	// ao, roughness and metallic (BC4) and the packed ORM the terrain materials use (BC7)
+	bool compressMaterial(const std::string& materialPath);
+	// compresses the tightly packed 8-bit RGBA image with its mip chain into the container
+	bool compress(const std::vector<unsigned char>& rgba, glm::ivec2 size, CompressedFormat format, bool isNormalMap, const std::string& containerPath);
+
+	// encodes the block of 4x4 RGBA texels (row by row) into the compressed block
+	static void encodeBlock(CompressedFormat format, const unsigned char* texels, unsigned char* block);
+
+private:
+	static void generateLevel(const std::vector<unsigned char>& source, glm::ivec2 sourceSize, bool isNormalMap, std::vector<unsigned char>& level);
+
+	ThreadPool* pool;
+};
+
+#endif // !TEXTURE_COMPRESSOR_H
@@ -0,0 +1,247 @@
+#include "TextureLoader.h"
+
+#include "ThreadPool.h"
+#include "CompressedTexture.h"
+
+#include <iostream>
+#include <cstring>
+#include <stb_image.h>
+
+TextureLoader::TextureLoader(size_t numberOfThreads)
+{
+	// Create staging ring and worker threads
+	allocateStagingRing();
+	workers = new ThreadPool(numberOfThreads);
+}
+
+TextureLoader::~TextureLoader()
+{
+	// Stop workers (before the queue they write into is gone)
+	delete workers;
+	for (QueuedLayer* layer : queuedLayers)
+		delete layer;
+	// Textures which are still loading stay empty
+	for (auto& pending : pendingTextures)
+		pending.second.texture->loader = nullptr;
+	// Delete staging ring
+	for (GLsync fence : stagingFences) {
+		if (fence != nullptr)
+			glDeleteSync(fence);
+	}
+	glBindBuffer(GL_PIXEL_UNPACK_BUFFER, stagingBuffer);
+	glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+	glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+	glDeleteBuffers(1, &stagingBuffer);
+}
+
+Texture* TextureLoader::create(TextureType type, size_t layers)
+{
+	if (type != TextureType::twoDimensional && type != TextureType::twoDimensionalArray) {
+		std::cout << "ERROR::TEXTURE_LOADER::create() Only 2D and 2D array textures can be loaded!" << std::endl;
+	}
+	if (type == TextureType::twoDimensional)
+		layers = 1;
+
+	// Texture is empty until its layers are uploaded
+	Texture* texture = new Texture(type);
+	texture->loader = this;
+	texture->loadTicket = nextTicket++;
+	pendingTextures[texture->loadTicket] = PendingTexture{ texture, layers, 0, false, 0 };
+	return texture;
+}
+
+Texture* TextureLoader::load(const std::string& path)
+{
+	// Precompressed container of the image is mapped and uploaded right away (there is nothing to decode)
+	std::string containerPath = CompressedTexture::containerPath(path);
+	if (CompressedTexture::exists(containerPath)) {
+		++loadedTextures;
+		return new Texture(containerPath.c_str());
+	}
+
+	Texture* texture = create(TextureType::twoDimensional);
+
+	// Decode the image on the worker thread (texture itself is never touched there, it can be deleted meanwhile)
+	uint64_t ticket = texture->loadTicket;
+	enqueue([this, path, ticket]() {
+		int width = 0, height = 0, nrComponents = 0;
+		std::vector<unsigned char> pixels;
+		unsigned char* data = stbi_load(path.c_str(), &width, &height, &nrComponents, 0);
+		if (data) {
+			pixels.assign(data, data + static_cast<size_t>(width) * static_cast<size_t>(height) * static_cast<size_t>(nrComponents));
+			stbi_image_free(data);
+		}
+		else {
+			std::cout << "Texture failed to load at path: " << path << std::endl;
+		}
+		queueUpload(ticket, 0, glm::ivec2(width, height), nrComponents, std::move(pixels));
+	});
+	return texture;
+}
+
+void TextureLoader::enqueue(std::function<void()> task)
+{
+	workers->enqueue(std::move(task));
+}
+
+void TextureLoader::queueUpload(uint64_t ticket, int layer, glm::ivec2 size, int channels, std::vector<unsigned char>&& data)
+{
+	QueuedLayer* queued = new QueuedLayer{ ticket, layer, size, channels, std::move(data) };
+	std::lock_guard<std::mutex> lock(queuedMutex);
+	queuedLayers.push_back(queued);
+}
+
+void TextureLoader::update()
+{
+	glBindBuffer(GL_PIXEL_UNPACK_BUFFER, stagingBuffer);
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+
+	while (true) {
+		// Upload only into the free slots (GPU has finished copying from them), the rest waits for the next frame
+		GLsync& fence = stagingFences[stagingSlot];
+		if (fence != nullptr) {
+			GLenum status = glClientWaitSync(fence, 0, 0);
+			if (status != GL_ALREADY_SIGNALED && status != GL_CONDITION_SATISFIED)
+				break;
+			glDeleteSync(fence);
+			fence = nullptr;
+		}
+
+		// Take the next decoded layer
+		QueuedLayer* layer = nullptr;
+		{
+			std::lock_guard<std::mutex> lock(queuedMutex);
+			if (queuedLayers.empty())
+				break;
+			layer = queuedLayers.front();
+			queuedLayers.pop_front();
+		}
+
+		// Drop the layers of the deleted textures
+		auto pending = pendingTextures.find(layer->ticket);
+		if (pending == pendingTextures.end()) {
+			delete layer;
+			continue;
+		}
+		uploadLayer(pending->second, *layer);
+		delete layer;
+
+		// Texture is resident once all of its layers are uploaded
+		PendingTexture& texture = pending->second;
+		if (++texture.uploadedLayers < texture.layers)
+			continue;
+		if (texture.isAllocated) {
+			glBindTexture(texture.texture->getGLType(), texture.texture->ID);
+			glGenerateMipmap(texture.texture->getGLType());
+			glBindTexture(texture.texture->getGLType(), 0);
+		}
+		texture.texture->resident = true;
+		texture.texture->loader = nullptr;
+		pendingTextures.erase(pending);
+		++loadedTextures;
+	}
+
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+	glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+}
+
+void TextureLoader::finish()
+{
+	while (!pendingTextures.empty()) {
+		// Wait for the decoding tasks and upload what they have queued
+		workers->wait();
+		glFlush();
+		update();
+
+		// Textures whose layers are never queued can not be finished
+		std::lock_guard<std::mutex> lock(queuedMutex);
+		if (!pendingTextures.empty() && queuedLayers.empty() && workers->getPendingTasks() == 0) {
+			std::cout << "ERROR::TEXTURE_LOADER::finish() Some textures are missing their layers!" << std::endl;
+			break;
+		}
+	}
+}
+
+void TextureLoader::cancel(Texture* texture)
+{
+	// Queued layers of the texture are dropped once they are taken from the queue
+	pendingTextures.erase(texture->loadTicket);
+}
+
+void TextureLoader::allocateStagingRing()
+{
+	// Allocate all the slots in one persistently mapped buffer (it stays mapped, so the layers are just copied into it)
+	glGenBuffers(1, &stagingBuffer);
+	glBindBuffer(GL_PIXEL_UNPACK_BUFFER, stagingBuffer);
+	GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+	glBufferStorage(GL_PIXEL_UNPACK_BUFFER, TEXTURE_LOADER_STAGING_SLOTS * TEXTURE_LOADER_SLOT_BYTES, NULL, flags);
+	stagingData = static_cast<unsigned char*>(glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, 0, TEXTURE_LOADER_STAGING_SLOTS * TEXTURE_LOADER_SLOT_BYTES, flags));
+	glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+	if (stagingData == nullptr) {
+		std::cout << "ERROR::TEXTURE_LOADER::allocateStagingRing() Staging buffer could not be mapped!" << std::endl;
+	}
+}
+
+void TextureLoader::uploadLayer(PendingTexture& pending, QueuedLayer& layer)
+{
+	// Image failed to load (texture stays empty, same as the synchronous load)
+	if (layer.data.empty())
+		return;
+
+	// First layer determines the size and the format of the texture
+	Texture* texture = pending.texture;
+	if (!pending.isAllocated) {
+		allocateTexture(pending, layer);
+	}
+	else if (glm::ivec2(texture->size) != layer.size || pending.channels != layer.channels) {
+		std::cout << "ERROR::TEXTURE_LOADER::uploadLayer() Layer " << layer.layer << " has different size or format than the other layers!" << std::endl;
+		return;
+	}
+	GLenum format = TextureFormatInfo(Texture::channelsToFormat(layer.channels)).pixelFormat;
+
+	// Copy the layer into the staging slot (layers which do not fit are uploaded directly from the client memory)
+	size_t bytes = layer.data.size();
+	bool isStaged = stagingData != nullptr && bytes <= TEXTURE_LOADER_SLOT_BYTES;
+	const void* pixels = &layer.data[0];
+	if (isStaged) {
+		size_t offset = stagingSlot * TEXTURE_LOADER_SLOT_BYTES;
+		std::memcpy(stagingData + offset, &layer.data[0], bytes);
+		pixels = (void*)offset;
+	}
+	else {
+		glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+	}
+
+	// Upload the layer
+	glBindTexture(texture->getGLType(), texture->ID);
+	if (texture->getType() == TextureType::twoDimensionalArray)
+		glTexSubImage3D(GL_TEXTURE_2D_ARRAY, 0, 0, 0, layer.layer, layer.size.x, layer.size.y, 1, format, GL_UNSIGNED_BYTE, pixels);
+	else
+		glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, layer.size.x, layer.size.y, format, GL_UNSIGNED_BYTE, pixels);
+	glBindTexture(texture->getGLType(), 0);
+	uploadedBytes += bytes;
+
+	// Slot is free again once the GPU has copied it
+	if (isStaged) {
+		stagingFences[stagingSlot] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+		stagingSlot = (stagingSlot + 1) % TEXTURE_LOADER_STAGING_SLOTS;
+	}
+	else {
+		glBindBuffer(GL_PIXEL_UNPACK_BUFFER, stagingBuffer);
+	}
+}
+
+void TextureLoader::allocateTexture(PendingTexture& pending, const QueuedLayer& layer)
+{
+	Texture* texture = pending.texture;
+	pending.isAllocated = true;
+	pending.channels = layer.channels;
+	TextureFormatInfo formatInfo(Texture::channelsToFormat(layer.channels));
+
+	// Allocate the whole mip chain (mipmaps are generated once all the layers are loaded)
+	if (texture->getType() == TextureType::twoDimensionalArray)
+		texture->size = glm::vec3(layer.size, static_cast<float>(pending.layers));
+	else
+		texture->size = glm::vec3(layer.size, 0.f);
+	texture->allocateStorage(formatInfo.internalFormat, Texture::calculateLevels(layer.size.x, layer.size.y), formatInfo.bytesPerTexel);
+}
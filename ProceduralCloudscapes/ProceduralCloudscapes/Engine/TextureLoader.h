@@ -0,0 +1,97 @@
+#ifndef TEXTURE_LOADER_H
+#define TEXTURE_LOADER_H
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include <string>
+#include <vector>
+#include <deque>
+#include <mutex>
+#include <functional>
+#include <unordered_map>
+
+#include "Texture.h"
+
+// number of layers that can be uploaded at the same time (slots of the staging ring)
+#define TEXTURE_LOADER_STAGING_SLOTS 4
+// size of the one staging slot in bytes (larger layers are uploaded directly from the client memory)
+#define TEXTURE_LOADER_SLOT_BYTES (8 << 20)
+// default number of the decoding threads (terrain page streaming already has all the other hardware threads at startup)
+#define TEXTURE_LOADER_THREADS 2
+
+class ThreadPool;
+
+// Asynchronous texture loader
+// Images are decoded by the worker threads and their layers are uploaded on the render thread through the staging
+// ring (persistently mapped pixel unpack buffer, every slot holds one layer and is reused once its fence is signaled).
+// Textures are created right away, but they are not resident (and should not be sampled) until all of their layers
+// are uploaded and their mipmaps are generated
+class TextureLoader {
+public:
+	TextureLoader(size_t numberOfThreads = TEXTURE_LOADER_THREADS);
+	~TextureLoader();
+
+	// creates the texture of the given number of layers which are queued later on (2D texture has one layer)
+	Texture* create(TextureType type, size_t layers = 1);
+	// creates 2D texture and decodes the image at the path on the worker thread
+	// NOTE: Precompressed container next to the image is used instead if there is one (texture is resident right away)
+	Texture* load(const std::string& path);
+	// runs the task on the worker thread (decoding tasks queue the layers once they are done)
+	void enqueue(std::function<void()> task);
+	// queues the decoded layer of the texture with the given ticket (thread-safe)
+	// NOTE: Empty data marks the layer as done without uploading it (image failed to load)
+	void queueUpload(uint64_t ticket, int layer, glm::ivec2 size, int channels, std::vector<unsigned char>&& data);
+
+	// uploads the queued layers into the free staging slots (has to be called every frame on the render thread)
+	void update();
+	// blocks until all the textures are resident
+	void finish();
+	// drops the layers of the texture that have not been uploaded yet (called once the texture is deleted)
+	void cancel(Texture* texture);
+
+	inline size_t getPendingTextures() const { return pendingTextures.size(); }
+	inline size_t getLoadedTextures() const { return loadedTextures; }
+	inline size_t getUploadedBytes() const { return uploadedBytes; }
+
+private:
+	// decoded layer (waiting to be uploaded)
+	struct QueuedLayer {
+		uint64_t ticket;
+		int layer;
+		glm::ivec2 size;
+		int channels;
+		std::vector<unsigned char> data;
+	};
+	// texture which is being loaded
+	struct PendingTexture {
+		Texture* texture;
+		size_t layers;
+		size_t uploadedLayers;
+		bool isAllocated;
+		int channels;
+	};
+
+	void allocateStagingRing();
+	void uploadLayer(PendingTexture& pending, QueuedLayer& layer);
+	void allocateTexture(PendingTexture& pending, const QueuedLayer& layer);
+
+	// worker threads and the layers they have decoded (guarded by the mutex)
+	ThreadPool* workers = nullptr;
+	std::mutex queuedMutex;
+	std::deque<QueuedLayer*> queuedLayers;
+
+	// textures which are being loaded (ticket -> texture), accessed only by the render thread
+	std::unordered_map<uint64_t, PendingTexture> pendingTextures;
+	uint64_t nextTicket = 1;
+	size_t loadedTextures = 0;
+	size_t uploadedBytes = 0;
+
+	// staging ring
+	unsigned int stagingBuffer = 0;
+	unsigned char* stagingData = nullptr;
+	GLsync stagingFences[TEXTURE_LOADER_STAGING_SLOTS] = {};
+	size_t stagingSlot = 0;
+};
+
+#endif // !TEXTURE_LOADER_H
@@ -0,0 +1,88 @@
+#include "ThreadPool.h"
+
+#include <algorithm>
+
+ThreadPool::ThreadPool(size_t numberOfThreads)
+{
+	// leave one hardware thread to the main thread
+	if (numberOfThreads == 0) {
+		size_t hardwareThreads = static_cast<size_t>(std::thread::hardware_concurrency());
+		numberOfThreads = std::max<size_t>(hardwareThreads, 2) - 1;
+	}
+
+	// start the workers
+	for (size_t i = 0; i < numberOfThreads; ++i) {
+		workers.emplace_back(&ThreadPool::work, this);
+	}
+}
+
+ThreadPool::~ThreadPool()
+{
+	// stop the workers (tasks which have not started are dropped)
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		tasks.clear();
+		isStopping = true;
+	}
+	taskAvailable.notify_all();
+	for (std::thread& worker : workers) {
+		worker.join();
+	}
+}
+
+void ThreadPool::enqueue(std::function<void()> task)
+{
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		tasks.push_back(std::move(task));
+	}
+	taskAvailable.notify_one();
+}
+
+void ThreadPool::clear()
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	tasks.clear();
+	if (activeTasks == 0)
+		tasksFinished.notify_all();
+}
+
+void ThreadPool::wait()
+{
+	std::unique_lock<std::mutex> lock(mutex);
+	tasksFinished.wait(lock, [this] { return tasks.empty() && activeTasks == 0; });
+}
+
+size_t ThreadPool::getPendingTasks()
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	return tasks.size() + activeTasks;
+}
+
+void ThreadPool::work()
+{
+	while (true) {
+		// wait for the task
+		std::function<void()> task;
+		{
+			std::unique_lock<std::mutex> lock(mutex);
+			taskAvailable.wait(lock, [this] { return isStopping || !tasks.empty(); });
+			if (isStopping)
+				return;
+			task = std::move(tasks.front());
+			tasks.pop_front();
+			++activeTasks;
+		}
+
+		// execute it
+		task();
+
+		// notify the ones waiting for all the tasks to finish
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			--activeTasks;
+			if (tasks.empty() && activeTasks == 0)
+				tasksFinished.notify_all();
+		}
+	}
+}
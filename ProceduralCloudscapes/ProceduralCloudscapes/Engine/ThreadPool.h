@@ -0,0 +1,40 @@
+#ifndef THREAD_POOL_H
+#define THREAD_POOL_H
+
+#include <vector>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+
+// Fixed number of worker threads which execute the enqueued tasks in FIFO order
+class ThreadPool {
+public:
+	// 0 uses all the hardware threads except the one the main (render) thread is on
+	ThreadPool(size_t numberOfThreads = 0);
+	~ThreadPool();
+
+	// adds the task to the end of the queue
+	void enqueue(std::function<void()> task);
+	// drops all the tasks which have not started yet
+	void clear();
+	// blocks until all the enqueued tasks have finished
+	void wait();
+
+	inline size_t getNumberOfThreads() const { return workers.size(); }
+	size_t getPendingTasks();
+
+private:
+	void work();
+
+	std::vector<std::thread> workers;
+	std::deque<std::function<void()>> tasks;
+	std::mutex mutex;
+	std::condition_variable taskAvailable;
+	std::condition_variable tasksFinished;
+	size_t activeTasks = 0;
+	bool isStopping = false;
+};
+
+#endif // !THREAD_POOL_H
@@ -10,6 +10,9 @@
 #include <glm/glm.hpp>
 #include <iostream>
 #include <cstdlib>
+#include <array>
+
+#define INT_CEIL(n,d) (int)ceil((float)n/d)
 
 namespace util {
 	template<typename T>
@@ -26,6 +29,17 @@ namespace util {
         return LO + static_cast <float> (rand()) / (static_cast <float> (RAND_MAX / (HI - LO)));
     }
 
+    // Extracts frustum planes (left, right, bottom, top, near, far) from the view-projection matrix
+    // Each plane is stored as (normal, distance) where points inside the frustum give positive result
+    static std::array<glm::vec4, 6> extractFrustumPlanes(const glm::mat4& viewProjection) {
+        // rows of the view-projection matrix (glm is column major)
+        glm::vec4 row0 = glm::vec4(viewProjection[0][0], viewProjection[1][0], viewProjection[2][0], viewProjection[3][0]);
+        glm::vec4 row1 = glm::vec4(viewProjection[0][1], viewProjection[1][1], viewProjection[2][1], viewProjection[3][1]);
+        glm::vec4 row2 = glm::vec4(viewProjection[0][2], viewProjection[1][2], viewProjection[2][2], viewProjection[3][2]);
+        glm::vec4 row3 = glm::vec4(viewProjection[0][3], viewProjection[1][3], viewProjection[2][3], viewProjection[3][3]);
+        return { row3 + row0, row3 - row0, row3 + row1, row3 - row1, row3 + row2, row3 - row2 };
+    }
+
     static unsigned int loadTexture(char const* path)
     {
         unsigned int textureID;
@@ -4,6 +4,13 @@
 #include "Window.h"
 #include "Camera.h"
 #include "Utilities.h"
+#include "TextureLoader.h"
+#include "ResourceManager.h"
+#include "FrameBufferObject.h"
+#include "ResolutionScaler.h"
+#include "FrameCapture.h"
+
+#include <algorithm>
 
 Camera* Window::camera = new Camera(glm::vec3(0.0f, 10.0f, 0.0f));
 
@@ -22,12 +29,31 @@ Window::Window(const char* title, size_t _width, size_t _height) : width(_width)
     gui = new GUI(*this);
     // subscribe to gui
     gui->subscribe(this);
+    // create texture loader
+    textureLoader = new TextureLoader();
+    // create resource manager
+    resources = new ResourceManager(textureLoader);
+    gui->subscribe(resources);
+    // create resolution scaler
+    resolutionScaler = new ResolutionScaler(this);
+    gui->subscribe(resolutionScaler);
+    // create frame capture
+    frameCapture = new FrameCapture(this);
+    gui->subscribe(frameCapture);
 }
 
 Window::~Window()
 {
+    // delete frame capture (frames in flight are written first)
+    delete frameCapture;
     // delete gui
     delete gui;
+    // delete resolution scaler
+    delete resolutionScaler;
+    // delete resource manager (its textures cancel their uploads)
+    delete resources;
+    // delete texture loader
+    delete textureLoader;
     // GLFW: terminate, clearing all previously allocated GLFW resources
     glfwTerminate();
 }
@@ -43,7 +69,19 @@ void Window::update()
         width = static_cast<size_t>(viewportWidth);
         height = static_cast<size_t>(viewportHeight);
         updateViewport = false;
+        updateRenderTargets = true;
+    }
+    // adjust the render scale from the GPU time of the last frames
+    resolutionScaler->update();
+    // resize the render targets (once per frame, not on every resize event while the window is dragged)
+    if (updateRenderTargets)
+    {
+        for (const RenderTarget& renderTarget : renderTargets)
+            resizeRenderTarget(renderTarget);
+        updateRenderTargets = false;
     }
+    // upload the textures decoded since the last frame
+    textureLoader->update();
     if (showGUI)
         gui->show();
     else
@@ -51,6 +89,40 @@ void Window::update()
     gui->update();
 }
 
+void Window::registerRenderTarget(FrameBufferObject* renderTarget, bool isScaled)
+{
+    renderTargets.push_back(RenderTarget{ renderTarget, isScaled });
+    // scaled targets are created in the window size
+    resizeRenderTarget(renderTargets.back());
+}
+
+void Window::unregisterRenderTarget(FrameBufferObject* renderTarget)
+{
+    renderTargets.erase(std::remove_if(renderTargets.begin(), renderTargets.end(), [renderTarget](const RenderTarget& registered) {
+        return registered.framebuffer == renderTarget;
+    }), renderTargets.end());
+}
+
+glm::ivec2 Window::getRenderSize() const
+{
+    return glm::max(glm::ivec2(glm::round(glm::vec2(width, height) * renderScale)), glm::ivec2(1));
+}
+
+void Window::setRenderScale(float _renderScale)
+{
+    renderScale = _renderScale;
+    updateRenderTargets = true;
+}
+
+void Window::resizeRenderTarget(const RenderTarget& renderTarget) const
+{
+    // minimized window has no size (render targets keep their size until it is restored)
+    if (width == 0 || height == 0)
+        return;
+    glm::ivec2 size = renderTarget.isScaled ? getRenderSize() : glm::ivec2(width, height);
+    renderTarget.framebuffer->resize(static_cast<unsigned int>(size.x), static_cast<unsigned int>(size.y));
+}
+
 void Window::calculateDeltaTime()
 {
     float currentFrame = (float)glfwGetTime();
@@ -131,7 +203,7 @@ void Window::buildGUI()
         window_flags |= ImGuiWindowFlags_NoMove;
     }
     if (infoType == 0)
-        ImGui::SetNextWindowSize(ImVec2(555, 155));
+        ImGui::SetNextWindowSize(ImVec2(555, 195));
     else
         ImGui::SetNextWindowSize(ImVec2(555, 55));
     ImGui::SetNextWindowBgAlpha(0.35f);
@@ -147,6 +219,8 @@ void Window::buildGUI()
 
             ImGui::TextWrapped("To enable/disable mouse cursor press TAB button on the keyboard.");
 
+            ImGui::TextWrapped("To take a screenshot press F12, to start/stop recording the frames press F9.");
+
             ImGui::TextWrapped("Move using WASD keys, mouse to look around, and scroll wheel to zoom IN/OUT.");
 
             ImGui::TextWrapped("Right click on this window to change its position, size and/or to hide it.");
@@ -155,6 +229,8 @@ void Window::buildGUI()
 
         }
 
+        ImGui::TextWrapped("Textures loading: %zu (%.1f MB uploaded)", textureLoader->getPendingTextures(), static_cast<float>(textureLoader->getUploadedBytes()) / (1024.f * 1024.f));
+
         ImGui::TextWrapped("Application average %.3f ms/frame (%.1f FPS)", 1000.0f / ImGui::GetIO().Framerate, ImGui::GetIO().Framerate);
 
         ImGui::PushItemWidth(400); // Sets slider size
@@ -26,6 +26,12 @@ enum class Callback
 	Scroll
 };
 
+class TextureLoader;
+class ResourceManager;
+class FrameBufferObject;
+class ResolutionScaler;
+class FrameCapture;
+
 class KeyReactor {
 public:
 	virtual void react(GLFWwindow* window, int key, int scancode, int action, int mods) = 0;
@@ -64,6 +70,15 @@ public:
 		keyReactors.push_back(reactor);
 	}
 
+	/// <summary>
+	/// Registers the framebuffer which is resized together with the window.
+	/// It has to be unregistered before it is deleted.
+	/// </summary>
+	/// <param name="renderTarget"></param>
+	/// <param name="isScaled">Framebuffer is sized by the render scale (dynamic resolution of the expensive passes).</param>
+	void registerRenderTarget(FrameBufferObject* renderTarget, bool isScaled = false);
+	void unregisterRenderTarget(FrameBufferObject* renderTarget);
+
 	/// <summary>
 	/// Returns GLFW Window object.
 	/// </summary>
@@ -80,6 +95,14 @@ public:
 	inline float getDeltaTime() const { return deltaTime; }
 	inline Camera* getCamera() const { return camera; }
 	inline GUI* getGUI() const { return gui; }
+	inline TextureLoader* getTextureLoader() const { return textureLoader; }
+	inline ResourceManager* getResources() const { return resources; }
+	inline ResolutionScaler* getResolutionScaler() const { return resolutionScaler; }
+	inline FrameCapture* getFrameCapture() const { return frameCapture; }
+	inline float getRenderScale() const { return renderScale; }
+	// size of the scaled render targets
+	glm::ivec2 getRenderSize() const;
+	void setRenderScale(float _renderScale);
 	inline bool isGUIVisible() const { return showGUI; }
 	glm::mat4 getProjectionMatrix() const;
 
@@ -149,10 +172,28 @@ private:
 	GLFWmonitor* glfwMonitor;
 
 	bool updateViewport;
+	// framebuffers of the window size (reallocated once the size of the window or the render scale changes)
+	struct RenderTarget {
+		FrameBufferObject* framebuffer;
+		bool isScaled;
+	};
+	std::vector<RenderTarget> renderTargets;
+	float renderScale = 1.f;
+	bool updateRenderTargets = false;
+
+	void resizeRenderTarget(const RenderTarget& renderTarget) const;
 
 	static Camera* camera;
 
 	GUI* gui;
+	// decodes the textures in the background and uploads them every frame
+	TextureLoader* textureLoader;
+	// shared textures, shaders and materials (kept between the scenes)
+	ResourceManager* resources;
+	// adjusts the render scale to hold the target frame time
+	ResolutionScaler* resolutionScaler;
+	// screenshots and image sequences of the rendered frames
+	FrameCapture* frameCapture;
 	static bool mouseCursorDisabled;
 
 	// Used for calculating current delta frame time.
@@ -7,7 +7,10 @@
 #include <GLFW/glfw3.h>
 #include <stb_image.h>
 #include <cstdlib>
+#include <cstring>
 #include <ctime>
+#include <iostream>
+#include <string>
 
 #include "Engine/Window.h"
 #include "Engine/Scene.h"
@@ -19,24 +22,94 @@
 #include "Scenes/PBRTestScene.h"
 #include "Scenes/CloudsTestScene.h"
 #include "Scenes/MainScene.h"
+#include "Engine/Environment/AtmosphereBaker.h"
+#include "Engine/TextureCompressor.h"
+#include "Engine/ResolutionScaler.h"
+#include "Engine/FrameCapture.h"
 
-int main()
+int main(int argc, char* argv[])
 {
+    // bake the atmosphere on the CPU without opening the window (--bake-atmosphere <directory> [sun altitude steps])
+    if (argc > 2 && strcmp(argv[1], "--bake-atmosphere") == 0) {
+        int sunAltitudeSteps = argc > 3 ? atoi(argv[3]) : 16;
+        AtmosphereBaker baker;
+        return baker.bake(argv[2], sunAltitudeSteps) ? 0 : 1;
+    }
+
     // generate seed for random number generation
     srand(static_cast <unsigned> (time(0)));
 
     // configure global stbi state
     stbi_set_flip_vertically_on_load(true);
 
+    // compress the textures into the containers next to them without opening the window (flipped the same way as the loaded images)
+    // --compress-materials <material directory>... (e.g. Textures/grass/ Textures/rock/ Textures/snow/)
+    // --compress-texture <image> <bc1|bc4|bc5|bc7>
+    if (argc > 2 && strcmp(argv[1], "--compress-materials") == 0) {
+        TextureCompressor compressor;
+        bool isSuccessful = true;
+        for (int i = 2; i < argc; ++i) {
+            std::string materialPath(argv[i]);
+            if (materialPath.back() != '/' && materialPath.back() != '\\')
+                materialPath.push_back('/');
+            isSuccessful &= compressor.compressMaterial(materialPath);
+        }
+        return isSuccessful ? 0 : 1;
+    }
+    if (argc > 3 && strcmp(argv[1], "--compress-texture") == 0) {
+        const char* formatNames[4] = { "bc1", "bc4", "bc5", "bc7" };
+        for (int format = 0; format < 4; ++format) {
+            if (strcmp(argv[3], formatNames[format]) == 0) {
+                TextureCompressor compressor;
+                return compressor.compress(argv[2], CompressedTexture::containerPath(argv[2]), static_cast<CompressedFormat>(format)) ? 0 : 1;
+            }
+        }
+        std::cout << "ERROR::MAIN Unknown compressed format " << argv[3] << "!" << std::endl;
+        return 1;
+    }
+
+    // run the scene for the given time and print the frame statistics (--benchmark <seconds>)
+    // record every frame into the directory (--record <directory> [png|raw]), it can be combined with the benchmark
+    double benchmarkTime = 0.0;
+    const char* recordingDirectory = nullptr;
+    CaptureFormat recordingFormat = CaptureFormat::png;
+    for (int i = 1; i < argc; ++i) {
+        if (i + 1 < argc && strcmp(argv[i], "--benchmark") == 0) {
+            benchmarkTime = atof(argv[++i]);
+        }
+        else if (i + 1 < argc && strcmp(argv[i], "--record") == 0) {
+            recordingDirectory = argv[++i];
+            if (i + 1 < argc && strcmp(argv[i + 1], "raw") == 0)
+                recordingFormat = CaptureFormat::raw;
+            if (i + 1 < argc && (strcmp(argv[i + 1], "raw") == 0 || strcmp(argv[i + 1], "png") == 0))
+                ++i;
+        }
+    }
+
     // create a window for rendering
     Window window;
 
     // load a scene that will show up in the window
     Scene* scene = new MainScene(&window);
 
+    // start recording the frames
+    if (recordingDirectory != nullptr)
+        window.getFrameCapture()->startRecording(recordingDirectory, recordingFormat);
+
     // render loop
+    double startTime = glfwGetTime();
     while (window.isRunning())
     {
+        // finish the benchmark
+        if (benchmarkTime > 0.0 && glfwGetTime() - startTime > benchmarkTime) {
+            window.getResolutionScaler()->report(std::cout);
+            if (recordingDirectory != nullptr) {
+                window.getFrameCapture()->finish();
+                window.getFrameCapture()->report(std::cout);
+            }
+            break;
+        }
+
         // update window (and GUI) every frame
         window.update();
 
@@ -46,6 +119,9 @@ int main()
         // draw the scene
         scene->draw();
 
+        // capture the frame (without the gui)
+        window.getFrameCapture()->update();
+
         // draw the gui
         window.getGUI()->draw();
 
@@ -6,6 +6,9 @@
 #include "../Engine/Environment/ColorEnvironment.h"
 #include "../Engine/FrameBufferObject.h"
 #include "../Engine/GUI/ImGUIExpansions.h"
+#include "../Engine/ResourceManager.h"
+#include "../Engine/ResolutionScaler.h"
+#include "../Engine/GPUTimer.h"
 
 static const char* cloudTypes[] = { "Cumulus", "Stratus", "Stratocumulus", "Cumulonimbus", "Mix" };
 
@@ -35,13 +38,14 @@ Clouds::Clouds(Window* _window) : SceneObject(_window)
 
 	// framebuffer configuration
 	framebuffer = new FrameBufferObject();
-	// create a color attachment texture
-	framebuffer->attachColorTexture((unsigned int)window->getWidth(), (unsigned int)window->getHeight());
-	// create a renderbuffer object for depth and stencil attachment (we won't be sampling these)
-	framebuffer->attachDepthTexture((unsigned int)window->getWidth(), (unsigned int)window->getHeight());
+	// create a color attachment texture (clouds are blended over the scene by their alpha)
+	// NOTE: Clouds are not depth tested (rays end at the scene depth), so there is no depth attachment
+	framebuffer->attachColorTexture((unsigned int)window->getWidth(), (unsigned int)window->getHeight(), TextureFormat::RGBA16F);
 	// now that we actually created the framebuffer and added all attachments we want to check if it is actually complete now
 	if (!framebuffer->checkStatus())
 		std::cout << "ERROR::FRAMEBUFFER:: Framebuffer is not complete!" << std::endl;
+	// resize the framebuffer together with the window (clouds are rendered in the dynamic render scale)
+	window->registerRenderTarget(framebuffer, true);
 
 	// Generate textures for shader program
 	generateNoiseTextures();
@@ -52,13 +56,15 @@ Clouds::Clouds(Window* _window) : SceneObject(_window)
 	weatherMapShader->linkProgram();
 
 	// Create weather map texture
-	weatherMapTex = new Texture(TextureType::twoDimensional, glm::vec3(1024.f, 1024.f, 0.f), 4, true);
+	weatherMapTex = new Texture(TextureType::twoDimensional, glm::vec3(1024.f, 1024.f, 0.f), TextureFormat::RGBA8);
 
 	// Generate weather map
 	generateWeatherMap();
 
 	// Build and compile the shader program
-	cloudsShader = new ScreenShader("Shaders/Clouds/clouds.frag");
+	cloudsShader = new ScreenShader("Shaders/Clouds/clouds.frag", "Shaders/Screen/farPlane.vert");
+	compositeShader = new ScreenShader("Shaders/Clouds/cloudsComposite.frag", "Shaders/Screen/farPlane.vert");
+	cloudsTimer = new GPUTimer();
 
 	// Subscribe to GUI
 	window->getGUI()->subscribe(this);
@@ -69,16 +75,20 @@ Clouds::Clouds(Window* _window) : SceneObject(_window)
 
 Clouds::~Clouds()
 {
-	// delete noise textures
-	delete perlinWorleyTex;
-	delete worleyTex;
-	delete curlTex;
+	// release noise textures
+	ResourceManager* resources = window->getResources();
+	resources->release(perlinWorleyTex);
+	resources->release(worleyTex);
+	resources->release(curlTex);
 	// delete weather map items
 	delete weatherMapTex;
 	delete weatherMapShader;
-	// delete clouds shader
+	// delete clouds shaders
 	delete cloudsShader;
+	delete compositeShader;
+	delete cloudsTimer;
 	// delete framebuffer
+	window->unregisterRenderTarget(framebuffer);
 	delete framebuffer;
 }
 
@@ -89,11 +99,6 @@ void Clouds::update()
 	// wait for all the memory stores, loads, textures fetches, vertex fetches
 	glMemoryBarrier(GL_SHADER_IMAGE_ACCESS_BARRIER_BIT);
 
-	// bind the framebuffer
-	framebuffer->bind();
-	// clear its data before any rendering
-	framebuffer->clear();
-
 	// configure shader data
 	Shader* shader = cloudsShader->getShader();
 	shader->use();
@@ -102,16 +107,14 @@ void Clouds::update()
 	shader->setVec3("cameraPosition", camera->getPosition());
 	shader->setMat4("inverseProjection", glm::inverse(window->getProjectionMatrix()));
 	shader->setMat4("inverseView", glm::inverse(camera->getViewMatrix()));
-	shader->setVec2("resolution", window->getSize());
+	shader->setVec2("resolution", glm::vec2(framebuffer->getWidth(), framebuffer->getHeight()));
 
 	// set shaders sky info
 	SkyboxEnvironment* env = getScene()->getEnvironment<SkyboxEnvironment>();
 	if (env != nullptr) {
-		shader->setFloat("sunAltitude", env->getSunAltitude());
-		shader->setFloat("sunAzimuth", env->getSunAzimuth());
-		shader->setFloat("sunIntensity", env->getSunIntensity());
-		shader->setVec3("sunColorDay", env->getSunColorDay().getf());
-		shader->setVec3("sunColorSunset", env->getSunColorSunset().getf());
+		env->setSunUniforms(shader);
+		env->bindAerialPerspective(6);
+		glActiveTexture(GL_TEXTURE0);
 	}
 	else {
 		std::cout << "ERROR::CLOUDS::update() Clouds should be rendered only using Skybox environment!" << std::endl;
@@ -120,6 +123,10 @@ void Clouds::update()
 	// set 2D textures
 	shader->setSampler("weatherMapTex", *weatherMapTex, 0);
 	shader->setSampler("environmentTex", *getScene()->getEnvironmentTexture(), 3);
+	shader->setSampler("curlTex", *curlTex, 4);
+	// set scene depth (rays end at the scene objects in front of the clouds)
+	glActiveTexture(GL_TEXTURE5);
+	glBindTexture(GL_TEXTURE_2D, getScene()->getDepthTextureID());
 
 	// set 3D textures
 	shader->setSampler("perlinWorleyTex", *perlinWorleyTex, 1);
@@ -144,15 +151,27 @@ void Clouds::update()
 	shader->setFloat("powderCoeff", data->powderCoeff);
 	shader->setFloat("csi", data->csi);
 
+	// disable depth test so clouds are drawn in front of the scene objects too (shader ends the rays at the scene depth)
+	glDisable(GL_DEPTH_TEST);
+
+	// render the clouds into the framebuffer in the render scale (every pixel is written, so it is not cleared)
+	cloudsTimer->begin();
+	framebuffer->bind();
+	glViewport(0, 0, framebuffer->getWidth(), framebuffer->getHeight());
+	cloudsShader->draw();
 	FrameBufferObject::unbind();
+	glViewport(0, 0, static_cast<GLsizei>(window->getWidth()), static_cast<GLsizei>(window->getHeight()));
+	cloudsTimer->end();
+	if (cloudsTimer->hasResult())
+		window->getResolutionScaler()->reportPass(cloudsTimer->getMilliseconds());
 
-	// disable depth test so screen-space quad isn't discarded due to depth test
-	glDisable(GL_DEPTH_TEST);
 	// enable blending
 	glEnable(GL_BLEND);
 	glBlendFunc(GL_DST_ALPHA, GL_SRC_ALPHA);
-	// draw the screen shader with the buffer texture
-	cloudsShader->draw(*framebuffer->getColorTexture(0));
+	// upscale the clouds and blend them over the scene
+	compositeShader->getShader()->use();
+	glActiveTexture(GL_TEXTURE0);
+	compositeShader->draw(*framebuffer->getColorTexture(0));
 	// enable back depth test
 	glEnable(GL_DEPTH_TEST);
 	// disable back blending
@@ -299,51 +318,80 @@ void Clouds::buildHiddenGUI()
 
 void Clouds::generateNoiseTextures()
 {
+	// NOTE: Noise textures do not depend on the clouds settings, so all the clouds share them (they are generated once)
+	ResourceManager* resources = window->getResources();
+
 	// =============================================
 	// 1st 3D texture (Perlin-Worley) (128^3) RGBA
 	// =============================================
 
-	// create shader
-	Shader* perlinWorleyShader = new Shader();
-	perlinWorleyShader->attachShader("Shaders/Noise/perlinWorley.comp", ShaderInfo(ShaderType::kCompute));
-	perlinWorleyShader->linkProgram();
+	perlinWorleyTex = resources->acquireTexture("noise:perlinWorley:128", [resources]() {
+		// create shader
+		Shader* perlinWorleyShader = resources->acquireShader({ { "Shaders/Noise/perlinWorley.comp", ShaderType::kCompute } });
 
-	// create texture
-	perlinWorleyTex = new Texture(TextureType::threeDimensional, glm::vec3(128), 4, true);
+		// create texture
+		Texture* texture = new Texture(TextureType::threeDimensional, glm::vec3(128), TextureFormat::RGBA8);
 
-	// configure shader
-	perlinWorleyShader->use();
-	glActiveTexture(GL_TEXTURE0);
-	perlinWorleyShader->setInt("perlinWorleyTex", 0);
-	glBindTexture(GL_TEXTURE_3D, perlinWorleyTex->ID);
-	glBindImageTexture(0, perlinWorleyTex->ID, 0, GL_TRUE, 0, GL_READ_WRITE, GL_RGBA8);
-	glDispatchCompute(INT_CEIL(128, 4), INT_CEIL(128, 4), INT_CEIL(128, 4));
+		// configure shader
+		perlinWorleyShader->use();
+		glActiveTexture(GL_TEXTURE0);
+		perlinWorleyShader->setInt("perlinWorleyTex", 0);
+		glBindTexture(GL_TEXTURE_3D, texture->ID);
+		texture->bind(0);
+		glDispatchCompute(INT_CEIL(128, 4), INT_CEIL(128, 4), INT_CEIL(128, 4));
 
-	// delete shader
-	delete perlinWorleyShader;
+		// release shader
+		resources->release(perlinWorleyShader);
+		return texture;
+	});
 
 	// =============================================
 	// 2nd 3D texture (Worley) (32^3) RGB
 	// =============================================
 
-	// create shader
-	Shader* worleyShader = new Shader();
-	worleyShader->attachShader("Shaders/Noise/worley.comp", ShaderInfo(ShaderType::kCompute));
-	worleyShader->linkProgram();
+	worleyTex = resources->acquireTexture("noise:worley:32", [resources]() {
+		// create shader
+		Shader* worleyShader = resources->acquireShader({ { "Shaders/Noise/worley.comp", ShaderType::kCompute } });
 
-	// create texture
-	worleyTex = new Texture(TextureType::threeDimensional, glm::vec3(32), 4, true);
+		// create texture (only RGB is sampled, but there is no RGB image format)
+		Texture* texture = new Texture(TextureType::threeDimensional, glm::vec3(32), TextureFormat::RGBA8);
 
-	// configure shader
-	worleyShader->use();
-	glActiveTexture(GL_TEXTURE0);
-	worleyShader->setInt("worleyTex", 0);
-	glBindTexture(GL_TEXTURE_3D, worleyTex->ID);
-	glBindImageTexture(0, worleyTex->ID, 0, GL_TRUE, 0, GL_READ_WRITE, GL_RGBA8);
-	glDispatchCompute(INT_CEIL(32, 4), INT_CEIL(32, 4), INT_CEIL(32, 4));
+		// configure shader
+		worleyShader->use();
+		glActiveTexture(GL_TEXTURE0);
+		worleyShader->setInt("worleyTex", 0);
+		glBindTexture(GL_TEXTURE_3D, texture->ID);
+		texture->bind(0);
+		glDispatchCompute(INT_CEIL(32, 4), INT_CEIL(32, 4), INT_CEIL(32, 4));
+
+		// release shader
+		resources->release(worleyShader);
+		return texture;
+	});
+
+	// =============================================
+	// 2D texture (Curl) (128^2) RG
+	// =============================================
 
-	// delete shader
-	delete worleyShader;
+	curlTex = resources->acquireTexture("noise:curl:128", [resources]() {
+		// create shader
+		Shader* curlShader = resources->acquireShader({ { "Shaders/Noise/curl.comp", ShaderType::kCompute } });
+
+		// create texture
+		Texture* texture = new Texture(TextureType::twoDimensional, glm::vec3(128.f, 128.f, 0.f), TextureFormat::RG8);
+
+		// configure shader
+		curlShader->use();
+		glActiveTexture(GL_TEXTURE0);
+		curlShader->setInt("curlTex", 0);
+		glBindTexture(GL_TEXTURE_2D, texture->ID);
+		texture->bind(0);
+		glDispatchCompute(INT_CEIL(128, 8), INT_CEIL(128, 8), 1);
+
+		// release shader
+		resources->release(curlShader);
+		return texture;
+	});
 }
 
 void Clouds::generateWeatherMap()
@@ -353,7 +401,7 @@ void Clouds::generateWeatherMap()
 	weatherMapShader->setInt("weatherMapTex", 0);
 	weatherMapShader->setInt("cloudsType", static_cast<int>(getCloudsType()));
 	glBindTexture(GL_TEXTURE_2D, weatherMapTex->ID);
-	glBindImageTexture(0, weatherMapTex->ID, 0, GL_FALSE, 0, GL_READ_WRITE, GL_RGBA8);
+	weatherMapTex->bind(0);
 	glDispatchCompute(INT_CEIL(1024, 8), INT_CEIL(1024, 8), 1);
 }
 
@@ -1,8 +1,6 @@
 #ifndef CLOUDS_H
 #define CLOUDS_H
 
-#define INT_CEIL(n,d) (int)ceil((float)n/d)
-
 #include "../Engine/SceneObject.h"
 #include "../Engine/Texture.h"
 #include "../Engine/Shader.h"
@@ -12,6 +10,7 @@
 
 class ScreenShader;
 class FrameBufferObject;
+class GPUTimer;
 
 enum class CloudsType {
 	Cumulus = 0,
@@ -70,6 +69,7 @@ public:
 	~Clouds();
 
 	void update() override;
+	bool isBackground() const override { return true; }
 	void buildGUI() override;
 	void buildHiddenGUI() override;
 	void react(GLFWwindow* window, int key, int scancode, int action, int mods) override;
@@ -173,6 +173,10 @@ private:
 	Shader* weatherMapShader = nullptr;
 
 	ScreenShader* cloudsShader = nullptr;
+	// upscales the clouds rendered in the render scale and blends them over the scene
+	ScreenShader* compositeShader = nullptr;
+	// GPU time of the clouds rendering (reported to the resolution scaler)
+	GPUTimer* cloudsTimer = nullptr;
 
 	CloudsData* data = nullptr;
 
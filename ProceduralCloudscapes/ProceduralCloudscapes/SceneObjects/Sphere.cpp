@@ -1,6 +1,7 @@
 #include "Sphere.h"
 
 #include "../Engine/Scene.h"
+#include "../Engine/ResourceManager.h"
 #include "../Engine/Environment/SkyboxEnvironment.h"
 
 Sphere::Sphere(Window* _window, const char* texturesPath, glm::vec3 _translate) : SceneObject(_window)
@@ -8,11 +9,9 @@ Sphere::Sphere(Window* _window, const char* texturesPath, glm::vec3 _translate)
     // initialize member variables
     translate = _translate;
 
-    // build and compile shader programs
-    shader = new Shader();
-    shader->attachShader("Shaders/PBR/PBR.vert", ShaderInfo(ShaderType::kVertex));
-    shader->attachShader("Shaders/PBR/PBR.frag", ShaderInfo(ShaderType::kFragment));
-    shader->linkProgram();
+    // build and compile shader programs (shared by all the spheres)
+    ResourceManager* resources = window->getResources();
+    shader = resources->acquireShader({ { "Shaders/PBR/PBR.vert", ShaderType::kVertex }, { "Shaders/PBR/PBR.frag", ShaderType::kFragment } });
 
     // generate paths for the textures
     std::string baseTexturePath(texturesPath);
@@ -32,12 +31,13 @@ Sphere::Sphere(Window* _window, const char* texturesPath, glm::vec3 _translate)
     std::string aoPath(baseTexturePath);
     aoPath.append("ao.png");
 
-    // load and create textures
-    albedoTex = new Texture(albedoPath.c_str());
-    normalTex = new Texture(normalPath.c_str());
-    metallicTex = new Texture(metallicPath.c_str());
-    roughnessTex = new Texture(roughnessPath.c_str());
-    aoTex = new Texture(aoPath.c_str());
+    // load and create textures (decoded in the background, sphere is drawn once they are resident)
+    // NOTE: Spheres of the same material share the textures
+    albedoTex = resources->acquireTexture(albedoPath);
+    normalTex = resources->acquireTexture(normalPath);
+    metallicTex = resources->acquireTexture(metallicPath);
+    roughnessTex = resources->acquireTexture(roughnessPath);
+    aoTex = resources->acquireTexture(aoPath);
 
     // configure sphere data
     configureData();
@@ -45,18 +45,23 @@ Sphere::Sphere(Window* _window, const char* texturesPath, glm::vec3 _translate)
 
 Sphere::~Sphere()
 {
-    // delete shader
-    delete shader;
-    // delete textures
-    delete albedoTex;
-    delete normalTex;
-    delete metallicTex;
-    delete roughnessTex;
-    delete aoTex;
+    // release shader
+    ResourceManager* resources = window->getResources();
+    resources->release(shader);
+    // release textures
+    resources->release(albedoTex);
+    resources->release(normalTex);
+    resources->release(metallicTex);
+    resources->release(roughnessTex);
+    resources->release(aoTex);
 }
 
 void Sphere::update()
 {
+    // wait for the textures
+    if (!areTexturesResident())
+        return;
+
     Camera* camera = window->getCamera();
 
     shader->use();
@@ -81,9 +86,7 @@ void Sphere::update()
     // set shaders sky info
     SkyboxEnvironment* env = getScene()->getEnvironment<SkyboxEnvironment>();
     if (env != nullptr) {
-        shader->setFloat("sunAltitude", env->getSunAltitude());
-        shader->setFloat("sunAzimuth", env->getSunAzimuth());
-        shader->setFloat("sunIntensity", env->getSunIntensity());
+        env->setSunUniforms(shader);
     }
     else {
         std::cout << "ERROR::CLOUDS::update() Clouds should be rendered only using Skybox environment!" << std::endl;
@@ -94,6 +97,11 @@ void Sphere::update()
     glDrawElements(GL_TRIANGLE_STRIP, static_cast<GLsizei>(indexCount), GL_UNSIGNED_INT, 0);
 }
 
+bool Sphere::areTexturesResident() const
+{
+    return albedoTex->isResident() && normalTex->isResident() && metallicTex->isResident() && roughnessTex->isResident() && aoTex->isResident();
+}
+
 void Sphere::configureData()
 {
     glGenVertexArrays(1, &sphereVAO);
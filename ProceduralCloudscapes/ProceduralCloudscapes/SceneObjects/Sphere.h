@@ -28,6 +28,7 @@ private:
 	size_t indexCount = 0;
 
 	void configureData();
+	bool areTexturesResident() const;
 };
 
 #endif // !SPHERE_H
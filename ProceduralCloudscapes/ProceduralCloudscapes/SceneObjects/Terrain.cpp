@@ -2,6 +2,7 @@
 
 #include <glm/gtx/string_cast.hpp>
 #include <imgui.h>
+#include <limits>
 
 #include "../Engine/Shader.h"
 #include "../Engine/GUI/ImGUIExpansions.h"
@@ -9,7 +10,11 @@
 #include "../Engine/Environment/SkyboxEnvironment.h"
 #include "../Engine/Scene.h"
 #include "../Engine/Texture.h"
+#include "../Engine/Sampler.h"
 #include "../Engine/PBRMaterial.h"
+#include "../Engine/ResourceManager.h"
+#include "TerrainHeightmap.h"
+#include "TerrainHeightField.h"
 
 Terrain::Terrain(Window* _window) : SceneObject(_window)
 {
@@ -28,7 +33,9 @@ Terrain::Terrain(Window* _window) : SceneObject(_window)
 		1.f		// frequency multiplier
 	};
 	data->wireframe = false;
-	data->tileSize = 100;
+	data->clipmapLevels = 6;
+	data->culling = true;
+	data->pixelsPerEdge = 12.f;
 	data->grassCoverage = 0.5f;
 	data->snowCoverage = 0.7f;
 	data->grassColor = Color(0.06f, 0.25f, 0.03f);
@@ -37,36 +44,59 @@ Terrain::Terrain(Window* _window) : SceneObject(_window)
 	data->grassScale = 1.f;
 	data->rockScale = 1.f;
 	data->snowScale = 1.f;
-	data->fogFalloff = 15.f;
-	data->fogColor = Color(0.43f, 0.53f, 0.68f);
-	data->isRealFog = true;
 
 	// Subscribe to GUI
 	window->getGUI()->subscribe(this);
 
 	// Create terrain shader
-	shader = new Shader();
-	shader->attachShader("Shaders/Terrain/terrain.vert", ShaderInfo(ShaderType::kVertex));
-	shader->attachShader("Shaders/Terrain/terrain.tesc", ShaderInfo(ShaderType::kTessControl));
-	shader->attachShader("Shaders/Terrain/terrain.tese", ShaderInfo(ShaderType::kTessEvaluation));
-	shader->attachShader("Shaders/Terrain/terrain.frag", ShaderInfo(ShaderType::kFragment));
-	shader->linkProgram();
+	ResourceManager* resources = window->getResources();
+	shader = resources->acquireShader({
+		{ "Shaders/Terrain/terrain.vert", ShaderType::kVertex },
+		{ "Shaders/Terrain/terrain.tesc", ShaderType::kTessControl },
+		{ "Shaders/Terrain/terrain.tese", ShaderType::kTessEvaluation },
+		{ "Shaders/Terrain/terrain.frag", ShaderType::kFragment } });
+
+	// Create terrain culling shader
+	cullingShader = resources->acquireShader({ { "Shaders/Terrain/terrainCulling.comp", ShaderType::kCompute } });
+
+	// Create virtual heightmap
+	heightmap = new TerrainHeightmap(data->clipmapLevels);
+
+	// Create CPU height field and keep the camera above the terrain
+	heightField = new TerrainHeightField(data->terrainNoise);
+	window->getCamera()->setGroundHeight([this](float x, float z) { return heightField->getHeight(x, z); });
+	lastCameraPosition = window->getCamera()->getPosition();
 
 	// load and create PBR materials
-	grassMaterial = new PBRMaterial("Textures/grass/");
-	rockMaterial = new PBRMaterial("Textures/rock/");
-	snowMaterial = new PBRMaterial("Textures/snow/");
+	// NOTE: Layers are grass (0), rock (1) and snow (2), same as in terrain.frag
+	// NOTE: Materials are streamed in by the window's texture loader (terrain is not drawn until they are resident)
+	materials = resources->acquireMaterial({ "Textures/grass/", "Textures/rock/", "Textures/snow/" });
+	materialSampler = new Sampler(GL_LINEAR_MIPMAP_LINEAR, GL_LINEAR, GL_REPEAT, 8.f);
 
 	// Generate VAO, VBO and EBO
 	glGenVertexArrays(1, &terrainVAO);
 	glGenBuffers(1, &terrainVBO);
 	glGenBuffers(1, &terrainEBO);
 
-	// Generate position buffer
-	glGenBuffers(1, &positionBuffer);
+	// Generate block buffers (all clipmap blocks and only the visible ones)
+	glGenBuffers(1, &blockBuffer);
+	glGenBuffers(1, &blockHeightBuffer);
+	glGenBuffers(1, &visibleBlockBuffer);
 
-	// Initialize position buffer data size
-	positionBufferData.resize(data->tileSize * data->tileSize);
+	// Generate indirect draw command buffer (DrawElementsIndirectCommand + culled blocks counter)
+	glGenBuffers(1, &drawCommandBuffer);
+	glBindBuffer(GL_DRAW_INDIRECT_BUFFER, drawCommandBuffer);
+	glBufferData(GL_DRAW_INDIRECT_BUFFER, 6 * sizeof(GLuint), NULL, GL_DYNAMIC_DRAW);
+	glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+
+	// Generate culling statistics buffer (copy of the draw command, later passes do not write into it)
+	glGenBuffers(1, &statisticsBuffer);
+	glBindBuffer(GL_COPY_WRITE_BUFFER, statisticsBuffer);
+	glBufferData(GL_COPY_WRITE_BUFFER, 6 * sizeof(GLuint), NULL, GL_STREAM_READ);
+	glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+
+	// Allocate clipmap buffers
+	generateClipmapBuffers();
 
 	// Prepare data for terrain generation
 	generateTerrainData();
@@ -74,27 +104,49 @@ Terrain::Terrain(Window* _window) : SceneObject(_window)
 
 Terrain::~Terrain()
 {
-	// Delete shader
-	delete shader;
+	// Release shaders
+	ResourceManager* resources = window->getResources();
+	resources->release(shader);
+	resources->release(cullingShader);
 	// Delete data
 	delete data;
 	// Delete buffers
 	glDeleteVertexArrays(1, &terrainVAO);
 	glDeleteBuffers(1, &terrainVBO);
 	glDeleteBuffers(1, &terrainEBO);
-	glDeleteBuffers(1, &positionBuffer);
-	// Delete materials
-	delete grassMaterial;
-	delete rockMaterial;
-	delete snowMaterial;
+	glDeleteBuffers(1, &blockBuffer);
+	glDeleteBuffers(1, &blockHeightBuffer);
+	glDeleteBuffers(1, &visibleBlockBuffer);
+	glDeleteBuffers(1, &drawCommandBuffer);
+	glDeleteBuffers(1, &statisticsBuffer);
+	// Delete fence
+	if (cullingFence != nullptr)
+		glDeleteSync(cullingFence);
+	// Release materials
+	resources->release(materials);
+	delete materialSampler;
+	// Delete heightmap and height field (camera is shared, so it can't use it anymore)
+	delete heightmap;
+	window->getCamera()->setGroundHeight(nullptr);
+	delete heightField;
 }
 
 void Terrain::update()
 {
 	Camera* camera = window->getCamera();
 
-	// Prepare data for terrain generation
-	updatePositionData();
+	// Move the clipmap with the camera and cull its blocks (prepares the indirect draw command)
+	// NOTE: Block height bounds have to be recalculated once the noise changes
+	updateClipmap(heightField->setNoise(data->terrainNoise));
+	cullBlocks();
+
+	// Generate heightmap pages for the regions the clipmap has moved into and stream the ones it is heading to
+	heightmap->update(levelCenters, getScale(), data->terrainNoise);
+	prefetchHeightmap();
+
+	// Draw the terrain once its materials are loaded
+	if (!materials->isResident())
+		return;
 
 	// Enable wireframe rendering if set
 	if (data->wireframe) {
@@ -109,40 +161,42 @@ void Terrain::update()
 	shader->setMat4("gVP", window->getProjectionMatrix() * camera->getViewMatrix());
 	shader->setMat4("inverseProjection", glm::inverse(window->getProjectionMatrix()));
 	shader->setMat4("inverseView", glm::inverse(camera->getViewMatrix()));
+	shader->setVec2("resolution", window->getSize());
+
+	// Set tessellation info (screen space edge length and patch culling)
+	shader->setFloat("projectionScale", window->getProjectionMatrix()[1][1] * static_cast<float>(window->getHeight()) * 0.5f);
+	shader->setFloat("pixelsPerEdge", data->pixelsPerEdge);
+	std::array<glm::vec4, 6> frustumPlanes = calculateFrustumPlanes();
+	for (size_t i = 0; i < frustumPlanes.size(); ++i) {
+		shader->setVec4("frustumPlanes[" + std::to_string(i) + "]", frustumPlanes[i]);
+	}
+	shader->setFloat("maxHeight", calculateMaxHeight());
+
+	// Set clipmap info (level bounds are used to match the tessellation between the levels)
+	shader->setFloat("tileScale", data->scale);
+	shader->setInt("blockResolution", static_cast<int>(getResolution()));
+	shader->setInt("clipmapLevels", static_cast<int>(levelBounds.size()));
+	for (size_t i = 0; i < levelBounds.size(); ++i) {
+		shader->setVec4("levelBounds[" + std::to_string(i) + "]", levelBounds[i]);
+	}
+
+	// Set terrain heightmap (height and normal pages with the page table)
+	heightmap->bind(shader, 15, 16);
 
-	// Set terrain noise params
-	shader->setFloat("terrainNoise.amplitude", data->terrainNoise.amplitude);
-	shader->setFloat("terrainNoise.frequency", data->terrainNoise.frequency * data->terrainNoise.frequencyMultiplier);
-	shader->setInt("terrainNoise.octaves", data->terrainNoise.octaves);
-	shader->setFloat("terrainNoise.lacunarity", data->terrainNoise.lacunarity);
-	shader->setFloat("terrainNoise.gain", data->terrainNoise.gain);
-	shader->setVec2("terrainNoise.seed", data->terrainNoise.seed);
-	shader->setFloat("terrainNoise.power", data->terrainNoise.power);
+	// Set terrain materials (grass, rock and snow are layers of the same textures)
+	shader->setSampler("materialAlbedo", *materials->getAlbedo(), 0, *materialSampler);
+	shader->setSampler("materialNormal", *materials->getNormal(), 1, *materialSampler);
+	shader->setSampler("materialORM", *materials->getORM(), 2, *materialSampler);
 
 	// Set terrain grass material
-	shader->setSampler("grassAlbedo", *grassMaterial->getAlbedo(), 0);
-	shader->setSampler("grassNormal", *grassMaterial->getNormal(), 1);
-	shader->setSampler("grassMetallic", *grassMaterial->getMetallic(), 2);
-	shader->setSampler("grassRoughness", *grassMaterial->getRoughness(), 3);
-	shader->setSampler("grassAO", *grassMaterial->getAO(), 4);
 	shader->setVec3("grassBaseColor", data->grassColor.getf());
 	shader->setFloat("grassScale", data->grassScale * (data->scale / 1000.f));
 
 	// Set terrain rock material
-	shader->setSampler("rockAlbedo", *rockMaterial->getAlbedo(), 5);
-	shader->setSampler("rockNormal", *rockMaterial->getNormal(), 6);
-	shader->setSampler("rockMetallic", *rockMaterial->getMetallic(), 7);
-	shader->setSampler("rockRoughness", *rockMaterial->getRoughness(), 8);
-	shader->setSampler("rockAO", *rockMaterial->getAO(), 9);
 	shader->setVec3("rockBaseColor", data->rockColor.getf());
 	shader->setFloat("rockScale", data->rockScale * (data->scale / 1000.f));
 
 	// Set terrain snow material
-	shader->setSampler("snowAlbedo", *snowMaterial->getAlbedo(), 10);
-	shader->setSampler("snowNormal", *snowMaterial->getNormal(), 11);
-	shader->setSampler("snowMetallic", *snowMaterial->getMetallic(), 12);
-	shader->setSampler("snowRoughness", *snowMaterial->getRoughness(), 13);
-	shader->setSampler("snowAO", *snowMaterial->getAO(), 14);
 	shader->setVec3("snowBaseColor", data->snowColor.getf());
 	shader->setFloat("snowScale", data->snowScale * (data->scale / 1000.f));
 
@@ -150,28 +204,28 @@ void Terrain::update()
 	shader->setFloat("grassCoverage", data->grassCoverage);
 	shader->setFloat("snowCoverage", data->snowCoverage);
 
-	// Set terrain fog values
-	shader->setFloat("fogFalloff", data->fogFalloff);
-	shader->setVec3("fogColor", data->fogColor.getf());
-	shader->setBool("isRealFog", data->isRealFog);
-
 	// Set sky info
 	SkyboxEnvironment* env = getScene()->getEnvironment<SkyboxEnvironment>();
 	if (env != nullptr) {
-		shader->setFloat("sunAltitude", env->getSunAltitude());
-		shader->setFloat("sunAzimuth", env->getSunAzimuth());
-		shader->setFloat("sunIntensity", env->getSunIntensity());
+		env->setSunUniforms(shader);
+		env->bindAerialPerspective(17);
+		glActiveTexture(GL_TEXTURE0);
 	}
 	else {
 		std::cout << "ERROR::CLOUDS::update() Clouds should be rendered only using Skybox environment!" << std::endl;
 	}
 
-	// Draw the terrain
-	size_t resolution = getResolution();
+	// Draw the visible terrain blocks
 	glBindVertexArray(terrainVAO);
-	glDrawElementsInstanced(GL_PATCHES, static_cast<GLsizei>((resolution - 1) * (resolution - 1) * 2 * 3), GL_UNSIGNED_INT, 0, static_cast<GLsizei>(positionBufferData.size()));
+	glBindBuffer(GL_DRAW_INDIRECT_BUFFER, drawCommandBuffer);
+	glDrawElementsIndirect(GL_PATCHES, indexType, 0);
+	glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
 	glBindVertexArray(0);
 
+	// Unbind the material sampler (other objects sample the same units with the texture parameters)
+	for (GLenum unit = 0; unit < 3; ++unit)
+		Sampler::unbind(unit);
+
 	// Disable wireframe mode
 	glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
 }
@@ -189,6 +243,40 @@ void Terrain::buildGUI()
 		imgui_exp::ToggleButton("Wireframe", &isWireframe);
 		setWireframe(isWireframe);
 
+		// Culling switch
+		bool isCulling = getCulling();
+		imgui_exp::ToggleButton("Culling", &isCulling);
+		setCulling(isCulling);
+
+		// Pixels per edge
+		float pixelsPerEdge = getPixelsPerEdge();
+		ImGui::SliderFloat("Pixels per edge", &pixelsPerEdge, 1.f, 64.f);
+		setPixelsPerEdge(pixelsPerEdge);
+
+		// Culling statistics
+		ImGui::Text("Visible blocks: %u, culled blocks: %u", visibleBlocks, culledBlocks);
+
+		// Heightmap statistics
+		ImGui::Text("Heightmap pages: %zu/%zu (generated %zu, streamed %zu, pending %zu)", heightmap->getResidentPages(), heightmap->getCapacity(),
+			heightmap->getGeneratedPages(), heightmap->getStreamedPages(), heightmap->getPendingPages());
+
+		// Heightmap memory budget
+		int memoryBudget = static_cast<int>(heightmap->getMemoryBudget() >> 20);
+		ImGui::SliderInt("Heightmap budget (MB)", &memoryBudget, 32, 1024);
+		if (static_cast<size_t>(memoryBudget) << 20 != heightmap->getMemoryBudget()) {
+			heightmap->setMemoryBudget(static_cast<size_t>(memoryBudget) << 20);
+		}
+
+		// Clipmap levels
+		int clipmapLevels = static_cast<int>(getClipmapLevels());
+		ImGui::SliderInt("Clipmap levels", &clipmapLevels, 1, MAX_CLIPMAP_LEVELS);
+		if (clipmapLevels != getClipmapLevels()) {
+			setClipmapLevels(clipmapLevels);
+			heightmap->resize(getClipmapLevels());
+			generateClipmapBuffers();
+			updateClipmap(true);
+		}
+
 		bool generateNewTerrainData = false;
 
 		// Scale
@@ -209,25 +297,6 @@ void Terrain::buildGUI()
 		}
 	}
 
-	// Crete terrain post-processing header
-	if (ImGui::CollapsingHeader("Post-processing", ImGuiTreeNodeFlags_DefaultOpen))
-	{
-		// Fog falloff
-		float fogFalloff = getFogFalloff();
-		ImGui::SliderFloat("Fog falloff", &fogFalloff, 0.f, 100.f);
-		setFogFalloff(fogFalloff);
-
-		// Fog color
-		ImVec4 fogColor = getFogColor().toIMGUI();
-		ImGui::ColorEdit3("Fog color", (float*)&fogColor);
-		setFogColor(Color::fromIMGUI(fogColor));
-
-		// Realistic fog
-		bool isRealFog = getIsRealFog();
-		imgui_exp::ToggleButton("Realistic fog", &isRealFog);
-		setIsRealFog(isRealFog);
-	}
-
 	// Create terrain color header
 	if (ImGui::CollapsingHeader("Colors", ImGuiTreeNodeFlags_DefaultOpen))
 	{
@@ -329,59 +398,15 @@ void Terrain::buildGUI()
 	ImGui::End();
 }
 
-void Terrain::generateTerrainData()
+// Generates triangle indices of the block with (resolution - 1)^2 cells (each cell is made out of 2 triangles)
+template<typename T>
+static std::vector<T> generateBlockIndices(size_t resolution)
 {
-	size_t resolution = getResolution();
-	float scale = getScale();
-
-	// ================================================
-	// Vertices and triangles generation
-	// ================================================
-
-	// Calculate number of vertices
-	size_t numberOfVertices = resolution * resolution;
-	// Each vertex has a position (vec3), normal (vec3) and a texture coordinate (vec2)
-	size_t vertexBufferSize = numberOfVertices * 3 + numberOfVertices * 3 + numberOfVertices * 2;
-	float* vertexBufferData = new float[vertexBufferSize];
-
-	// Generate vertices for the terrain
-	for (int i = 0; i < resolution; ++i) {
-		for (int j = 0; j < resolution; ++j) {
-			// Prepare index information (2D array projected to 1D array with offset of number of data per vertex (8))
-			size_t index = (i + resolution * j) * 8;
-
-			// Calculate position for the vertex
-			vertexBufferData[index + 0] = j * (float)scale / (resolution - 1) - scale / 2.f;	// position.x
-			vertexBufferData[index + 1] = 0.f;	// position.y
-			vertexBufferData[index + 2] = -i * (float)scale / (resolution - 1) + scale / 2.f;	// position.z
-
-			// Calculate normals for the vertex
-			vertexBufferData[index + 3] = 0.f;	// normal.x
-			vertexBufferData[index + 4] = 1.f;	// normal.y
-			vertexBufferData[index + 5] = 0.f;	// normal.z
-
-			// Calculate texture coordinates for the vertex
-			vertexBufferData[index + 6] = (float)j / (resolution - 1);	// texcoord.x
-			vertexBufferData[index + 7] = (float)(resolution - i - 1) / (resolution - 1);	// texcoord.y
-		}
-	}
-
-	// Calculate number of triangles
-	size_t numberOfTriangles = (resolution - 1) * (resolution - 1) * 2;
-	size_t trianglesPerRow = 2 * (resolution - 1);
-	// Each triangle has 3 vertices
-	size_t triangleBufferSize = numberOfTriangles * 3;
-	unsigned int* triangleBufferData = new unsigned int[triangleBufferSize];
-
-	// Generate triangles for the terrain
-	for (int i = 0; i < numberOfTriangles; ++i) {
-		for (int j = 0; j < trianglesPerRow; ++j) {
-			// Prepare index information (offset of number of data per triangle (3))
-			int index = i * 3;
-			// Calculate row and column indices
-			size_t row = i / trianglesPerRow;
-			size_t col = (i % trianglesPerRow) / 2;
+	std::vector<T> indices;
+	indices.reserve((resolution - 1) * (resolution - 1) * 2 * 3);
 
+	for (size_t row = 0; row < resolution - 1; ++row) {
+		for (size_t col = 0; col < resolution - 1; ++col) {
 			// ###########################
 			//   top_left     top_right
 			//    (0, 1)       (1, 1)
@@ -395,19 +420,41 @@ void Terrain::generateTerrainData()
 			//    (0, 0)       (1, 0)
 			// bottom_left  bottom_right
 			// ##########################
+			T bottomLeft = static_cast<T>(row * resolution + col);
+			T topLeft = static_cast<T>(row * resolution + (col + 1));
+			T bottomRight = static_cast<T>((row + 1) * resolution + col);
+			T topRight = static_cast<T>((row + 1) * resolution + (col + 1));
+
+			// Bottom triangle (ccw)
+			indices.push_back(bottomLeft);
+			indices.push_back(bottomRight);
+			indices.push_back(topLeft);
+
+			// Top triangle (ccw)
+			indices.push_back(topLeft);
+			indices.push_back(bottomRight);
+			indices.push_back(topRight);
+		}
+	}
 
-			// Calculate top triangle (ccw)
-			if (i % 2 == 0) {
-				triangleBufferData[index + 0] = static_cast<unsigned int>(row * resolution + (col + 1));	// (0, 1) - top_left
-				triangleBufferData[index + 1] = static_cast<unsigned int>((row + 1) * resolution + col);	// (1, 0) - bottom_right
-				triangleBufferData[index + 2] = static_cast<unsigned int>((row + 1) * resolution + (col + 1));	// (1, 1) - top_right
-			}
-			// Calculate bottom triangle (ccw)
-			else {
-				triangleBufferData[index + 0] = static_cast<unsigned int>(row * resolution + col);	// (0, 0) - bottom_left
-				triangleBufferData[index + 1] = static_cast<unsigned int>((row + 1) * resolution + col);	// (1, 0) - bottom_right
-				triangleBufferData[index + 2] = static_cast<unsigned int>(row * resolution + (col + 1));	// (0, 1) - top_left
-			}
+	return indices;
+}
+
+void Terrain::generateTerrainData()
+{
+	size_t resolution = getResolution();
+
+	// ================================================
+	// Vertices and triangles generation
+	// ================================================
+
+	// Each vertex only stores its grid coordinate (position, normal and texture coordinate are reconstructed in terrain.vert)
+	// NOTE: Vertex (i, j) is stored at i + resolution * j, where j goes along the x axis and i along the z axis
+	std::vector<glm::u16vec2> vertexBufferData;
+	vertexBufferData.reserve(resolution * resolution);
+	for (size_t j = 0; j < resolution; ++j) {
+		for (size_t i = 0; i < resolution; ++i) {
+			vertexBufferData.push_back(glm::u16vec2(j, i));
 		}
 	}
 
@@ -416,105 +463,247 @@ void Terrain::generateTerrainData()
 
 	// Bind VBO
 	glBindBuffer(GL_ARRAY_BUFFER, terrainVBO);
-	glBufferData(GL_ARRAY_BUFFER, vertexBufferSize * sizeof(float), vertexBufferData, GL_STATIC_DRAW);
+	glBufferData(GL_ARRAY_BUFFER, vertexBufferData.size() * sizeof(glm::u16vec2), &vertexBufferData[0], GL_STATIC_DRAW);
 
-	// Bind EBO
+	// Bind EBO (16-bit indices are used whenever all the vertices can be addressed with them)
 	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, terrainEBO);
-	glBufferData(GL_ELEMENT_ARRAY_BUFFER, triangleBufferSize * sizeof(unsigned int), triangleBufferData, GL_STATIC_DRAW);
+	if (vertexBufferData.size() <= std::numeric_limits<GLushort>::max() + 1) {
+		std::vector<GLushort> triangleBufferData = generateBlockIndices<GLushort>(resolution);
+		glBufferData(GL_ELEMENT_ARRAY_BUFFER, triangleBufferData.size() * sizeof(GLushort), &triangleBufferData[0], GL_STATIC_DRAW);
+		indexType = GL_UNSIGNED_SHORT;
+	}
+	else {
+		std::vector<GLuint> triangleBufferData = generateBlockIndices<GLuint>(resolution);
+		glBufferData(GL_ELEMENT_ARRAY_BUFFER, triangleBufferData.size() * sizeof(GLuint), &triangleBufferData[0], GL_STATIC_DRAW);
+		indexType = GL_UNSIGNED_INT;
+	}
 
 	// Set data organization
-	glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void*)0);
+	glVertexAttribPointer(0, 2, GL_UNSIGNED_SHORT, GL_FALSE, sizeof(glm::u16vec2), (void*)0);
 	glEnableVertexAttribArray(0);
-	glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void*)(3 * sizeof(float)));
-	glEnableVertexAttribArray(1);
-	glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void*)(6 * sizeof(float)));
-	glEnableVertexAttribArray(2);
 
 	// Unbind to default buffer
 	glBindVertexArray(0);
 
-	// Delete buffers data
-	delete[] vertexBufferData;
-	delete[] triangleBufferData;
+	// Block mesh changed (also its size), so the clipmap has to be rebuilt
+	updateClipmap(true);
+}
 
-	// ================================================
-	// Initial grid and position generation
-	// ================================================
+void Terrain::generateClipmapBuffers()
+{
+	// Finest level is made out of 6x6 blocks, every coarser level adds 27 blocks around it (the finer level covers 3x3 of them)
+	size_t numberOfBlocks = CLIPMAP_LEVEL_BLOCKS * CLIPMAP_LEVEL_BLOCKS + (CLIPMAP_LEVEL_BLOCKS * CLIPMAP_LEVEL_BLOCKS - 9) * (getClipmapLevels() - 1);
+	blockBufferData.resize(numberOfBlocks);
+	blockHeightData.resize(numberOfBlocks);
+	levelCenters.resize(getClipmapLevels());
+	levelBounds.resize(getClipmapLevels());
+
+	// Allocate block buffer (filled every time the clipmap moves)
+	glBindBuffer(GL_ARRAY_BUFFER, blockBuffer);
+	glBufferData(GL_ARRAY_BUFFER, numberOfBlocks * sizeof(glm::vec4), NULL, GL_DYNAMIC_DRAW);
+
+	// Allocate block height buffer (used only for culling)
+	glBindBuffer(GL_ARRAY_BUFFER, blockHeightBuffer);
+	glBufferData(GL_ARRAY_BUFFER, numberOfBlocks * sizeof(glm::vec2), NULL, GL_DYNAMIC_DRAW);
+
+	// Allocate visible block buffer (filled by the culling shader every frame)
+	glBindBuffer(GL_ARRAY_BUFFER, visibleBlockBuffer);
+	glBufferData(GL_ARRAY_BUFFER, numberOfBlocks * sizeof(glm::vec4), NULL, GL_DYNAMIC_COPY);
+
+	// Bind VAO for location 1 (offset, size and level of the visible block)
+	glBindVertexArray(terrainVAO);
+	glEnableVertexAttribArray(1);
+	glVertexAttribPointer(1, 4, GL_FLOAT, GL_FALSE, sizeof(glm::vec4), (void*)0);
+	glVertexAttribDivisor(1, 1);
 
-	// Generate tile grid
-	glm::vec2 I = glm::vec2(scale, 0);
-	glm::vec2 J = glm::vec2(0, scale);
-	for (int i = 0; i < data->tileSize; ++i) {
-		for (int j = 0; j < data->tileSize; ++j) {
-			positionBufferData[j + i * data->tileSize] = (j - data->tileSize / 2.f) * I + (i - data->tileSize / 2.f) * J;
+	// Unbind to default buffer
+	glBindVertexArray(0);
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+void Terrain::updateClipmap(bool force)
+{
+	// Check whether any of the levels has moved
+	bool hasMoved = force;
+	std::vector<glm::vec2> centers = calculateLevelCenters(window->getCamera()->getPosition());
+	if (centers != levelCenters) {
+		levelCenters = centers;
+		hasMoved = true;
+	}
+
+	// Blocks are uploaded only when the clipmap has moved
+	if (!hasMoved)
+		return;
+
+	size_t index = 0;
+	for (size_t level = 0; level < levelCenters.size(); ++level) {
+		float blockSize = getScale() * static_cast<float>(1 << level);
+		glm::vec2 center = levelCenters[level];
+
+		// Level covers 6x6 of its blocks
+		float halfExtent = 0.5f * static_cast<float>(CLIPMAP_LEVEL_BLOCKS) * blockSize;
+		levelBounds[level] = glm::vec4(center - halfExtent, center + halfExtent);
+
+		for (int i = 0; i < CLIPMAP_LEVEL_BLOCKS; ++i) {
+			for (int j = 0; j < CLIPMAP_LEVEL_BLOCKS; ++j) {
+				glm::vec2 blockCenter = center - halfExtent + (glm::vec2(static_cast<float>(j), static_cast<float>(i)) + 0.5f) * blockSize;
+
+				// Skip the blocks which are covered by the finer level (its region is exactly 3x3 of these blocks)
+				if (level > 0) {
+					glm::vec4 finerBounds = levelBounds[level - 1];
+					if (blockCenter.x > finerBounds.x && blockCenter.x < finerBounds.z && blockCenter.y > finerBounds.y && blockCenter.y < finerBounds.w)
+						continue;
+				}
+
+				// Fit the height bounds of the block to the terrain
+				blockHeightData[index] = heightField->getHeightRange(blockCenter - 0.5f * blockSize, blockCenter + 0.5f * blockSize);
+				blockBufferData[index++] = glm::vec4(blockCenter, blockSize, static_cast<float>(level));
+			}
 		}
 	}
 
-	// Update position data with new positions
-	updatePositionData();
+	// Upload the blocks
+	glBindBuffer(GL_ARRAY_BUFFER, blockBuffer);
+	glBufferSubData(GL_ARRAY_BUFFER, 0, blockBufferData.size() * sizeof(glm::vec4), &blockBufferData[0]);
+	glBindBuffer(GL_ARRAY_BUFFER, blockHeightBuffer);
+	glBufferSubData(GL_ARRAY_BUFFER, 0, blockHeightData.size() * sizeof(glm::vec2), &blockHeightData[0]);
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
 }
 
-void Terrain::updatePositionData()
+void Terrain::cullBlocks()
 {
-	// Calculate current tile (based on the camera position)
-	glm::vec2 currentTile = calculateCurrentCameraTile();
+	Camera* camera = window->getCamera();
 
-	// Recalculate grid position data based on current tile (results in infinite terrain)
-	glm::vec2 center = positionBufferData[static_cast<unsigned int>(data->tileSize / 2.f + (data->tileSize / 2.f) * data->tileSize)];
-	for (glm::vec2& position : positionBufferData) {
-		position += currentTile - center;
+	// Read back statistics of the copied culling pass (only if its copy has already finished, so there is no stall)
+	// NOTE: Draw command buffer itself is rewritten every frame, reading it would wait for the latest culling pass
+	if (cullingFence != nullptr) {
+		GLenum status = glClientWaitSync(cullingFence, 0, 0);
+		if (status == GL_ALREADY_SIGNALED || status == GL_CONDITION_SATISFIED) {
+			GLuint counters[6];
+			glBindBuffer(GL_COPY_READ_BUFFER, statisticsBuffer);
+			glGetBufferSubData(GL_COPY_READ_BUFFER, 0, sizeof(counters), counters);
+			glBindBuffer(GL_COPY_READ_BUFFER, 0);
+			visibleBlocks = counters[1];
+			culledBlocks = counters[5];
+			glDeleteSync(cullingFence);
+			cullingFence = nullptr;
+		}
 	}
 
-	// Bind position buffer and forward its data
-	glBindBuffer(GL_ARRAY_BUFFER, positionBuffer);
-	glBufferData(GL_ARRAY_BUFFER, positionBufferData.size() * sizeof(glm::vec2), &positionBufferData[0], GL_STATIC_DRAW);
-
-	// Bind VAO for location 3 (position)
-	glBindVertexArray(terrainVAO);
-	glEnableVertexAttribArray(3);
-	glVertexAttribPointer(3, 2, GL_FLOAT, GL_FALSE, sizeof(glm::vec2), (void*)0);
-	glVertexAttribDivisor(3, 1);
-
-	// Unbind to default buffer
-	glBindVertexArray(0);
+	// Reset the draw command (count, instanceCount, firstIndex, baseVertex, baseInstance, culledCount)
+	size_t resolution = getResolution();
+	GLuint command[6] = { static_cast<GLuint>((resolution - 1) * (resolution - 1) * 2 * 3), 0, 0, 0, 0, 0 };
+	glBindBuffer(GL_DRAW_INDIRECT_BUFFER, drawCommandBuffer);
+	glBufferSubData(GL_DRAW_INDIRECT_BUFFER, 0, sizeof(command), command);
+	glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+
+	// Configure culling shader
+	cullingShader->use();
+	cullingShader->setInt("numberOfBlocks", static_cast<int>(blockBufferData.size()));
+	cullingShader->setVec3("cameraPosition", camera->getPosition());
+
+	// Set culling bounds (disabled culling accepts every block)
+	std::array<glm::vec4, 6> frustumPlanes = calculateFrustumPlanes();
+	for (size_t i = 0; i < frustumPlanes.size(); ++i) {
+		cullingShader->setVec4("frustumPlanes[" + std::to_string(i) + "]", frustumPlanes[i]);
+	}
+	cullingShader->setFloat("maxDistance", data->culling ? calculateMaxDistance() : std::numeric_limits<float>::max());
+
+	// Bind buffers
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, blockBuffer);
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 1, visibleBlockBuffer);
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 2, drawCommandBuffer);
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 3, blockHeightBuffer);
+
+	// Cull the blocks
+	glDispatchCompute(INT_CEIL(blockBufferData.size(), 64), 1, 1);
+
+	// Wait for the culling results before they are used as instance data and draw command
+	glMemoryBarrier(GL_COMMAND_BARRIER_BIT | GL_VERTEX_ATTRIB_ARRAY_BARRIER_BIT | GL_BUFFER_UPDATE_BARRIER_BIT);
+
+	// Copy the counters for statistics and track when the copy will be available (one copy is in flight at most)
+	if (cullingFence == nullptr) {
+		glBindBuffer(GL_COPY_READ_BUFFER, drawCommandBuffer);
+		glBindBuffer(GL_COPY_WRITE_BUFFER, statisticsBuffer);
+		glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, 0, 0, 6 * sizeof(GLuint));
+		glBindBuffer(GL_COPY_READ_BUFFER, 0);
+		glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+		cullingFence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+	}
 }
 
-glm::vec2 Terrain::calculateCurrentCameraTile()
+void Terrain::prefetchHeightmap()
 {
-	// Get camera
-	Camera* camera = window->getCamera();
-	glm::vec3 cameraPosition = camera->getPosition();
-
-	// Prepare final result
-	glm::vec2 cameraTile = glm::vec2(0.f);
+	// Estimate camera velocity from its movement since the last frame
+	glm::vec3 cameraPosition = window->getCamera()->getPosition();
+	float deltaTime = window->getDeltaTime();
+	glm::vec3 velocity = deltaTime > 0.f ? (cameraPosition - lastCameraPosition) / deltaTime : glm::vec3(0.f);
+	lastCameraPosition = cameraPosition;
+
+	// Predict the clipmaps along the way (nearest first)
+	std::vector<std::vector<glm::vec2>> predictedCenters(TERRAIN_PREFETCH_STEPS, std::vector<glm::vec2>(levelCenters.size()));
+	for (size_t step = 0; step < TERRAIN_PREFETCH_STEPS; ++step) {
+		float time = TERRAIN_PREFETCH_TIME * static_cast<float>(step + 1) / static_cast<float>(TERRAIN_PREFETCH_STEPS);
+		predictedCenters[step] = calculateLevelCenters(cameraPosition + velocity * time);
+	}
 
-	// Iterate over every position
-	for (glm::vec2 position : positionBufferData) {
+	// Request the pages only when the prediction has changed (requests are ordered, so they are not repeated every frame)
+	if (predictedCenters == lastPredictedCenters)
+		return;
+	lastPredictedCenters = predictedCenters;
+	heightmap->prefetch(predictedCenters);
+}
 
-		// Set initial values as false
-		bool inX = false;	// true if camera's x position corresponds to this tile's x position
-		bool inY = false;	// true if camera's y position corresponds to this tile's y position
+std::vector<glm::vec2> Terrain::calculateLevelCenters(glm::vec3 position) const
+{
+	// NOTE: When projecting 3D to 2D: x[3D] represents x[2D], whilst z[3D] represents y[2D]
+	glm::vec2 point(position.x, position.z);
+	std::vector<glm::vec2> centers(getClipmapLevels());
+
+	// Coarsest level snaps to the multiples of its doubled block size (point is at most one block away from its center)
+	size_t coarsest = centers.size() - 1;
+	float step = 2.f * getScale() * static_cast<float>(1 << coarsest);
+	centers[coarsest] = glm::round(point / step) * step;
+
+	// Finer levels are placed relative to the coarser ones (not snapped on their own), so every finer level covers
+	// 3x3 blocks of the coarser level which are at least one block away from its border
+	// NOTE: Finer center is half of the coarser block towards the point, which keeps the point at most one block away from it
+	for (size_t level = coarsest; level > 0; --level) {
+		float halfBlock = 0.5f * getScale() * static_cast<float>(1 << level);
+		glm::vec2 direction(point.x >= centers[level].x ? 1.f : -1.f, point.y >= centers[level].y ? 1.f : -1.f);
+		centers[level - 1] = centers[level] + direction * halfBlock;
+	}
+	return centers;
+}
 
-		// Check for camera's x position
-		if (cameraPosition.x <= position.x + data->scale &&
-			cameraPosition.x >= position.x - data->scale) {
-			inX = true;
-		}
+std::array<glm::vec4, 6> Terrain::calculateFrustumPlanes() const
+{
+	// Disabled culling uses planes which are always passing (w is positive infinity)
+	if (!data->culling) {
+		std::array<glm::vec4, 6> planes;
+		planes.fill(glm::vec4(0.f, 0.f, 0.f, std::numeric_limits<float>::max()));
+		return planes;
+	}
 
-		// Check for camera's y position
-		// NOTE: When projecting 3D to 2D: x[3D] represents x[2D], whilst z[3D] represents y[2D]
-		if (cameraPosition.z <= position.y + data->scale &&
-			cameraPosition.z >= position.y - data->scale) {
-			inY = true;
-		}
+	Camera* camera = window->getCamera();
+	return util::extractFrustumPlanes(window->getProjectionMatrix() * camera->getViewMatrix());
+}
 
-		// If camera's x and y coordinates correspond to this tile then quit the search, we have found our tile!
-		if (inX && inY) {
-			cameraTile = position;
-			break;
-		}
+float Terrain::calculateMaxHeight() const
+{
+	// Interpolated noise is in range [0.0, 1.0], so the highest fBm is the sum of all the amplitudes
+	const TerrainNoise& noise = data->terrainNoise;
+	float amplitude = noise.amplitude;
+	float sum = 0.f;
+	for (int i = 0; i < noise.octaves; ++i) {
+		sum += amplitude;
+		amplitude *= noise.gain;
 	}
+	return glm::pow(sum, noise.power);
+}
 
-	// Return final result
-	return cameraTile;
+float Terrain::calculateMaxDistance() const
+{
+	// Aerial perspective (terrain.frag) completely covers the terrain at the end of its volume
+	return AERIAL_PERSPECTIVE_DISTANCE;
 }
@@ -4,9 +4,23 @@
 #include "../Engine/SceneObject.h"
 #include "../Engine/Color.h"
 
+#include <array>
+
+// maximum number of the clipmap levels (has to match terrain.tesc)
+#define MAX_CLIPMAP_LEVELS 16
+// number of blocks on the one side of the clipmap level (has to match terrain.tese and terrain.frag)
+// NOTE: Finer level covers 3x3 blocks of the coarser one, so there is always at least one ring of the coarser blocks around it
+#define CLIPMAP_LEVEL_BLOCKS 6
+// how far ahead (in seconds) heightmap pages are streamed in and in how many steps the camera path is sampled
+#define TERRAIN_PREFETCH_TIME 1.f
+#define TERRAIN_PREFETCH_STEPS 4
+
 class Shader;
 class Texture;
+class Sampler;
 class PBRMaterial;
+class TerrainHeightmap;
+class TerrainHeightField;
 
 struct TerrainNoise {
 	float amplitude;
@@ -18,6 +32,12 @@ struct TerrainNoise {
 	float power;
 
 	float frequencyMultiplier;
+
+	inline bool operator==(const TerrainNoise& other) const {
+		return amplitude == other.amplitude && frequency == other.frequency && octaves == other.octaves && lacunarity == other.lacunarity &&
+			gain == other.gain && seed == other.seed && power == other.power && frequencyMultiplier == other.frequencyMultiplier;
+	}
+	inline bool operator!=(const TerrainNoise& other) const { return !(*this == other); }
 };
 
 struct TerrainData {
@@ -25,16 +45,20 @@ struct TerrainData {
 	// TERRAIN SHAPE
 	// =============================================
 	
-	// number of subdivisions used in base plane
+	// number of subdivisions used in base plane (one clipmap block)
 	size_t subdivision;
-	// scale of the base plane
+	// scale of the base plane (size of one block in the finest clipmap level)
 	float scale;
 	// terrain noise parameters
 	TerrainNoise terrainNoise;
 	// flag for showing terrain in wireframe mode
 	bool wireframe;
-	// size of one tile (base plane)
-	size_t tileSize;
+	// number of nested clipmap levels (rings) around the camera, every level doubles the block size
+	size_t clipmapLevels;
+	// flag for culling the blocks (and patches) that are outside of the frustum or hidden by the aerial perspective
+	bool culling;
+	// target size of one tessellated edge on the screen (in pixels)
+	float pixelsPerEdge;
 
 	// =============================================
 	// TERRAIN COLOR
@@ -56,17 +80,6 @@ struct TerrainData {
 	float rockScale;
 	// scale of the snow textures loading
 	float snowScale;
-
-	// =============================================
-	// POST PROCESSING
-	// =============================================
-
-	// amount of fog that will cover the terrain
-	float fogFalloff;
-	// color of the fog
-	Color fogColor;
-	// flag that determines whether the part of day will inflict color of the fog
-	bool isRealFog;
 };
 
 class Terrain : public SceneObject, public GUIBuilder {
@@ -80,10 +93,14 @@ public:
 
 	// GETTERS
 
+	inline TerrainHeightField* getHeightField() const { return heightField; }
 	inline size_t getSubdivisions() const { return data->subdivision; }
 	inline size_t getResolution() const { return data->subdivision * 2; }
 	inline float getScale() const { return data->scale; }
+	inline size_t getClipmapLevels() const { return data->clipmapLevels; }
 	inline bool getWireframe() const { return data->wireframe; }
+	inline bool getCulling() const { return data->culling; }
+	inline float getPixelsPerEdge() const { return data->pixelsPerEdge; }
 	inline float getGrassCoverage() const { return data->grassCoverage; }
 	inline float getSnowCoverage() const { return data->snowCoverage; }
 	inline Color getGrassColor() const { return data->grassColor; }
@@ -92,15 +109,15 @@ public:
 	inline float getGrassScale() const { return data->grassScale; }
 	inline float getRockScale() const { return data->rockScale; }
 	inline float getSnowScale() const { return data->snowScale; }
-	inline float getFogFalloff() const { return data->fogFalloff; }
-	inline Color getFogColor() const { return data->fogColor; }
-	inline bool getIsRealFog() const { return data->isRealFog; }
 
 	// SETTERS
 
 	inline void setSubdivisions(size_t _subdivision) { data->subdivision = _subdivision; }
 	inline void setScale(float _scale) { data->scale = _scale; }
+	inline void setClipmapLevels(size_t _clipmapLevels) { data->clipmapLevels = glm::clamp(_clipmapLevels, size_t(1), size_t(MAX_CLIPMAP_LEVELS)); }
 	inline void setWireframe(bool _isWireframe) { data->wireframe = _isWireframe; }
+	inline void setCulling(bool _isCulling) { data->culling = _isCulling; }
+	inline void setPixelsPerEdge(float _pixelsPerEdge) { data->pixelsPerEdge = _pixelsPerEdge; }
 	inline void setGrassCoverage(float _grassCoverage) { data->grassCoverage = _grassCoverage; }
 	inline void setSnowCoverage(float _snowCoverage) { data->snowCoverage = _snowCoverage; }
 	inline void setGrassColor(Color _grassColor) { data->grassColor = _grassColor; }
@@ -109,27 +126,52 @@ public:
 	inline void setGrassScale(float _grassScale) { data->grassScale = _grassScale; }
 	inline void setRockScale(float _rockScale) { data->rockScale = _rockScale; }
 	inline void setSnowScale(float _snowScale) { data->snowScale = _snowScale; }
-	inline void setFogFalloff(float _fogFalloff) { data->fogFalloff = _fogFalloff; }
-	inline void setFogColor(Color _fogColor) { data->fogColor = _fogColor; }
-	inline void setIsRealFog(bool _isRealFog) { data->isRealFog = _isRealFog; }
 
 private:
 	void generateTerrainData();
-	void updatePositionData();
-	glm::vec2 calculateCurrentCameraTile();
+	void generateClipmapBuffers();
+	void updateClipmap(bool force = false);
+	void cullBlocks();
+	void prefetchHeightmap();
+	std::vector<glm::vec2> calculateLevelCenters(glm::vec3 position) const;
+	std::array<glm::vec4, 6> calculateFrustumPlanes() const;
+	float calculateMaxHeight() const;
+	float calculateMaxDistance() const;
 
 	unsigned int terrainVAO, terrainVBO, terrainEBO;
-	unsigned int positionBuffer;
-
-	std::vector<glm::vec2> positionBufferData;
+	GLenum indexType = GL_UNSIGNED_INT;
+	unsigned int blockBuffer;
+	unsigned int blockHeightBuffer;
+	unsigned int visibleBlockBuffer;
+	unsigned int drawCommandBuffer;
+	unsigned int statisticsBuffer;
+
+	// culling statistics (copied from the draw command and read back once the copy has finished)
+	GLsync cullingFence = nullptr;
+	unsigned int visibleBlocks = 0;
+	unsigned int culledBlocks = 0;
+
+	// clipmap blocks (offset.x, offset.y, scale, level) and the data they were built from
+	std::vector<glm::vec4> blockBufferData;
+	std::vector<glm::vec2> blockHeightData;
+	std::vector<glm::vec2> levelCenters;
+	std::vector<glm::vec4> levelBounds;
+
+	// camera movement (its velocity predicts the clipmaps whose heightmap pages are streamed ahead)
+	glm::vec3 lastCameraPosition = glm::vec3(0.f);
+	std::vector<std::vector<glm::vec2>> lastPredictedCenters;
 
 	TerrainData* data = nullptr;
 
 	Shader* shader = nullptr;
+	Shader* cullingShader = nullptr;
+
+	PBRMaterial* materials = nullptr;
+	// materials are tiled at grazing angles (they are sampled anisotropically)
+	Sampler* materialSampler = nullptr;
 
-	PBRMaterial* grassMaterial = nullptr;
-	PBRMaterial* rockMaterial = nullptr;
-	PBRMaterial* snowMaterial = nullptr;
+	TerrainHeightmap* heightmap = nullptr;
+	TerrainHeightField* heightField = nullptr;
 };
 
 #endif // !TERRAIN_H
@@ -0,0 +1,249 @@
+#include "TerrainHeightField.h"
+
+#include <cmath>
+#include <cstring>
+
+// SSE2 is available on every x64 CPU (other platforms use the scalar loop only)
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define HEIGHT_FIELD_SSE2
+#include <emmintrin.h>
+#endif
+
+#ifdef HEIGHT_FIELD_SSE2
+// Multiplies 4 unsigned integers keeping the low 32 bits (wraps the same way as the scalar multiplication)
+static inline __m128i multiplyLow(__m128i a, __m128i b)
+{
+	__m128i even = _mm_mul_epu32(a, b);
+	__m128i odd = _mm_mul_epu32(_mm_srli_epi64(a, 32), _mm_srli_epi64(b, 32));
+	return _mm_unpacklo_epi32(_mm_shuffle_epi32(even, _MM_SHUFFLE(0, 0, 2, 0)), _mm_shuffle_epi32(odd, _MM_SHUFFLE(0, 0, 2, 0)));
+}
+
+// Converts 4 unsigned integers to floats (both halves convert exactly, so the sum rounds the same way as the scalar cast)
+static inline __m128 unsignedToFloat(__m128i value)
+{
+	__m128 high = _mm_mul_ps(_mm_cvtepi32_ps(_mm_srli_epi32(value, 16)), _mm_set1_ps(65536.f));
+	__m128 low = _mm_cvtepi32_ps(_mm_and_si128(value, _mm_set1_epi32(0xFFFF)));
+	return _mm_add_ps(high, low);
+}
+#endif
+
+// Calculates the cache slot of the position (hash of its exact bits)
+static size_t cacheSlot(float x, float z)
+{
+	uint32_t bitsX, bitsZ;
+	std::memcpy(&bitsX, &x, sizeof(float));
+	std::memcpy(&bitsZ, &z, sizeof(float));
+	return static_cast<size_t>((bitsX * 73856093u) ^ (bitsZ * 19349663u)) & (HEIGHT_FIELD_CACHE_SIZE - 1);
+}
+
+TerrainHeightField::TerrainHeightField(const TerrainNoise& _noise) : noise(_noise)
+{
+	cache.resize(HEIGHT_FIELD_CACHE_SIZE, CacheEntry{ 0.f, 0.f, 0.f, false });
+}
+
+bool TerrainHeightField::setNoise(const TerrainNoise& _noise)
+{
+	if (_noise == noise)
+		return false;
+
+	// Cached heights belong to the old noise
+	noise = _noise;
+	std::fill(cache.begin(), cache.end(), CacheEntry{ 0.f, 0.f, 0.f, false });
+	return true;
+}
+
+float TerrainHeightField::getHeight(float x, float z)
+{
+	glm::vec2 position(x, z);
+	float height;
+	getHeights(&position, &height, 1);
+	return height;
+}
+
+void TerrainHeightField::getHeights(const glm::vec2* positions, float* heights, size_t count)
+{
+	missX.clear();
+	missZ.clear();
+	missIndices.clear();
+
+	// Take the cached heights, the rest is evaluated in one batch
+	for (size_t i = 0; i < count; ++i) {
+		const CacheEntry& entry = cache[cacheSlot(positions[i].x, positions[i].y)];
+		if (entry.valid && entry.x == positions[i].x && entry.z == positions[i].y) {
+			heights[i] = entry.height;
+		}
+		else {
+			missX.push_back(positions[i].x);
+			missZ.push_back(positions[i].y);
+			missIndices.push_back(i);
+		}
+	}
+
+	if (missIndices.empty())
+		return;
+
+	// Evaluate missing heights
+	missHeights.resize(missIndices.size());
+	evaluate(noise, &missX[0], &missZ[0], &missHeights[0], missIndices.size());
+
+	// Store them into the result and the cache
+	for (size_t i = 0; i < missIndices.size(); ++i) {
+		heights[missIndices[i]] = missHeights[i];
+		cache[cacheSlot(missX[i], missZ[i])] = CacheEntry{ missX[i], missZ[i], missHeights[i], true };
+	}
+}
+
+glm::vec3 TerrainHeightField::getNormal(float x, float z, float offset)
+{
+	// Same central differences as the terrain shaders
+	glm::vec2 positions[4] = { glm::vec2(x + offset, z), glm::vec2(x - offset, z), glm::vec2(x, z + offset), glm::vec2(x, z - offset) };
+	float heights[4];
+	getHeights(positions, heights, 4);
+	float dx = (heights[0] - heights[1]) / (2.f * offset);
+	float dz = (heights[2] - heights[3]) / (2.f * offset);
+	glm::vec3 X = glm::vec3(1.f, dx, 0.f);
+	glm::vec3 Z = glm::vec3(0.f, dz, 1.f);
+	return glm::normalize(glm::cross(Z, X));
+}
+
+glm::vec3 TerrainHeightField::getSurfacePoint(float x, float z)
+{
+	return glm::vec3(x, getHeight(x, z), z);
+}
+
+glm::vec2 TerrainHeightField::getHeightRange(glm::vec2 rectangleMin, glm::vec2 rectangleMax, size_t samples)
+{
+	// Sample the rectangle on the regular grid
+	rangePositions.resize(samples * samples);
+	rangeHeights.resize(samples * samples);
+	glm::vec2 spacing = (rectangleMax - rectangleMin) / static_cast<float>(samples - 1);
+	for (size_t i = 0; i < samples; ++i) {
+		for (size_t j = 0; j < samples; ++j) {
+			rangePositions[j + i * samples] = rectangleMin + glm::vec2(static_cast<float>(j), static_cast<float>(i)) * spacing;
+		}
+	}
+	getHeights(&rangePositions[0], &rangeHeights[0], rangePositions.size());
+
+	// Find sampled range
+	float minHeight = rangeHeights[0];
+	float maxHeight = rangeHeights[0];
+	for (float height : rangeHeights) {
+		minHeight = glm::min(minHeight, height);
+		maxHeight = glm::max(maxHeight, height);
+	}
+
+	// Heights between the samples can differ at most by the margin (fBm is the sum of amplitudes before the power is applied)
+	float margin = calculateNoiseMargin(glm::length(spacing) * 0.5f);
+	float minNoise = glm::max(glm::pow(minHeight, 1.f / noise.power) - margin, 0.f);
+	float maxNoise = glm::pow(maxHeight, 1.f / noise.power) + margin;
+	return glm::vec2(glm::pow(minNoise, noise.power), glm::pow(maxNoise, noise.power));
+}
+
+void TerrainHeightField::evaluate(const TerrainNoise& noise, const float* x, const float* z, float* heights, size_t count)
+{
+	// Same as noiseFBM in terrainPage.comp
+	// NOTE: Loops go over octaves first and then over all the points (structure of arrays), so 4 points are evaluated
+	//		 at once with SSE2 and the rest with the scalar loop (both do the same operations, so the results are equal)
+	const uint32_t seedX = static_cast<uint32_t>(static_cast<int>(noise.seed.x * HEIGHT_FIELD_SEED_SCALE));
+	const uint32_t seedY = static_cast<uint32_t>(static_cast<int>(noise.seed.y * HEIGHT_FIELD_SEED_SCALE));
+	const uint32_t UI0 = 1597334673u;
+	const uint32_t UI1 = 3812015801u;
+	const float UIF = 1.f / static_cast<float>(0xffffffffu);
+
+	for (size_t i = 0; i < count; ++i)
+		heights[i] = 0.f;
+
+	float frequency = noise.frequency * noise.frequencyMultiplier;
+	float amplitude = noise.amplitude;
+	for (int octave = 0; octave < noise.octaves; ++octave) {
+		size_t i = 0;
+#ifdef HEIGHT_FIELD_SSE2
+		const __m128 frequency4 = _mm_set1_ps(frequency);
+		const __m128 amplitude4 = _mm_set1_ps(amplitude);
+		const __m128i seedX4 = _mm_set1_epi32(static_cast<int>(seedX));
+		const __m128i seedY4 = _mm_set1_epi32(static_cast<int>(seedY));
+		const __m128i UI04 = _mm_set1_epi32(static_cast<int>(UI0));
+		const __m128i UI14 = _mm_set1_epi32(static_cast<int>(UI1));
+		const __m128 UIF4 = _mm_set1_ps(UIF);
+		for (; i + 4 <= count; i += 4) {
+			// Grid (floor is the truncation moved down for the negative coordinates)
+			__m128 coordX = _mm_mul_ps(_mm_loadu_ps(x + i), frequency4);
+			__m128 coordY = _mm_mul_ps(_mm_loadu_ps(z + i), frequency4);
+			__m128i cellX = _mm_cvttps_epi32(coordX);
+			__m128i cellY = _mm_cvttps_epi32(coordY);
+			cellX = _mm_add_epi32(cellX, _mm_castps_si128(_mm_cmpgt_ps(_mm_cvtepi32_ps(cellX), coordX)));
+			cellY = _mm_add_epi32(cellY, _mm_castps_si128(_mm_cmpgt_ps(_mm_cvtepi32_ps(cellY), coordY)));
+			__m128 wx = _mm_sub_ps(coordX, _mm_cvtepi32_ps(cellX));
+			__m128 wy = _mm_sub_ps(coordY, _mm_cvtepi32_ps(cellY));
+
+			// Quintic interpolant
+			__m128 ux = _mm_mul_ps(_mm_mul_ps(_mm_mul_ps(wx, wx), wx), _mm_add_ps(_mm_mul_ps(wx, _mm_sub_ps(_mm_mul_ps(wx, _mm_set1_ps(6.f)), _mm_set1_ps(15.f))), _mm_set1_ps(10.f)));
+			__m128 uy = _mm_mul_ps(_mm_mul_ps(_mm_mul_ps(wy, wy), wy), _mm_add_ps(_mm_mul_ps(wy, _mm_sub_ps(_mm_mul_ps(wy, _mm_set1_ps(6.f)), _mm_set1_ps(15.f))), _mm_set1_ps(10.f)));
+
+			// Gradients (rand)
+			__m128i qx0 = multiplyLow(_mm_add_epi32(cellX, seedX4), UI04);
+			__m128i qx1 = _mm_add_epi32(qx0, UI04);
+			__m128i qy0 = multiplyLow(_mm_add_epi32(cellY, seedY4), UI14);
+			__m128i qy1 = _mm_add_epi32(qy0, UI14);
+			__m128 ga = _mm_mul_ps(unsignedToFloat(multiplyLow(_mm_xor_si128(qx0, qy0), UI04)), UIF4);
+			__m128 gb = _mm_mul_ps(unsignedToFloat(multiplyLow(_mm_xor_si128(qx1, qy0), UI04)), UIF4);
+			__m128 gc = _mm_mul_ps(unsignedToFloat(multiplyLow(_mm_xor_si128(qx0, qy1), UI04)), UIF4);
+			__m128 gd = _mm_mul_ps(unsignedToFloat(multiplyLow(_mm_xor_si128(qx1, qy1), UI04)), UIF4);
+
+			// Interpolation (same order of the operations as the scalar loop)
+			__m128 value = _mm_add_ps(ga, _mm_mul_ps(ux, _mm_sub_ps(gb, ga)));
+			value = _mm_add_ps(value, _mm_mul_ps(uy, _mm_sub_ps(gc, ga)));
+			value = _mm_add_ps(value, _mm_mul_ps(_mm_mul_ps(ux, uy), _mm_add_ps(_mm_sub_ps(_mm_sub_ps(gd, gc), gb), ga)));
+			_mm_storeu_ps(heights + i, _mm_add_ps(_mm_loadu_ps(heights + i), _mm_mul_ps(amplitude4, value)));
+		}
+#endif
+		for (; i < count; ++i) {
+			// Grid
+			float coordX = x[i] * frequency;
+			float coordY = z[i] * frequency;
+			float px = std::floor(coordX);
+			float py = std::floor(coordY);
+			float wx = coordX - px;
+			float wy = coordY - py;
+
+			// Quintic interpolant
+			float ux = wx * wx * wx * (wx * (wx * 6.f - 15.f) + 10.f);
+			float uy = wy * wy * wy * (wy * (wy * 6.f - 15.f) + 10.f);
+
+			// Gradients (rand, unsigned overflow wraps the same way as on the GPU)
+			uint32_t qx0 = (static_cast<uint32_t>(static_cast<int>(px)) + seedX) * UI0;
+			uint32_t qx1 = qx0 + UI0;
+			uint32_t qy0 = (static_cast<uint32_t>(static_cast<int>(py)) + seedY) * UI1;
+			uint32_t qy1 = qy0 + UI1;
+			float ga = static_cast<float>((qx0 ^ qy0) * UI0) * UIF;
+			float gb = static_cast<float>((qx1 ^ qy0) * UI0) * UIF;
+			float gc = static_cast<float>((qx0 ^ qy1) * UI0) * UIF;
+			float gd = static_cast<float>((qx1 ^ qy1) * UI0) * UIF;
+
+			// Interpolation
+			heights[i] += amplitude * (ga + ux * (gb - ga) + uy * (gc - ga) + ux * uy * (gd - gc - gb + ga));
+		}
+
+		// Update properties
+		frequency *= noise.lacunarity;
+		amplitude *= noise.gain;
+	}
+
+	for (size_t i = 0; i < count; ++i)
+		heights[i] = std::pow(heights[i], noise.power);
+}
+
+float TerrainHeightField::calculateNoiseMargin(float distance) const
+{
+	// Every octave is in range [0, amplitude] and its slope is at most 15/8 * frequency * amplitude in both directions,
+	// so over the distance it can change by the smaller of these two
+	float margin = 0.f;
+	float frequency = noise.frequency * noise.frequencyMultiplier;
+	float amplitude = noise.amplitude;
+	for (int octave = 0; octave < noise.octaves; ++octave) {
+		margin += glm::min(amplitude, 1.875f * frequency * amplitude * glm::sqrt(2.f) * distance);
+		frequency *= noise.lacunarity;
+		amplitude *= noise.gain;
+	}
+	return margin;
+}
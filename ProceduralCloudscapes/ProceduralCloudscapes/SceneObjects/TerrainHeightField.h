@@ -0,0 +1,58 @@
+#ifndef TERRAIN_HEIGHT_FIELD_H
+#define TERRAIN_HEIGHT_FIELD_H
+
+#include "Terrain.h"
+
+#include <vector>
+
+// number of the cached height queries (has to be a power of 2)
+#define HEIGHT_FIELD_CACHE_SIZE 8192
+// scale of the noise seed before it is added to the hashed grid point (has to match terrainPage.comp)
+#define HEIGHT_FIELD_SEED_SCALE 4096.f
+
+// CPU version of the terrain height field
+// Evaluates exactly the same fBm as terrainPage.comp (heights the terrain is displaced with), so the camera
+// and the scene objects can be placed on the terrain and the culling bounds can be fitted to it
+// NOTE: Noise is hashed with integers, so the results match the GPU up to the floating point rounding of the interpolation
+class TerrainHeightField {
+public:
+	TerrainHeightField(const TerrainNoise& _noise);
+
+	// sets new noise parameters (returns true if they have changed and the cache was cleared)
+	bool setNoise(const TerrainNoise& _noise);
+	inline const TerrainNoise& getNoise() const { return noise; }
+
+	// terrain height at the position (x, z)
+	float getHeight(float x, float z);
+	// terrain heights at many positions (x, z) at once
+	void getHeights(const glm::vec2* positions, float* heights, size_t count);
+	// terrain normal at the position (x, z) calculated with the offset (same as the terrain shaders)
+	glm::vec3 getNormal(float x, float z, float offset = 1.f);
+	// point on the terrain surface at the position (x, z)
+	glm::vec3 getSurfacePoint(float x, float z);
+	// conservative range (min, max) of the heights inside the rectangle, sampled with samples x samples points
+	glm::vec2 getHeightRange(glm::vec2 rectangleMin, glm::vec2 rectangleMax, size_t samples = 9);
+
+	// evaluates the terrain heights of the noise at positions (x, z) without the cache (safe to call from any thread)
+	static void evaluate(const TerrainNoise& noise, const float* x, const float* z, float* heights, size_t count);
+
+private:
+	float calculateNoiseMargin(float distance) const;
+
+	struct CacheEntry {
+		float x, z;
+		float height;
+		bool valid;
+	};
+
+	TerrainNoise noise;
+	std::vector<CacheEntry> cache;
+
+	// batch query buffers (structure of arrays of the positions that were not in the cache)
+	std::vector<float> missX, missZ, missHeights;
+	std::vector<size_t> missIndices;
+	std::vector<glm::vec2> rangePositions;
+	std::vector<float> rangeHeights;
+};
+
+#endif // !TERRAIN_HEIGHT_FIELD_H
@@ -0,0 +1,428 @@
+#include "TerrainHeightmap.h"
+
+#include "TerrainHeightField.h"
+#include "../Engine/Shader.h"
+#include "../Engine/Utilities.h"
+#include "../Engine/ThreadPool.h"
+
+#include <cstring>
+
+// size of the one page in bytes (height is one float, normal is four bytes)
+static const size_t PAGE_TEXELS = HEIGHTMAP_PAGE_RESOLUTION * HEIGHTMAP_PAGE_RESOLUTION;
+static const size_t PAGE_BYTES = PAGE_TEXELS * (sizeof(float) + 4 * sizeof(unsigned char));
+
+// Packs the level and the block cell into the unique page key
+static uint64_t pageKey(size_t level, int x, int z)
+{
+	return (static_cast<uint64_t>(level) << 48) | (static_cast<uint64_t>(x & 0xFFFFFF) << 24) | static_cast<uint64_t>(z & 0xFFFFFF);
+}
+
+TerrainHeightmap::TerrainHeightmap(size_t _clipmapLevels) : clipmapLevels(_clipmapLevels)
+{
+	// Create page generation shader
+	pageShader = new Shader();
+	pageShader->attachShader("Shaders/Terrain/terrainPage.comp", ShaderInfo(ShaderType::kCompute));
+	pageShader->linkProgram();
+
+	// Generate page textures
+	glGenTextures(1, &heightTexture);
+	glGenTextures(1, &normalTexture);
+
+	// Allocate pages
+	allocatePages();
+
+	// Create staging ring and worker threads
+	allocateStagingRing();
+	workers = new ThreadPool();
+}
+
+TerrainHeightmap::~TerrainHeightmap()
+{
+	// Stop workers (before the queue they write into is gone)
+	delete workers;
+	for (StreamedPage* page : streamedQueue)
+		delete page;
+	// Delete shader
+	delete pageShader;
+	// Delete textures
+	glDeleteTextures(1, &heightTexture);
+	glDeleteTextures(1, &normalTexture);
+	// Delete staging ring
+	for (GLsync fence : stagingFences) {
+		if (fence != nullptr)
+			glDeleteSync(fence);
+	}
+	glBindBuffer(GL_PIXEL_UNPACK_BUFFER, stagingBuffer);
+	glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+	glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+	glDeleteBuffers(1, &stagingBuffer);
+}
+
+void TerrainHeightmap::update(const std::vector<glm::vec2>& levelCenters, float blockSize, const TerrainNoise& noise)
+{
+	generatedPages = 0;
+	streamedPages = 0;
+
+	// Pages depend on the block size and noise, so all of them are invalid once these change
+	if (blockSize != cachedBlockSize || noise != cachedNoise) {
+		invalidate();
+		cachedBlockSize = blockSize;
+		cachedNoise = noise;
+	}
+
+	// Take the pages the workers have finished
+	uploadStreamedPages();
+
+	// Nothing to do if the clipmap has not moved
+	if (levelCenters == cachedCenters)
+		return;
+	cachedCenters = levelCenters;
+	++frame;
+
+	// Configure page shader (same for all the pages)
+	pageShader->use();
+	pageShader->setFloat("terrainNoise.amplitude", noise.amplitude);
+	pageShader->setFloat("terrainNoise.frequency", noise.frequency * noise.frequencyMultiplier);
+	pageShader->setInt("terrainNoise.octaves", noise.octaves);
+	pageShader->setFloat("terrainNoise.lacunarity", noise.lacunarity);
+	pageShader->setFloat("terrainNoise.gain", noise.gain);
+	pageShader->setVec2("terrainNoise.seed", noise.seed);
+	pageShader->setFloat("terrainNoise.power", noise.power);
+	glBindImageTexture(0, heightTexture, 0, GL_TRUE, 0, GL_WRITE_ONLY, GL_R32F);
+	glBindImageTexture(1, normalTexture, 0, GL_TRUE, 0, GL_WRITE_ONLY, GL_RGBA8);
+
+	// Every level is made out of 6x6 blocks around its center
+	std::fill(pageTable.begin(), pageTable.end(), glm::ivec4(-1));
+	for (size_t level = 0; level < levelCenters.size(); ++level) {
+		float size = blockSize * static_cast<float>(1 << level);
+		glm::vec2 levelMin = levelCenters[level] - 0.5f * static_cast<float>(CLIPMAP_LEVEL_BLOCKS) * size;
+
+		for (int i = 0; i < CLIPMAP_LEVEL_BLOCKS; ++i) {
+			for (int j = 0; j < CLIPMAP_LEVEL_BLOCKS; ++j) {
+				// Find the page of the block (blocks are aligned to the multiples of their size)
+				glm::vec2 origin = levelMin + glm::vec2(static_cast<float>(j), static_cast<float>(i)) * size;
+				int x = static_cast<int>(glm::round(origin.x / size));
+				int z = static_cast<int>(glm::round(origin.y / size));
+				uint64_t key = pageKey(level, x, z);
+
+				// Generate the page if it is not cached (nor streamed in yet)
+				auto page = pages.find(key);
+				unsigned int layer;
+				if (page != pages.end()) {
+					layer = page->second;
+				}
+				else {
+					layer = acquirePage(key);
+					generatePage(layer, origin, size);
+					++generatedPages;
+				}
+
+				// Mark the page as used and store it into the page table (4 blocks are packed into one ivec4)
+				pageLastUse[layer] = frame;
+				size_t entry = (level * CLIPMAP_LEVEL_BLOCKS + static_cast<size_t>(i)) * CLIPMAP_LEVEL_BLOCKS + static_cast<size_t>(j);
+				pageTable[entry / 4][static_cast<glm::length_t>(entry % 4)] = static_cast<int>(layer);
+			}
+		}
+	}
+
+	// Wait for the pages before they are sampled
+	if (generatedPages > 0)
+		glMemoryBarrier(GL_TEXTURE_FETCH_BARRIER_BIT);
+}
+
+void TerrainHeightmap::prefetch(const std::vector<std::vector<glm::vec2>>& predictedCenters)
+{
+	// Requests of the older predictions which have not started yet are no longer needed, the ones which have started
+	// stay pending until they are uploaded (or dropped), so they are not requested again
+	workers->clear();
+	pendingPages.clear();
+	{
+		std::lock_guard<std::mutex> lock(streamedMutex);
+		++requestGeneration;
+		for (const auto& started : startedPages) {
+			if (started.second == version)
+				pendingPages.insert(started.first);
+		}
+	}
+
+	// Request missing pages (nearest prediction first, so they are generated first)
+	for (const std::vector<glm::vec2>& levelCenters : predictedCenters) {
+		for (size_t level = 0; level < levelCenters.size(); ++level) {
+			float size = cachedBlockSize * static_cast<float>(1 << level);
+			glm::vec2 levelMin = levelCenters[level] - 0.5f * static_cast<float>(CLIPMAP_LEVEL_BLOCKS) * size;
+
+			for (int i = 0; i < CLIPMAP_LEVEL_BLOCKS; ++i) {
+				for (int j = 0; j < CLIPMAP_LEVEL_BLOCKS; ++j) {
+					glm::vec2 origin = levelMin + glm::vec2(static_cast<float>(j), static_cast<float>(i)) * size;
+					int x = static_cast<int>(glm::round(origin.x / size));
+					int z = static_cast<int>(glm::round(origin.y / size));
+					uint64_t key = pageKey(level, x, z);
+					if (pages.find(key) == pages.end() && pendingPages.find(key) == pendingPages.end())
+						requestPage(key, origin, size);
+				}
+			}
+		}
+	}
+}
+
+void TerrainHeightmap::resize(size_t _clipmapLevels)
+{
+	clipmapLevels = _clipmapLevels;
+	allocatePages();
+}
+
+void TerrainHeightmap::setMemoryBudget(size_t _memoryBudget)
+{
+	memoryBudget = _memoryBudget;
+	allocatePages();
+}
+
+void TerrainHeightmap::invalidate()
+{
+	// Pages which are being streamed belong to the old data
+	++version;
+	if (workers != nullptr)
+		workers->clear();
+	pendingPages.clear();
+	{
+		std::lock_guard<std::mutex> lock(streamedMutex);
+		++requestGeneration;
+	}
+
+	pages.clear();
+	std::fill(pageKeys.begin(), pageKeys.end(), UINT64_MAX);
+	std::fill(pageLastUse.begin(), pageLastUse.end(), 0);
+	cachedCenters.clear();
+}
+
+void TerrainHeightmap::bind(Shader* shader, GLenum heightUnit, GLenum normalUnit) const
+{
+	// Bind page textures
+	glActiveTexture(GL_TEXTURE0 + heightUnit);
+	glBindTexture(GL_TEXTURE_2D_ARRAY, heightTexture);
+	glActiveTexture(GL_TEXTURE0 + normalUnit);
+	glBindTexture(GL_TEXTURE_2D_ARRAY, normalTexture);
+
+	// Set page table
+	shader->setIVec4Array("pageLayers", &pageTable[0], pageTable.size());
+}
+
+void TerrainHeightmap::allocatePages()
+{
+	// Every level needs 36 pages, the rest of the budget is used for the pages streamed ahead and the old ones
+	size_t capacity = glm::max(memoryBudget / PAGE_BYTES, CLIPMAP_LEVEL_BLOCKS * CLIPMAP_LEVEL_BLOCKS * clipmapLevels + HEIGHTMAP_PAGE_SLACK);
+
+	// Allocate height pages
+	glBindTexture(GL_TEXTURE_2D_ARRAY, heightTexture);
+	glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+	glTexImage3D(GL_TEXTURE_2D_ARRAY, 0, GL_R32F, HEIGHTMAP_PAGE_RESOLUTION, HEIGHTMAP_PAGE_RESOLUTION, static_cast<GLsizei>(capacity), 0, GL_RED, GL_FLOAT, NULL);
+
+	// Allocate normal pages
+	glBindTexture(GL_TEXTURE_2D_ARRAY, normalTexture);
+	glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+	glTexImage3D(GL_TEXTURE_2D_ARRAY, 0, GL_RGBA8, HEIGHTMAP_PAGE_RESOLUTION, HEIGHTMAP_PAGE_RESOLUTION, static_cast<GLsizei>(capacity), 0, GL_RGBA, GL_UNSIGNED_BYTE, NULL);
+	glBindTexture(GL_TEXTURE_2D_ARRAY, 0);
+
+	// Reset the cache (textures content is gone)
+	pageKeys.resize(capacity);
+	pageLastUse.resize(capacity);
+	pageTable.resize(MAX_CLIPMAP_LEVELS * CLIPMAP_LEVEL_BLOCKS * CLIPMAP_LEVEL_BLOCKS / 4);
+	invalidate();
+}
+
+void TerrainHeightmap::allocateStagingRing()
+{
+	// Allocate all the slots in one persistently mapped buffer (it stays mapped, so the pages are just copied into it)
+	glGenBuffers(1, &stagingBuffer);
+	glBindBuffer(GL_PIXEL_UNPACK_BUFFER, stagingBuffer);
+	GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+	glBufferStorage(GL_PIXEL_UNPACK_BUFFER, HEIGHTMAP_STAGING_SLOTS * PAGE_BYTES, NULL, flags);
+	stagingData = static_cast<unsigned char*>(glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, 0, HEIGHTMAP_STAGING_SLOTS * PAGE_BYTES, flags));
+	glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+	if (stagingData == nullptr) {
+		std::cout << "ERROR::TERRAIN_HEIGHTMAP::allocateStagingRing() Staging buffer could not be mapped!" << std::endl;
+	}
+}
+
+unsigned int TerrainHeightmap::acquirePage(uint64_t key)
+{
+	// Find the least recently used page (pages used in the current frame are never evicted)
+	unsigned int layer = findLeastRecentlyUsed();
+	if (pageLastUse[layer] == frame) {
+		std::cout << "ERROR::TERRAIN_HEIGHTMAP::acquirePage() Page cache is too small for the clipmap!" << std::endl;
+	}
+
+	// Evict its old content
+	if (pageKeys[layer] != UINT64_MAX)
+		pages.erase(pageKeys[layer]);
+
+	// Assign the page to the new key
+	pageKeys[layer] = key;
+	pages[key] = layer;
+	return layer;
+}
+
+unsigned int TerrainHeightmap::findLeastRecentlyUsed() const
+{
+	unsigned int layer = 0;
+	for (unsigned int i = 1; i < pageLastUse.size(); ++i) {
+		if (pageLastUse[i] < pageLastUse[layer])
+			layer = i;
+	}
+	return layer;
+}
+
+void TerrainHeightmap::generatePage(unsigned int layer, glm::vec2 origin, float size)
+{
+	// Set page info
+	pageShader->setVec2("pageOrigin", origin);
+	pageShader->setFloat("pageSize", size);
+	pageShader->setInt("layer", static_cast<int>(layer));
+
+	// Generate the page
+	glDispatchCompute(INT_CEIL(HEIGHTMAP_PAGE_RESOLUTION, 8), INT_CEIL(HEIGHTMAP_PAGE_RESOLUTION, 8), 1);
+}
+
+void TerrainHeightmap::requestPage(uint64_t key, glm::vec2 origin, float size)
+{
+	pendingPages.insert(key);
+
+	// Generate the page on the worker thread (with a copy of the data, the main thread can change it meanwhile)
+	size_t pageVersion = version;
+	size_t generation = requestGeneration;
+	TerrainNoise noise = cachedNoise;
+	workers->enqueue([this, key, pageVersion, generation, noise, origin, size]() {
+		// Request was dropped while the task was being taken from the queue
+		{
+			std::lock_guard<std::mutex> lock(streamedMutex);
+			if (generation != requestGeneration)
+				return;
+			startedPages[key] = pageVersion;
+		}
+
+		StreamedPage* page = new StreamedPage{ key, pageVersion, {}, {} };
+		buildPage(*page, noise, origin, size);
+		std::lock_guard<std::mutex> lock(streamedMutex);
+		streamedQueue.push_back(page);
+	});
+}
+
+void TerrainHeightmap::uploadStreamedPages()
+{
+	if (stagingData == nullptr)
+		return;
+
+	glBindBuffer(GL_PIXEL_UNPACK_BUFFER, stagingBuffer);
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+
+	while (true) {
+		// Upload only into the free slots (GPU has finished copying from them), the rest waits for the next frame
+		GLsync& fence = stagingFences[stagingSlot];
+		if (fence != nullptr) {
+			GLenum status = glClientWaitSync(fence, 0, 0);
+			if (status != GL_ALREADY_SIGNALED && status != GL_CONDITION_SATISFIED)
+				break;
+			glDeleteSync(fence);
+			fence = nullptr;
+		}
+
+		// Take the next finished page
+		StreamedPage* page = nullptr;
+		{
+			std::lock_guard<std::mutex> lock(streamedMutex);
+			if (streamedQueue.empty())
+				break;
+			page = streamedQueue.front();
+			streamedQueue.pop_front();
+			auto started = startedPages.find(page->key);
+			if (started != startedPages.end() && started->second == page->version)
+				startedPages.erase(started);
+		}
+
+		// Drop the pages of the old data and the ones that were generated meanwhile (needed before they were finished)
+		if (page->version == version)
+			pendingPages.erase(page->key);
+		if (page->version != version || pages.find(page->key) != pages.end()) {
+			delete page;
+			continue;
+		}
+
+		// Never evict the pages the clipmap is using right now (the budget is full of them)
+		unsigned int layer = findLeastRecentlyUsed();
+		if (pageLastUse[layer] == frame) {
+			delete page;
+			continue;
+		}
+		layer = acquirePage(page->key);
+		pageLastUse[layer] = frame;
+
+		// Copy the page into the staging slot
+		size_t heightOffset = stagingSlot * PAGE_BYTES;
+		size_t normalOffset = heightOffset + PAGE_TEXELS * sizeof(float);
+		std::memcpy(stagingData + heightOffset, &page->heights[0], PAGE_TEXELS * sizeof(float));
+		std::memcpy(stagingData + normalOffset, &page->normals[0], PAGE_TEXELS * 4 * sizeof(unsigned char));
+		delete page;
+
+		// Upload the page from the staging slot
+		glBindTexture(GL_TEXTURE_2D_ARRAY, heightTexture);
+		glTexSubImage3D(GL_TEXTURE_2D_ARRAY, 0, 0, 0, layer, HEIGHTMAP_PAGE_RESOLUTION, HEIGHTMAP_PAGE_RESOLUTION, 1, GL_RED, GL_FLOAT, (void*)heightOffset);
+		glBindTexture(GL_TEXTURE_2D_ARRAY, normalTexture);
+		glTexSubImage3D(GL_TEXTURE_2D_ARRAY, 0, 0, 0, layer, HEIGHTMAP_PAGE_RESOLUTION, HEIGHTMAP_PAGE_RESOLUTION, 1, GL_RGBA, GL_UNSIGNED_BYTE, (void*)normalOffset);
+		glBindTexture(GL_TEXTURE_2D_ARRAY, 0);
+
+		// Slot is free again once the GPU has copied it
+		fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+		stagingSlot = (stagingSlot + 1) % HEIGHTMAP_STAGING_SLOTS;
+		++streamedPages;
+	}
+
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+	glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+}
+
+void TerrainHeightmap::buildPage(StreamedPage& page, const TerrainNoise& noise, glm::vec2 origin, float size)
+{
+	// Same as terrainPage.comp: height and normals with the offsets 1 and 2 (central differences) for every texel
+	const float offsets[5] = { 0.f, 1.f, -1.f, 2.f, -2.f };
+	page.heights.resize(PAGE_TEXELS);
+	page.normals.resize(PAGE_TEXELS * 4);
+
+	// Evaluate one row at a time (center, x and z offsets for every texel of the row)
+	const size_t R = HEIGHTMAP_PAGE_RESOLUTION;
+	std::vector<float> x(9 * R), z(9 * R), heights(9 * R);
+	for (size_t row = 0; row < R; ++row) {
+		for (size_t column = 0; column < R; ++column) {
+			glm::vec2 position = origin + glm::vec2(static_cast<float>(column), static_cast<float>(row)) / static_cast<float>(R - 1) * size;
+			for (size_t k = 0; k < 5; ++k) {
+				x[k * R + column] = position.x + offsets[k];
+				z[k * R + column] = position.y;
+			}
+			for (size_t k = 1; k < 5; ++k) {
+				x[(4 + k) * R + column] = position.x;
+				z[(4 + k) * R + column] = position.y + offsets[k];
+			}
+		}
+		TerrainHeightField::evaluate(noise, &x[0], &z[0], &heights[0], 9 * R);
+
+		for (size_t column = 0; column < R; ++column) {
+			auto height = [&](size_t k) { return heights[k * R + column]; };
+			size_t texel = column + row * R;
+			page.heights[texel] = height(0);
+
+			// Normals (same as offsetNormal)
+			glm::vec3 normal = glm::normalize(glm::vec3(-(height(1) - height(2)) * 0.5f, 1.f, -(height(5) - height(6)) * 0.5f));
+			float snowNormalY = glm::abs(glm::normalize(glm::vec3(-(height(3) - height(4)) * 0.25f, 1.f, -(height(7) - height(8)) * 0.25f)).y);
+
+			// Pack normal from [-1, 1] into [0, 255]
+			glm::vec4 packed = glm::clamp(glm::vec4(normal * 0.5f + 0.5f, snowNormalY), 0.f, 1.f) * 255.f + 0.5f;
+			for (size_t c = 0; c < 4; ++c)
+				page.normals[texel * 4 + c] = static_cast<unsigned char>(packed[static_cast<glm::length_t>(c)]);
+		}
+	}
+}
\ No newline at end of file
@@ -0,0 +1,119 @@
+#ifndef TERRAIN_HEIGHTMAP_H
+#define TERRAIN_HEIGHTMAP_H
+
+#include "Terrain.h"
+
+#include <vector>
+#include <deque>
+#include <mutex>
+#include <unordered_map>
+#include <unordered_set>
+
+// resolution of the one page (has to match terrainPage.comp, terrain.tese and terrain.frag)
+#define HEIGHTMAP_PAGE_RESOLUTION 256
+// minimal number of pages kept in the cache on top of the ones the clipmap needs (camera moving back and forth reuses them)
+#define HEIGHTMAP_PAGE_SLACK 32
+// default GPU memory used by the page cache (in MB)
+#define HEIGHTMAP_MEMORY_BUDGET 128
+// number of pages that can be uploaded at the same time (slots of the staging ring)
+#define HEIGHTMAP_STAGING_SLOTS 4
+
+class Shader;
+class ThreadPool;
+
+// Paged virtual heightmap around the camera
+// Every clipmap block has its own page (height and normal). Normal page is also the material data of the block, its y
+// blends grass with rock and its alpha (normal of the coarser offsets) blends snow with rock. Materials themselves are
+// picked from these in terrain.frag, because their coverages are changed in the GUI without regenerating the pages.
+// Pages of the regions the camera is heading to are generated ahead of time by the worker threads and uploaded
+// through the staging ring, pages which are needed before they are streamed in are generated by compute shader.
+// Pages that are no longer needed stay cached until they are evicted (LRU) by the ones which do not fit into
+// the memory budget
+class TerrainHeightmap {
+public:
+	TerrainHeightmap(size_t _clipmapLevels);
+	~TerrainHeightmap();
+
+	// makes sure that all the pages of the clipmap are resident and updates the page table
+	void update(const std::vector<glm::vec2>& levelCenters, float blockSize, const TerrainNoise& noise);
+	// requests pages of the predicted clipmaps (ordered from the nearest) to be streamed in by the worker threads
+	void prefetch(const std::vector<std::vector<glm::vec2>>& predictedCenters);
+	// reallocates the cache for the new number of the clipmap levels
+	void resize(size_t _clipmapLevels);
+	// sets the GPU memory the page cache can use (in bytes) and reallocates it
+	void setMemoryBudget(size_t _memoryBudget);
+	// drops all the cached pages (they are regenerated with the next update)
+	void invalidate();
+	// binds page textures and sets the page table to the given shader
+	void bind(Shader* shader, GLenum heightUnit, GLenum normalUnit) const;
+
+	inline size_t getCapacity() const { return pageKeys.size(); }
+	inline size_t getResidentPages() const { return pages.size(); }
+	inline size_t getGeneratedPages() const { return generatedPages; }
+	inline size_t getStreamedPages() const { return streamedPages; }
+	inline size_t getPendingPages() const { return pendingPages.size(); }
+	inline size_t getMemoryBudget() const { return memoryBudget; }
+
+private:
+	// page generated by the worker thread (waiting to be uploaded)
+	struct StreamedPage {
+		uint64_t key;
+		size_t version;
+		std::vector<float> heights;
+		// normal (rgb) and snow blend (a)
+		std::vector<unsigned char> normals;
+	};
+
+	void allocatePages();
+	void allocateStagingRing();
+	unsigned int acquirePage(uint64_t key);
+	unsigned int findLeastRecentlyUsed() const;
+	void generatePage(unsigned int layer, glm::vec2 origin, float size);
+	void requestPage(uint64_t key, glm::vec2 origin, float size);
+	void uploadStreamedPages();
+	static void buildPage(StreamedPage& page, const TerrainNoise& noise, glm::vec2 origin, float size);
+
+	Shader* pageShader = nullptr;
+
+	// page textures (one layer per page)
+	unsigned int heightTexture = 0;
+	unsigned int normalTexture = 0;
+
+	size_t clipmapLevels;
+	size_t memoryBudget = static_cast<size_t>(HEIGHTMAP_MEMORY_BUDGET) << 20;
+
+	// worker threads, the pages they have started (key -> version) and the ones they have finished (guarded by the mutex)
+	ThreadPool* workers = nullptr;
+	std::mutex streamedMutex;
+	std::unordered_map<uint64_t, size_t> startedPages;
+	std::deque<StreamedPage*> streamedQueue;
+	// requests which were dropped before they started (tasks of the older generations do nothing)
+	size_t requestGeneration = 0;
+	// pages requested from the workers and the version of the pages (results of the older versions are dropped)
+	std::unordered_set<uint64_t> pendingPages;
+	size_t version = 0;
+	size_t streamedPages = 0;
+
+	// staging ring (persistently mapped pixel unpack buffer, every slot holds one page and is reused once its fence is signaled)
+	unsigned int stagingBuffer = 0;
+	unsigned char* stagingData = nullptr;
+	GLsync stagingFences[HEIGHTMAP_STAGING_SLOTS] = {};
+	size_t stagingSlot = 0;
+
+	// cached pages (key -> layer) and the information about every layer
+	std::unordered_map<uint64_t, unsigned int> pages;
+	std::vector<uint64_t> pageKeys;
+	std::vector<size_t> pageLastUse;
+	size_t frame = 0;
+	size_t generatedPages = 0;
+
+	// page table (layer of every block of every level, -1 if there is no page)
+	std::vector<glm::ivec4> pageTable;
+
+	// data the pages were generated with
+	std::vector<glm::vec2> cachedCenters;
+	float cachedBlockSize = 0.f;
+	TerrainNoise cachedNoise{};
+};
+
+#endif // !TERRAIN_HEIGHTMAP_H
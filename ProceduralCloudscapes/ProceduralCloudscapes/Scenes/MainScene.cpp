@@ -13,6 +13,9 @@ MainScene::MainScene(Window* _window) : Scene(_window, "Iscrtavanje volumetrijsk
 	Terrain* terrain = new Terrain(window);
 	addSceneObject(terrain);
 
+	// Draw terrain before the sky and clouds (they are shaded only where the terrain is not)
+	setRenderOrder(RenderOrder::OpaqueFirst);
+
 	// Set initial camera movement speed
 	window->getCamera()->setMovementSpeed(5000.f);
 }
@@ -20,6 +20,7 @@ RaymarchTestScene::~RaymarchTestScene()
 {
     delete shader;
     delete screenShader;
+    window->unregisterRenderTarget(framebuffer);
     delete framebuffer;
 }
 
@@ -72,9 +73,11 @@ void RaymarchTestScene::configureData()
     framebuffer = new FrameBufferObject();
     // create a color attachment texture
     framebuffer->attachColorTexture((unsigned int)window->getWidth(), (unsigned int)window->getHeight());
-    // create a renderbuffer object for depth and stencil attachment (we won't be sampling these)
-    framebuffer->attachDepthTexture((unsigned int)window->getWidth(), (unsigned int)window->getHeight());
+    // create a renderbuffer object for depth attachment (we won't be sampling it)
+    framebuffer->attachDepth((unsigned int)window->getWidth(), (unsigned int)window->getHeight(), DepthPolicy::renderbuffer);
     // now that we actually created the framebuffer and added all attachments we want to check if it is actually complete now
     if (!framebuffer->checkStatus())
         std::cout << "ERROR::FRAMEBUFFER:: Framebuffer is not complete!" << std::endl;
+    // resize the framebuffer together with the window
+    window->registerRenderTarget(framebuffer);
 }
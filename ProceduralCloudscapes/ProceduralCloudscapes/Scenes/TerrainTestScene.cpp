@@ -9,6 +9,9 @@ TerrainTestScene::TerrainTestScene(Window* _window) : Scene(_window, "Terrain Te
 	Terrain* terrain = new Terrain(window);
 	addSceneObject(terrain);
 
+	// Draw terrain before the sky (it is shaded only where the terrain is not)
+	setRenderOrder(RenderOrder::OpaqueFirst);
+
 	// Set higher movement speed for the camera
 	window->getCamera()->setMovementSpeed(5000.f);
 }
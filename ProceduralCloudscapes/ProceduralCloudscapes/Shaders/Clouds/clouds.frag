@@ -10,13 +10,22 @@ uniform mat4 inverseProjection;
 uniform mat4 inverseView;
 
 // Sun
-uniform float sunAltitude; // from range [0.0, 1.0] where 0.0 is night and 1.0 is clear day
-uniform float sunAzimuth; // from range [-1.0, 1.0] where 0.0 is in front and (-)1.0 is behind
+// NOTE: Evaluated once per frame by SkyboxEnvironment
+uniform vec3 sunDirection;
 uniform float sunIntensity;
+uniform vec3 sunColor = vec3(1.0); // blend of the day and sunset colors
+uniform vec3 sunTransmittance = vec3(1.0); // transmittance of the atmosphere to the sun (relative to the sun at the zenith)
 
 // Noise textures
 layout ( binding = 1 ) uniform sampler3D perlinWorleyTex;
 layout ( binding = 2 ) uniform sampler3D worleyTex;
+layout ( binding = 4 ) uniform sampler2D curlTex;
+
+// Scene depth (depth buffer of the scene objects, 1.0 where there are none)
+layout ( binding = 5 ) uniform sampler2D sceneDepthTex;
+
+// Aerial perspective (fog color and amount over screen uv and the slice of the distance from the camera)
+layout ( binding = 6 ) uniform sampler3D aerialPerspective;
 
 // Clouds
 layout ( binding = 0 ) uniform sampler2D weatherMapTex;
@@ -42,8 +51,6 @@ uniform float powderCoeff = 5.0;
 uniform float csi = 5.0f; // amount of extra intensity
 uniform float cse = 20.0f; // exponent deciding how centralized around the sun extra intensity is
 uniform vec3 cloudsColor = vec3(1.f);
-uniform vec3 sunColorDay = vec3(1.0);
-uniform vec3 sunColorSunset = vec3(0.5, 0.3, 0.1);
 
 //===============================================================================================
 // CONSTANTS
@@ -61,6 +68,9 @@ const float atmosphereRadius = 6420e3f;
 // Sun
 const float sunAngularDiameter = 0.009250245; // deg2rad(0.53)
 
+// Aerial perspective (has to match SkyboxEnvironment.h)
+const float aerialPerspectiveDistance = 1e5f;
+
 // Scattering
 const int VIEW_RAY_SAMPLES = 256;
 const int SUN_RAY_SAMPLES = 12;
@@ -83,6 +93,9 @@ const vec3 cloudDetailWeights = vec3(0.625, 0.25, 0.125);
 
 const float cloudWeatherScale = 0.00005;
 
+const float cloudCurlScale = 0.0001;
+const float cloudCurlStrength = 500.0;
+
 //===============================================================================================
 // STRUCTS
 //===============================================================================================
@@ -98,12 +111,10 @@ struct planet {
 };
 
 struct sun {
-	float altitude;
-	float azimuth;
+	vec3 direction;
 	float intensity;
 	float angularDiameter;
-	vec3 colorDay;
-	vec3 colorSunset;
+	vec3 color;
 };
 
 struct cloud {
@@ -121,6 +132,16 @@ vec3 computeClipSpaceCoord(ivec2 fragCoord){
 	return vec3(rayNDC, 1.0);
 }
 
+// Calculates the distance from the camera to the scene objects along the ray through the fragment (very far if there are none)
+float computeSceneDistance(ivec2 fragCoord){
+	// scene depth is in the window resolution, clouds are rendered in the render scale
+	ivec2 depthCoord = ivec2((vec2(fragCoord) + 0.5) * vec2(textureSize(sceneDepthTex, 0)) / resolution);
+	float depth = texelFetch(sceneDepthTex, depthCoord, 0).r;
+	if (depth >= 1.0) return 1e30;
+	vec4 viewPosition = inverseProjection * vec4(computeClipSpaceCoord(fragCoord).xy, depth * 2.0 - 1.0, 1.0);
+	return length(viewPosition.xyz / viewPosition.w);
+}
+
 // Converts/Remaps a value from one range to another, where x is value to be remapped,
 // original range is [Lo, Ho] and a new one is [Ln, Hn].
 float remap(float x, float Lo, float Ho, float Ln, float Hn)
@@ -246,8 +267,13 @@ float calculateCloudDensity(vec3 position, bool isHighQuality, cloud cloud) {
 
 	// sample extra detail noise on the edges if isHighQuality
 	if (isHighQuality) {
+		// load curl noise and distort the detail position (stronger at the bottom of the clouds)
+		vec2 curl = texture(curlTex, cloudCurlScale * position.xz).rg * 2.0 - 1.0;
+		vec3 detailPosition = position;
+		detailPosition.xz += curl * cloudCurlStrength * (1.0 - cloudHeightFraction);
+
 		// load detail shape texture (worley32 noise)
-		vec3 detail = texture(worleyTex, cloudDetailScale * (position + normalize(windDirection) * time * cloudSpeed * edgesSpeedMultiplier)).rgb;
+		vec3 detail = texture(worleyTex, cloudDetailScale * (detailPosition + normalize(windDirection) * time * cloudSpeed * edgesSpeedMultiplier)).rgb;
 		float detailFBM = dot(detail, cloudDetailWeights);
 
 		float densityModification = 0.35 * exp(- globalCloudsCoverage * 0.75) * mix(detailFBM, 1 - detailFBM, clamp(cloudHeightFraction * 5.0, 0.0, 1.0));
@@ -330,7 +356,7 @@ vec3 calculateCloudLight(vec3 position, vec3 sunDirection, float mu, cloud cloud
 //===============================================================================================
 
 // Calculates the color for the clouds
-vec4 clouds(in ray view, in planet earth, in cloud cloud, in sun sun, out float distanceToCloudLayer) 
+vec4 clouds(in ray view, in planet earth, in cloud cloud, in sun sun, in float sceneDistance, out float distanceToCloudLayer) 
 {
 	// prepare data for ray-cloud_layer intersections
 	float distanceToCloudLow, distanceToCloudHigh, cloudLayer;
@@ -339,12 +365,12 @@ vec4 clouds(in ray view, in planet earth, in cloud cloud, in sun sun, out float
 	// calculate distance to cloud layer (for above, below and inside look of the clouds)
 	distanceToCloudLayer = min(distanceToCloudLow, distanceToCloudHigh);
 
-	// calculate the sun direction
-	float cosSunAlt = cos(sun.altitude);
-	vec3 sunDirection = vec3(cos(sun.azimuth) * cosSunAlt, sin(sun.altitude), sin(sun.azimuth) * cosSunAlt);
-	
+	// end the view ray at the scene objects (clouds behind them are not visible)
+	float viewLayer = min(cloudLayer, sceneDistance - distanceToCloudLayer);
+	if (viewLayer <= 0.0) return vec4(vec3(0.0), 1.0);
+
 	// calculate the cosine of angle between the sun direction and the ray direction
-	float mu = dot(view.direction, sunDirection);
+	float mu = dot(view.direction, sun.direction);
 
 	// initialize variables for ray-marching
 	float distancePassed = 0.0f;
@@ -355,18 +381,15 @@ vec4 clouds(in ray view, in planet earth, in cloud cloud, in sun sun, out float
 	float numberOfSteps = (1. - 0.5 * mu) * VIEW_RAY_SAMPLES;
 
 	// calculate the view ray segment length
-	float segmentLength = cloudLayer / numberOfSteps;
+	float segmentLength = viewLayer / numberOfSteps;
 
 	// move ray origin to the intersection with cloud lower layer
 	view.origin += view.direction * distanceToCloudLayer;
 	// update the distance passed
 	distancePassed += distanceToCloudLayer;
 
-	// calculate light color
-	float sigmoid = 1 / (1.0 + exp(8.0 - sunDirection.y * 40.0));
-	float a = min(max(sigmoid, 0.0f), 1.0f);
-	float b = 1.0 - a;
-	vec3 lightColor = sun.colorDay * a + sun.colorSunset * b;
+	// get light color
+	vec3 lightColor = sun.color;
 
 	// iterate over view-ray direction
 	for (int i = 0; i < numberOfSteps; ++i) {
@@ -398,7 +421,7 @@ vec4 clouds(in ray view, in planet earth, in cloud cloud, in sun sun, out float
 				}
 				
 				// accumulate final color
-				color += calculateCloudLight(samplePosition, sunDirection, mu, cloud, cloudLayer, sun, lightColor) * density * segmentLength * transmittance * powder * lightColor;
+				color += calculateCloudLight(samplePosition, sun.direction, mu, cloud, cloudLayer, sun, lightColor) * density * segmentLength * transmittance * powder * lightColor;
 			}
 		}
 
@@ -436,25 +459,24 @@ void main()
 	// prepare cloud info
 	cloud cloud = cloud(earthRadius + cloudHeightLOW, earthRadius + cloudHeightHIGH);
 	
-	// calculate sun altitude and azimuth
-	float sunAlt = 4.0 * - sunAngularDiameter + 1.6 * PI_4 * (0.5 + cos((1.0 - sunAltitude) * 3.0) / 2.0);
-	float sunAzi = (1.0 - sunAzimuth * 0.7) * 4.6;
-
-	// prepare sun info
-    sun sun = sun(sunAlt, sunAzi, sunIntensity, sunAngularDiameter, sunColorDay, sunColorSunset);
+	// prepare sun info (direct light goes through the atmosphere)
+    sun sun = sun(sunDirection, sunIntensity, sunAngularDiameter, sunColor * sunTransmittance);
 
 	// prepare distance to clouds layer
 	float distanceToCloudLayer;
 
+	// calculate the distance to the scene objects
+	float sceneDistance = computeSceneDistance(fragCoord);
+
 	// calculate the clouds color
-	vec4 clouds = clouds(view, earth, cloud, sun, distanceToCloudLayer);
+	vec4 clouds = clouds(view, earth, cloud, sun, sceneDistance, distanceToCloudLayer);
 
-	// calculate atmosphere amount for the clouds
-	vec3 atmosphereColor = vec3(0.0, 0.0, 0.0); // atmosphere color should be black due to blending clouds with background texture
-	float atmosphereAmount = (1.0f / renderDistance) * distanceToCloudLayer;
+	// calculate aerial perspective in front of the clouds
+	vec2 uv = vec2(fragCoord) / resolution;
+	vec4 fog = texture(aerialPerspective, vec3(uv, sqrt(max(distanceToCloudLayer, 0.0) / aerialPerspectiveDistance)));
 
-	// blend clouds with atmosphere
-	vec4 result = mix(clouds, vec4(atmosphereColor, 1.0), atmosphereAmount);
+	// blend clouds with atmosphere (fog is in front of the clouds and the background texture already contains it)
+	vec4 result = vec4(clouds.rgb * (1.0 - fog.a) + fog.rgb * fog.a * (1.0 - clouds.a), clouds.a);
 
 	// output the final result
 	gl_FragColor = result;
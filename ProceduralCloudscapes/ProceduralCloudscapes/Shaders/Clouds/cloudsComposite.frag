@@ -0,0 +1,21 @@
+#version 460 core
+//===============================================================================================
+// INPUT/OUTPUT
+//===============================================================================================
+
+out vec4 FragColor;
+
+in vec2 TexCoords;
+
+// Clouds rendered in the render scale (alpha is the transmittance the scene behind them is blended with)
+layout ( binding = 0 ) uniform sampler2D cloudsTex;
+
+//===============================================================================================
+// MAIN
+//===============================================================================================
+
+void main()
+{
+	// bilinear upscale to the window resolution
+	FragColor = texture(cloudsTex, TexCoords);
+}
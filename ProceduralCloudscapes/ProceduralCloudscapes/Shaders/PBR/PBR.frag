@@ -5,11 +5,11 @@ in vec3 WorldPos;
 in vec3 Normal;
 
 // Sun
-uniform float sunAltitude; // from range [0.0, 1.0] where 0.0 is night and 1.0 is clear day
-uniform float sunAzimuth; // from range [-1.0, 1.0] where 0.0 is in front and (-)1.0 is behind
+// NOTE: Evaluated once per frame by SkyboxEnvironment
+uniform vec3 sunDirection;
 uniform float sunIntensity;
-uniform vec3 sunColorDay = vec3(1.0);
-uniform vec3 sunColorSunset = vec3(0.5, 0.3, 0.1);
+uniform vec3 sunColor = vec3(1.0); // blend of the day and sunset colors
+uniform vec3 sunTransmittance = vec3(1.0); // transmittance of the atmosphere to the sun (relative to the sun at the zenith)
 const float earthRadius = 6360e3f;
 
 // material parameters
@@ -30,12 +30,10 @@ const float PI_4 = 0.785398163397448309616;
 const float sunAngularDiameter = 0.009250245; // deg2rad(0.53)
 
 struct sun {
-	float altitude;
-	float azimuth;
+	vec3 direction;
 	float intensity;
 	float angularDiameter;
-	vec3 colorDay;
-	vec3 colorSunset;
+	vec3 color;
 };
 
 // ----------------------------------------------------------------------------
@@ -45,7 +43,9 @@ struct sun {
 // technique somewhere later in the normal mapping tutorial.
 vec3 getNormalFromMap()
 {
-    vec3 tangentNormal = texture(normalMap, TexCoords).xyz * 2.0 - 1.0;
+    // Z is reconstructed from XY (compressed normal maps store only two channels)
+    vec2 tangentXY = texture(normalMap, TexCoords).xy * 2.0 - 1.0;
+    vec3 tangentNormal = vec3(tangentXY, sqrt(max(1.0 - dot(tangentXY, tangentXY), 0.0)));
 
     vec3 Q1  = dFdx(WorldPos);
     vec3 Q2  = dFdy(WorldPos);
@@ -102,23 +102,11 @@ vec3 fresnelSchlick(float cosTheta, vec3 F0)
 // ----------------------------------------------------------------------------
 void main()
 {	
-	// calculate sun altitude and azimuth
-	float sunAlt = 4.0 * - sunAngularDiameter + 1.6 * PI_4 * (0.5 + cos((1.0 - sunAltitude) * 3.0) / 2.0);
-	float sunAzi = (1.0 - sunAzimuth * 0.7) * 4.6;
-
-	// prepare sun info
-    sun sun = sun(sunAlt, sunAzi, sunIntensity, sunAngularDiameter, sunColorDay, sunColorSunset);
-    
-	// calculate the sun direction
-	float cosSunAlt = cos(sun.altitude);
-	vec3 sunDirection = vec3(cos(sun.azimuth) * cosSunAlt, sin(sun.altitude), sin(sun.azimuth) * cosSunAlt);
+	// prepare sun info (direct light goes through the atmosphere)
+    sun sun = sun(sunDirection, sunIntensity, sunAngularDiameter, sunColor * sunTransmittance);
     
 	// Calculate light color
-	float sigmoid = 1 / (1.0 + exp(8.0 - sunDirection.y * 40.0));
-	float a = min(max(sigmoid, 0.0f), 1.0f);
-	float b = 1.0 - a;
-	vec3 lightColor = sun.colorDay * a + sun.colorSunset * b;
-	lightColor *= sun.intensity / 20.f;
+	vec3 lightColor = sun.color * sun.intensity / 20.f;
 
     vec3 lightPosition = vec3(0.0, 10.f, 0.0);
 
@@ -0,0 +1,12 @@
+#version 460 core
+layout (location = 0) in vec2 aPos;
+layout (location = 1) in vec2 aTexCoords;
+
+out vec2 TexCoords;
+
+void main()
+{
+    TexCoords = aTexCoords;
+    // quad lies on the far plane, so it is hidden by everything that has been drawn before it
+    gl_Position = vec4(aPos.x, aPos.y, 1.0, 1.0);
+}
\ No newline at end of file
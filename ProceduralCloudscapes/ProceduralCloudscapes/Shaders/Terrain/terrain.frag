@@ -7,10 +7,23 @@
 #define SNOW_COVERAGE_MULTIPLIER 0.4f
 #define TERRAIN_SHININESS 32
 
+// Material layers (has to match the order in Terrain.cpp)
+#define GRASS_LAYER 0.0
+#define ROCK_LAYER 1.0
+#define SNOW_LAYER 2.0
+
 // Sun
 const float sunAngularDiameter = 0.009250245; // deg2rad(0.53)
 const float earthRadius = 6360e3f;
 
+// Clipmap and heightmap pages (have to match Terrain.h and TerrainHeightmap.h)
+#define MAX_CLIPMAP_LEVELS 16
+#define CLIPMAP_LEVEL_BLOCKS 6
+#define PAGE_RESOLUTION 256
+
+// Aerial perspective (has to match SkyboxEnvironment.h)
+const float aerialPerspectiveDistance = 1e5f;
+
 // Math
 const float PI = 3.14159265358979323846;
 const float PI_2 = 1.57079632679489661923;
@@ -26,23 +39,10 @@ struct ray {
 	vec3 direction;
 };
 
-struct fbm {
-	float amplitude;
-	float frequency;
-	int octaves;
-	float lacunarity;
-	float gain;
-	vec2 seed;
-	float power;
-};
-
 struct sun {
-	float altitude;
-	float azimuth;
+	vec3 direction;
 	float intensity;
 	float angularDiameter;
-	vec3 colorDay;
-	vec3 colorSunset;
 	vec3 color;
 };
 
@@ -65,54 +65,46 @@ in vec3 WorldPos_FS_in;
 in vec3 Normal_FS_in;
 in vec2 TexCoord_FS_in;
 
-// Terrain noise parameters
-uniform fbm terrainNoise;
+// Clipmap
+uniform int clipmapLevels;
+uniform vec4 levelBounds[MAX_CLIPMAP_LEVELS]; // (min.x, min.z, max.x, max.z) of every level
+
+// Virtual heightmap (page layer of every block of every level)
+uniform ivec4 pageLayers[MAX_CLIPMAP_LEVELS * CLIPMAP_LEVEL_BLOCKS * CLIPMAP_LEVEL_BLOCKS / 4];
+layout (binding = 16) uniform sampler2DArray normalPages;
 
 // Terrain coverages
 uniform float grassCoverage = 0.1;
 uniform float snowCoverage = 1.0;
 
-// Fog
-uniform float fogFalloff = 0.f;
-uniform vec3 fogColor  = vec3(0.5, 0.6, 0.7);
-uniform bool isRealFog = true;
+// Aerial perspective (fog color and amount over screen uv and the slice of the distance from the camera)
+layout (binding = 17) uniform sampler3D aerialPerspective;
 
 // Heights
 uniform float grassHeight = 5000.f;
 uniform float rockHeight = 7000.f;
 
 // MATERIALS
+// Texture arrays with one layer per material (ORM: occlusion (r), roughness (g), metallic (b))
+layout (binding = 0) uniform sampler2DArray materialAlbedo;
+layout (binding = 1) uniform sampler2DArray materialNormal;
+layout (binding = 2) uniform sampler2DArray materialORM;
 // Grass
-layout (binding = 0) uniform sampler2D grassAlbedo;
-layout (binding = 1) uniform sampler2D grassNormal;
-layout (binding = 2) uniform sampler2D grassMetallic;
-layout (binding = 3) uniform sampler2D grassRoughness;
-layout (binding = 4) uniform sampler2D grassAO;
 uniform vec3 grassBaseColor;
 uniform float grassScale;
 // Rock
-layout (binding = 5) uniform sampler2D rockAlbedo;
-layout (binding = 6) uniform sampler2D rockNormal;
-layout (binding = 7) uniform sampler2D rockMetallic;
-layout (binding = 8) uniform sampler2D rockRoughness;
-layout (binding = 9) uniform sampler2D rockAO;
 uniform vec3 rockBaseColor;
 uniform float rockScale;
 // Snow
-layout (binding = 10) uniform sampler2D snowAlbedo;
-layout (binding = 11) uniform sampler2D snowNormal;
-layout (binding = 12) uniform sampler2D snowMetallic;
-layout (binding = 13) uniform sampler2D snowRoughness;
-layout (binding = 14) uniform sampler2D snowAO;
 uniform vec3 snowBaseColor;
 uniform float snowScale;
 
 // Sun
-uniform float sunAltitude; // from range [0.0, 1.0] where 0.0 is night and 1.0 is clear day
-uniform float sunAzimuth; // from range [-1.0, 1.0] where 0.0 is in front and (-)1.0 is behind
+// NOTE: Evaluated once per frame by SkyboxEnvironment
+uniform vec3 sunDirection;
 uniform float sunIntensity;
-uniform vec3 sunColorDay = vec3(1.f, 0.96f, 0.9f);
-uniform vec3 sunColorSunset = vec3(0.36f, 0.14f, 0.07f);
+uniform vec3 sunColor = vec3(1.f, 0.96f, 0.9f); // blend of the day and sunset colors
+uniform vec3 sunTransmittance = vec3(1.f); // transmittance of the atmosphere to the sun (relative to the sun at the zenith)
 
 // Camera
 uniform vec3 cameraPosition;
@@ -124,9 +116,11 @@ uniform mat4 inverseView;
 // METHODS (PBR)
 //===============================================================================================
 
-vec3 getNormalFromMap(sampler2D normalMap, vec3 Normal, vec2 TexCoords, vec3 WorldPosition)
+vec3 getNormalFromMap(float layer, vec3 Normal, vec2 TexCoords, vec3 WorldPosition)
 {
-    vec3 tangentNormal = texture(normalMap, TexCoords).xyz * 2.0 - 1.0;
+    // Z is reconstructed from XY (compressed normal maps store only two channels)
+    vec2 tangentXY = texture(materialNormal, vec3(TexCoords, layer)).xy * 2.0 - 1.0;
+    vec3 tangentNormal = vec3(tangentXY, sqrt(max(1.0 - dot(tangentXY, tangentXY), 0.0)));
 
     vec3 Q1 = dFdx(WorldPosition);
     vec3 Q2 = dFdy(WorldPosition);
@@ -185,15 +179,12 @@ vec3 fresnelSchlick(float cosTheta, vec3 F0)
     return F0 + (1.0 - F0) * pow(max(1.0 - cosTheta, 0.0), 5.0);
 }
 
-// Loads PBR textures
-material loadPBRTextures(in sampler2D albedoMap, in sampler2D normalMap, in sampler2D metallicMap, in sampler2D roughnessMap, in sampler2D aoMap, 
-                    in vec3 baseColor, in float scale, in vec2 TexCoords, in vec3 Normal, in vec3 WorldPosition) {
-	vec3 albedo = texture(albedoMap, TexCoords * scale).rgb;
-    vec3 normal = getNormalFromMap(normalMap, Normal, TexCoords, WorldPosition);
-    float metallic = texture(metallicMap, TexCoords * scale).r;
-    float roughness = texture(roughnessMap, TexCoords * scale).r;
-    float ao = texture(aoMap, TexCoords * scale).r;
-    return material(albedo, normal, metallic, roughness, ao, baseColor, scale);
+// Loads PBR textures of the material layer
+material loadPBRTextures(in float layer, in vec3 baseColor, in float scale, in vec2 TexCoords, in vec3 Normal, in vec3 WorldPosition) {
+	vec3 albedo = texture(materialAlbedo, vec3(TexCoords * scale, layer)).rgb;
+    vec3 normal = getNormalFromMap(layer, Normal, TexCoords, WorldPosition);
+    vec3 orm = texture(materialORM, vec3(TexCoords * scale, layer)).rgb;
+    return material(albedo, normal, orm.b, orm.g, orm.r, baseColor, scale);
 }
 
 // Calculates PBR color for given material
@@ -265,81 +256,49 @@ vec3 computeClipSpaceCoord(ivec2 fragCoord){
 	return vec3(rayNDC, 1.0);
 }
 
-// Calculates a random value based on 2D vector (co) and a seed
-float rand(vec2 co, vec2 seed){
-    return fract(sin(dot(co, vec2(12.9898, 78.233) + seed)) * 43758.5453);
-}
-
-// Calculates interpolated noise
-float interpolatedNoise(vec2 x, vec2 seed) {
-    // Grid
-    vec2 p = floor(x);
-    vec2 w = fract(x);
-	
-    // Quintic interpolant
-    vec2 u = w * w * w * (w * (w * 6.0 - 15.0) + 10.0);
-
-	// Gradients
-	float ga = rand(p + vec2(0.0, 0.0), seed);
-	float gb = rand(p + vec2(1.0, 0.0), seed);
-	float gc = rand(p + vec2(0.0, 1.0), seed);
-	float gd = rand(p + vec2(1.0, 1.0), seed);
-
-	// Interpolation
-	return ga + 
-			u.x * (gb - ga) + 
-			u.y * (gc - ga) + 
-			u.x * u.y * (gd - gc - gb + ga);
+// Calculates the texture coordinate (and layer) of the heightmap page for the position in the level
+vec3 calculatePageCoord(vec2 position, int level) {
+	// level is made out of 6x6 blocks and each of them has its own page (4 pages are packed into one ivec4)
+	vec4 bounds = levelBounds[level];
+	float pageSize = (bounds.z - bounds.x) / float(CLIPMAP_LEVEL_BLOCKS);
+	vec2 cell = clamp(floor((position - bounds.xy) / pageSize), 0.0, float(CLIPMAP_LEVEL_BLOCKS - 1));
+	int entry = (level * CLIPMAP_LEVEL_BLOCKS + int(cell.y)) * CLIPMAP_LEVEL_BLOCKS + int(cell.x);
+	int layer = pageLayers[entry / 4][entry % 4];
+	// first and last texel lie exactly on the page edges
+	vec2 local = (position - bounds.xy) / pageSize - cell;
+	vec2 uv = (local * float(PAGE_RESOLUTION - 1) + 0.5) / float(PAGE_RESOLUTION);
+	return vec3(uv, float(layer));
 }
 
-// Calculates fBm for the noise defined with fbm at coord
-float noiseFBM(vec2 coord, fbm fbm) {
-    // Initial values
-    float frequency = fbm.frequency;
-    float amplitude = fbm.amplitude;
-    float noise = 0.0f;
-    // Loop through octaves
-    for (int i = 0; i < fbm.octaves; ++i) {
-        // Initial value for this noise
-        float noiseRes = interpolatedNoise(coord * frequency, fbm.seed);
-        // Accumulate noise
-        noise += amplitude * noiseRes;
-        // Update properties
-        frequency *= fbm.lacunarity;
-        amplitude *= fbm.gain;
-    }
-    // Return final fBm noise
-    return pow(noise, fbm.power);
-}
-
-// Calculates new normal for the position with offset for the interpolated noise
-vec3 offsetNormal(vec3 position, float offset) {
-	float dx = (noiseFBM(vec2((position.x + offset), position.z), terrainNoise) - noiseFBM(vec2((position.x - offset), position.z), terrainNoise))/(2.0*offset);
-	float dz = (noiseFBM(vec2(position.x, (position.z + offset)), terrainNoise) - noiseFBM(vec2(position.x, (position.z - offset)), terrainNoise))/(2.0*offset);
-	vec3 X = vec3(1.0, dx, 0.0);
-	vec3 Z = vec3(0.0, dz, 1.0);
-	// Calculate and normalize new normal
-	return normalize(cross(Z,X));
+// Finds the finest clipmap level which contains the position
+int findFinestLevel(vec2 position) {
+	for (int level = 0; level < clipmapLevels - 1; ++level) {
+		vec4 bounds = levelBounds[level];
+		if (all(greaterThanEqual(position, bounds.xy)) && all(lessThanEqual(position, bounds.zw)))
+			return level;
+	}
+	return clipmapLevels - 1;
 }
 
 // Calculates base color value based on the current position
 vec3 calculateColor(vec3 position, vec3 normal, vec2 texCoords, sun sun, ray sunRay) {
 	// Prepare resulting color
 	vec3 color;
-	// Calculate offset normals with interpolated noise (used as blending coefficients)
-	float grassRockBlend = abs(dot(offsetNormal(position, 1.0f), vec3(0.0, 1.0, 0.0)));
-	float snowRockBlend = abs(dot(offsetNormal(position, 2.0f), vec3(0.0, 1.0, 0.0)));
+	// Fetch offset normals from the heightmap (used as blending coefficients)
+	vec4 pageNormal = texture(normalPages, calculatePageCoord(position.xz, findFinestLevel(position.xz)));
+	float grassRockBlend = abs(pageNormal.y * 2.0 - 1.0);
+	float snowRockBlend = pageNormal.a;
 	// Calculate resulting color based on coverages and height
 	if (grassRockBlend > (1.0 - grassCoverage * GRASS_COVERAGE_MULTIPLIER) && position.y < rockHeight) {
-        material grassMaterial = loadPBRTextures(grassAlbedo, grassNormal, grassMetallic, grassRoughness, grassAO, grassBaseColor, grassScale, texCoords, normal, position);
+        material grassMaterial = loadPBRTextures(GRASS_LAYER, grassBaseColor, grassScale, texCoords, normal, position);
 		color = calculatePBR(grassMaterial, sun, sunRay, texCoords, position, normal);
     }
 	else if (snowRockBlend < snowCoverage * SNOW_COVERAGE_MULTIPLIER && position.y > grassHeight) {
-        material snowMaterial = loadPBRTextures(snowAlbedo, snowNormal, snowMetallic, snowRoughness, snowAO, snowBaseColor, snowScale, texCoords, normal, position);
+        material snowMaterial = loadPBRTextures(SNOW_LAYER, snowBaseColor, snowScale, texCoords, normal, position);
 		color = calculatePBR(snowMaterial, sun, sunRay, texCoords, position, normal);
     }
 	else {
-        material rockMaterial = loadPBRTextures(rockAlbedo, rockNormal, rockMetallic, rockRoughness, rockAO, rockBaseColor, rockScale, texCoords, normal, position);
+        material rockMaterial = loadPBRTextures(ROCK_LAYER, rockBaseColor, rockScale, texCoords, normal, position);
 		color = calculatePBR(rockMaterial, sun, sunRay, texCoords, position, normal);
     }
 	// Return final result
@@ -366,12 +325,10 @@ vec3 specular(vec3 normal, vec3 lightDirection, vec3 viewDirection, vec3 lightCo
 	return specularStrength * lightColor;
 }
 
-// Calculates amount of fog that will cover the terrain
-float calculateFogAmount(vec3 cameraPosition, vec3 position, float fogFalloff) {
-    float cameraToPointDistance = distance(cameraPosition, position);
-    vec3 rayDirection = normalize(position - cameraPosition);
-    float fogAmount = (1.0 - exp(-cameraToPointDistance * rayDirection.y * fogFalloff)) / rayDirection.y;
-    return clamp(fogAmount, 0.0, 1.0);
+// Fetches the aerial perspective between the camera and the position (fog color (rgb) and amount (a))
+vec4 fetchAerialPerspective(ivec2 fragCoord, vec3 cameraPosition, vec3 position) {
+    float slice = sqrt(distance(cameraPosition, position) / aerialPerspectiveDistance);
+    return texture(aerialPerspective, vec3(vec2(fragCoord) / resolution, slice));
 }
 
 //===============================================================================================
@@ -387,23 +344,12 @@ void main()
 	viewRay = vec4(viewRay.xy, -1.0, 0.0);
 	vec3 rayDirection = normalize((inverseView * viewRay).xyz);
 
-	// Calculate sun altitude and azimuth
-	float sunAlt = 4.0 * - sunAngularDiameter + 1.6 * PI_4 * (0.5 + cos((1.0 - sunAltitude) * 3.0) / 2.0);
-	float sunAzi = (1.0 - sunAzimuth * 0.7) * 4.6;	
-	
-	// Calculate the sun direction
-	float cosSunAlt = cos(sunAlt);
-	vec3 sunDirection = vec3(cos(sunAzi) * cosSunAlt, sin(sunAlt), sin(sunAzi) * cosSunAlt);
-
-	// Calculate light color
-	float sigmoid = 1 / (1.0 + exp(8.0 - sunDirection.y * 40.0));
-	float a = min(max(sigmoid, 0.0f), 1.0f);
-	float b = 1.0 - a;
-	vec3 lightColor = sunColorDay * a + sunColorSunset * b;
-	lightColor *= sunIntensity / 20.f;
+	// Calculate light color (ambient light is the sky, direct light goes through the atmosphere)
+	vec3 lightColor = sunColor * sunIntensity / 20.f;
+	vec3 sunLightColor = lightColor * sunTransmittance;
 
 	// Prepare sun info
-    sun sun = sun(sunAlt, sunAzi, sunIntensity, sunAngularDiameter, sunColorDay, sunColorSunset, lightColor);
+    sun sun = sun(sunDirection, sunIntensity, sunAngularDiameter, sunLightColor);
 	ray sunRay = ray(vec3(0.f, 1000.f, 0.f), sunDirection);
 	
 	// Calculate base color
@@ -411,8 +357,8 @@ void main()
 
 	// Calculate color components
 	vec3 ambient = ambient(lightColor);
-	vec3 diffuse = diffuse(Normal_FS_in, sunDirection, lightColor);
-	vec3 specular = specular(Normal_FS_in, sunDirection, rayDirection, lightColor);
+	vec3 diffuse = diffuse(Normal_FS_in, sunDirection, sunLightColor);
+	vec3 specular = specular(Normal_FS_in, sunDirection, rayDirection, sunLightColor);
 
     // Calculate final color
     color = color * (ambient + diffuse + specular);
@@ -421,20 +367,9 @@ void main()
     //              POST - PROCESSING
     // ################################################
 
-    // Calculate fog amount
-    float fogAmount = calculateFogAmount(cameraPosition, WorldPos_FS_in, fogFalloff * 1e-6);
-
-    // Calculate fog color
-    sigmoid = 1 / (1.0 + exp(8.0 - WorldPos_FS_in.y * 40.0));
-	a = min(max(sigmoid, 0.0f), 1.0f);
-	b = 1.0 - a;
-	vec3 fogColor = fogColor * 1.15f * a + fogColor * 0.85f * b;
-    
-    if (isRealFog)
-        fogColor *= lightColor * 0.8;
-
-    // Apply fog
-    color = mix(color, fogColor, fogAmount);
+    // Apply aerial perspective
+    vec4 fog = fetchAerialPerspective(fragCoord, cameraPosition, WorldPos_FS_in);
+    color = mix(color, fog.rgb, fog.a);
 
 	// Output final result
 	gl_FragColor = vec4(color, 1.0);
@@ -1,17 +1,29 @@
 #version 460 core
-layout ( location = 0 ) in vec3 Position_VS_in;
-layout ( location = 1 ) in vec3 Normal_VS_in;
-layout ( location = 2 ) in vec2 TexCoord_VS_in;
-layout ( location = 3 ) in vec2 aPosition;
+layout ( location = 0 ) in vec2 GridCoord_VS_in;
+layout ( location = 1 ) in vec4 aBlock; // (offset.x, offset.z, block size, clipmap level)
+
+// Number of vertices on the one side of the block
+uniform int blockResolution;
+// Size of the block in the finest clipmap level (texture coordinates repeat with it)
+uniform float tileScale;
 
 out vec3 WorldPos_TECS_in;
 out vec2 TexCoord_TECS_in;
 out vec3 Normal_TECS_in;
+flat out vec2 Block_TECS_in; // (block size, clipmap level)
 
 void main()
 {
-	WorldPos_TECS_in = Position_VS_in;
-	WorldPos_TECS_in.xz += aPosition;
-	Normal_TECS_in = Normal_VS_in;
-	TexCoord_TECS_in = TexCoord_VS_in;
+	// base plane is a unit block (x goes along the grid columns, z against the grid rows)
+	vec2 unitPosition = GridCoord_VS_in / float(blockResolution - 1);
+	vec3 position = vec3(unitPosition.x - 0.5, 0.0, 0.5 - unitPosition.y);
+
+	// unit block is scaled and moved into its clipmap place
+	WorldPos_TECS_in = position * aBlock.z;
+	WorldPos_TECS_in.xz += aBlock.xy;
+	// base plane is flat (terrain is displaced along it in the evaluation shader)
+	Normal_TECS_in = vec3(0.0, 1.0, 0.0);
+	// texture coordinates are derived from the world position so they are continuous between the levels
+	TexCoord_TECS_in = WorldPos_TECS_in.xz / tileScale + 0.5;
+	Block_TECS_in = aBlock.zw;
 }
\ No newline at end of file